@@ -0,0 +1,323 @@
+/* =============================================================================
+ * approximate.c Approximate centres from searches out of a sample of pivots,
+ *               verified exactly for the most promising nodes only
+ * =============================================================================
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <math.h>
+#include <omp.h>
+#include <mpi.h>
+#include "helper.h"
+#include "sparse.h"
+#include "instrument.h"
+#include "approximate.h"
+
+/* Draw the next number from a xorshift generator.
+ * Parameters:
+ *          state - the generator state, updated in place, never 0
+ * Return:
+ *          The next pseudo-random number.
+ */
+unsigned long long next_random(unsigned long long* state) {
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+    return *state;
+}
+
+/* Get the number of pivots needed for a target error.
+ *  Sampling log(|V|) / error^2 pivots estimates every node's average distance
+ *  to within error times the diameter, with high probability.
+ * Parameters:
+ *          nodeCount - the number of nodes in the graph
+ *          error - the target error, greater than 0
+ * Return:
+ *          The number of pivots, at least 1.
+ */
+int sample_count(int nodeCount, double error) {
+    double count = ceil(log(nodeCount > 1 ? nodeCount : 2) / (error * error));
+    if (count > nodeCount) return nodeCount;
+    return count < 1 ? 1 : (int) count;
+}
+
+/* Choose distinct pivots uniformly at random.
+ *  A partial Fisher-Yates shuffle from APPROXIMATE_SEED, so every rank
+ *  chooses the same pivots.
+ * Parameters:
+ *          nodeCount - the number of nodes in the graph
+ *          sampleCount - the number of pivots, at most nodeCount
+ *          pivots - out parameter holding the pivots
+ */
+void choose_pivots(int nodeCount, int sampleCount, int* pivots) {
+    int* order = malloc(nodeCount * sizeof(int));
+    for (int i = 0; i < nodeCount; i++) {
+        order[i] = i;
+    }
+    unsigned long long state = APPROXIMATE_SEED;
+    for (int s = 0; s < sampleCount; s++) {
+        int pick = s + (int) (next_random(&state) % (nodeCount - s));
+        int swap = order[s];
+        order[s] = order[pick];
+        order[pick] = swap;
+        pivots[s] = order[s];
+    }
+    free(order);
+}
+
+/* Order candidates by score, then by node.
+ * Parameters:
+ *          a - the first candidate
+ *          b - the second candidate
+ * Return:
+ *          Negative, zero or positive as a sorts before, with or after b.
+ */
+int compare_candidates(const void* a, const void* b) {
+    const Candidate* candidateA = a;
+    const Candidate* candidateB = b;
+    if (candidateA->score != candidateB->score) {
+        return candidateA->score < candidateB->score ? -1 : 1;
+    }
+    return candidateA->node - candidateB->node;
+}
+
+/* Choose the nodes to verify exactly.
+ *  The verifyCount nodes with the smallest estimated totals, and the
+ *  verifyCount with the smallest eccentricity lower bounds among those whose
+ *  bound does not already rule them out.
+ * Parameters:
+ *          totals - the estimated total distance from each node
+ *          lower - a lower bound on the eccentricity of each node
+ *          upper - an upper bound on the eccentricity of each node
+ *          nodeCount - the number of nodes in the graph
+ *          verifyCount - the number of candidates for each metric
+ *          candidates - out parameter holding the candidates in ascending
+ *                       order, with room for 2 * verifyCount
+ * Return:
+ *          The number of candidates.
+ */
+int select_candidates(double* totals, long long* lower, long long* upper,
+        int nodeCount, int verifyCount, int* candidates) {
+    Candidate* ranked = malloc(nodeCount * sizeof(Candidate));
+    char* chosen = calloc(nodeCount, sizeof(char));
+
+    for (int i = 0; i < nodeCount; i++) {
+        ranked[i].score = totals[i];
+        ranked[i].node = i;
+    }
+    qsort(ranked, nodeCount, sizeof(Candidate), compare_candidates);
+    for (int i = 0; i < verifyCount; i++) {
+        chosen[ranked[i].node] = 1;
+    }
+
+    // No node whose eccentricity is at least some other node's upper bound
+    // can beat that node
+    long long bestUpper = LLONG_MAX;
+    for (int i = 0; i < nodeCount; i++) {
+        if (upper[i] < bestUpper) bestUpper = upper[i];
+    }
+    int viable = 0;
+    for (int i = 0; i < nodeCount; i++) {
+        if (lower[i] > bestUpper) continue;
+        ranked[viable].score = lower[i];
+        ranked[viable].node = i;
+        viable++;
+    }
+    qsort(ranked, viable, sizeof(Candidate), compare_candidates);
+    for (int i = 0; i < verifyCount && i < viable; i++) {
+        chosen[ranked[i].node] = 1;
+    }
+
+    int count = 0;
+    for (int i = 0; i < nodeCount; i++) {
+        if (chosen[i]) candidates[count++] = i;
+    }
+    free(ranked);
+    free(chosen);
+    return count;
+}
+
+/* Find approximate centres by both metrics.
+ *  Dijkstra from sampleCount pivots, split over ranks and threads, estimates
+ *  every node's total distance, Eppstein-Wang style, and bounds its
+ *  eccentricity between its furthest pivot and its distance to a pivot plus
+ *  that pivot's eccentricity. Only the best candidates by each are then
+ *  searched from exactly. Requires non-negative weights and a connected
+ *  graph.
+ * Parameters:
+ *          graph - the graph in question
+ *          sampleCount - the number of pivots, and of candidates verified for
+ *                        each metric, at most the number of nodes
+ *          comm - the communicator the ranks share
+ *          minTotalCentres - out parameter on rank 0 holding the candidates
+ *                            with the least total distance
+ *          minMaxCentres - out parameter on rank 0 holding the candidates
+ *                          with the least maximum distance
+ * Return:
+ *          0 if the centres were found, 1 if the graph could not be solved.
+ */
+int approximate_centres(Graph* graph, int sampleCount, MPI_Comm comm,
+        ListNode** minTotalCentres, ListNode** minMaxCentres) {
+    int rank, size;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &size);
+    int nodeCount = graph->nodeCount;
+    if (has_negative_weights(graph)) {
+        if (rank == 0) {
+            printf("Approximate centres need non-negative edge weights.\n");
+        }
+        return 1;
+    }
+
+    PHASE_START(PHASE_MATRIX_INIT);
+    CSRGraph* csr = build_csr(graph);
+    // A search from a pivot over the reversed graph finds every node's
+    // distance to it, which for undirected graphs is the same search
+    CSRGraph* incoming = csr;
+    if (graph->directed) {
+        Graph reversed = *graph;
+        reversed.edgeFrom = graph->edgeTo;
+        reversed.edgeTo = graph->edgeFrom;
+        incoming = build_csr(&reversed);
+    }
+    int* pivots = malloc(sampleCount * sizeof(int));
+    choose_pivots(nodeCount, sampleCount, pivots);
+    double* totals = calloc(nodeCount, sizeof(double));
+    long long* lower = calloc(nodeCount, sizeof(long long));
+    long long* upper = malloc(nodeCount * sizeof(long long));
+    for (int i = 0; i < nodeCount; i++) {
+        upper[i] = LLONG_MAX;
+    }
+    int disconnected = 0;
+    PHASE_STOP(PHASE_MATRIX_INIT);
+
+    int start, end;
+    set_partition(rank, size, sampleCount, &start, &end);
+    PHASE_START(PHASE_COMPUTE);
+    #pragma omp parallel
+    {
+        int* heap = malloc(nodeCount * sizeof(int));
+        int* heapPos = malloc(nodeCount * sizeof(int));
+        dist_t* from = malloc(nodeCount * sizeof(dist_t));
+        dist_t* to = graph->directed ? malloc(nodeCount * sizeof(dist_t))
+                : from;
+        #pragma omp for schedule(dynamic, 1)
+        for (int s = start; s <= end; s++) {
+            int pivot = pivots[s];
+            dijkstra(csr, pivot, from, heap, heapPos);
+            if (graph->directed) dijkstra(incoming, pivot, to, heap, heapPos);
+            long long eccentricity = 0;
+            for (int v = 0; v < nodeCount; v++) {
+                if (from[v] > eccentricity) eccentricity = from[v];
+            }
+            // Every pivot touches every node, so merge one pivot at a time
+            #pragma omp critical
+            {
+                for (int v = 0; v < nodeCount; v++) {
+                    if (to[v] == DIST_INF || eccentricity == DIST_INF) {
+                        disconnected = 1;
+                        continue;
+                    }
+                    totals[v] += to[v];
+                    if (to[v] > lower[v]) lower[v] = to[v];
+                    long long bound = to[v] + eccentricity;
+                    if (bound < upper[v]) upper[v] = bound;
+                }
+            }
+        }
+        free(heap);
+        free(heapPos);
+        free(from);
+        if (graph->directed) free(to);
+    }
+    PHASE_STOP(PHASE_COMPUTE);
+
+    PHASE_START(PHASE_EXCHANGE);
+    double startTime = MPI_Wtime();
+    MPI_Allreduce(MPI_IN_PLACE, totals, nodeCount, MPI_DOUBLE, MPI_SUM, comm);
+    MPI_Allreduce(MPI_IN_PLACE, lower, nodeCount, MPI_LONG_LONG, MPI_MAX,
+            comm);
+    MPI_Allreduce(MPI_IN_PLACE, upper, nodeCount, MPI_LONG_LONG, MPI_MIN,
+            comm);
+    MPI_Allreduce(MPI_IN_PLACE, &disconnected, 1, MPI_INT, MPI_LOR, comm);
+    timings.com = MPI_Wtime() - startTime;
+    PHASE_STOP(PHASE_EXCHANGE);
+    if (disconnected) {
+        // Paths too long to hold also leave nodes unreached
+        MPI_Allreduce(MPI_IN_PLACE, &distanceOverflow, 1, MPI_INT, MPI_MAX,
+                comm);
+        if (rank == 0 && distanceOverflow) {
+            report_distance_overflow(graph);
+        } else if (rank == 0) {
+            printf("Disconnected subgraph detected, solution undefined\n");
+        }
+        free(totals);
+        free(lower);
+        free(upper);
+        free(pivots);
+        if (incoming != csr) free_csr(incoming);
+        free_csr(csr);
+        return 1;
+    }
+
+    // Verify the candidates exactly, split over ranks and threads like pivots
+    int* candidates = malloc(2 * sampleCount * sizeof(int));
+    int candidateCount = select_candidates(totals, lower, upper, nodeCount,
+            sampleCount, candidates);
+    set_partition(rank, size, candidateCount, &start, &end);
+    long long* localSums = malloc((end - start + 1) * sizeof(long long));
+    long long* localMaxes = malloc((end - start + 1) * sizeof(long long));
+    PHASE_START(PHASE_COMPUTE);
+    #pragma omp parallel
+    {
+        int* heap = malloc(nodeCount * sizeof(int));
+        int* heapPos = malloc(nodeCount * sizeof(int));
+        dist_t* row = malloc(nodeCount * sizeof(dist_t));
+        #pragma omp for schedule(dynamic, 1)
+        for (int c = start; c <= end; c++) {
+            dijkstra(csr, candidates[c], row, heap, heapPos);
+            summarise_row(row, nodeCount, &localSums[c - start],
+                    &localMaxes[c - start]);
+        }
+        free(heap);
+        free(heapPos);
+        free(row);
+    }
+    PHASE_STOP(PHASE_COMPUTE);
+
+    PHASE_START(PHASE_GATHER);
+    startTime = MPI_Wtime();
+    long long* sums = malloc(candidateCount * sizeof(long long));
+    long long* maxes = malloc(candidateCount * sizeof(long long));
+    gather_row_summaries(localSums, localMaxes, sums, maxes, candidateCount,
+            comm);
+    timings.gather = MPI_Wtime() - startTime;
+    PHASE_STOP(PHASE_GATHER);
+
+    if (rank == 0) {
+        *minTotalCentres = min_centres(sums, candidateCount);
+        *minMaxCentres = min_centres(maxes, candidateCount);
+        for (ListNode* node = *minTotalCentres; node != NULL;
+                node = node->next) {
+            node->value = candidates[node->value];
+        }
+        for (ListNode* node = *minMaxCentres; node != NULL; node = node->next) {
+            node->value = candidates[node->value];
+        }
+    }
+
+    free(sums);
+    free(maxes);
+    free(localSums);
+    free(localMaxes);
+    free(candidates);
+    free(totals);
+    free(lower);
+    free(upper);
+    free(pivots);
+    if (incoming != csr) free_csr(incoming);
+    free_csr(csr);
+    return 0;
+}
@@ -0,0 +1,93 @@
+/* =============================================================================
+ * approximate.h Approximate centres from searches out of a sample of pivots,
+ *               verified exactly for the most promising nodes only
+ * =============================================================================
+ */
+
+// Pivots are drawn from this seed, so every rank and every run draws the same
+#define APPROXIMATE_SEED 1
+
+/* A node and its score, for ranking candidate centres.
+ */
+typedef struct {
+    double score;
+    int node;
+} Candidate;
+
+/* Draw the next number from a xorshift generator.
+ * Parameters:
+ *          state - the generator state, updated in place, never 0
+ * Return:
+ *          The next pseudo-random number.
+ */
+unsigned long long next_random(unsigned long long* state);
+
+/* Get the number of pivots needed for a target error.
+ *  Sampling log(|V|) / error^2 pivots estimates every node's average distance
+ *  to within error times the diameter, with high probability.
+ * Parameters:
+ *          nodeCount - the number of nodes in the graph
+ *          error - the target error, greater than 0
+ * Return:
+ *          The number of pivots, at least 1.
+ */
+int sample_count(int nodeCount, double error);
+
+/* Choose distinct pivots uniformly at random.
+ *  A partial Fisher-Yates shuffle from APPROXIMATE_SEED, so every rank
+ *  chooses the same pivots.
+ * Parameters:
+ *          nodeCount - the number of nodes in the graph
+ *          sampleCount - the number of pivots, at most nodeCount
+ *          pivots - out parameter holding the pivots
+ */
+void choose_pivots(int nodeCount, int sampleCount, int* pivots);
+
+/* Order candidates by score, then by node.
+ * Parameters:
+ *          a - the first candidate
+ *          b - the second candidate
+ * Return:
+ *          Negative, zero or positive as a sorts before, with or after b.
+ */
+int compare_candidates(const void* a, const void* b);
+
+/* Choose the nodes to verify exactly.
+ *  The verifyCount nodes with the smallest estimated totals, and the
+ *  verifyCount with the smallest eccentricity lower bounds among those whose
+ *  bound does not already rule them out.
+ * Parameters:
+ *          totals - the estimated total distance from each node
+ *          lower - a lower bound on the eccentricity of each node
+ *          upper - an upper bound on the eccentricity of each node
+ *          nodeCount - the number of nodes in the graph
+ *          verifyCount - the number of candidates for each metric
+ *          candidates - out parameter holding the candidates in ascending
+ *                       order, with room for 2 * verifyCount
+ * Return:
+ *          The number of candidates.
+ */
+int select_candidates(double* totals, long long* lower, long long* upper,
+        int nodeCount, int verifyCount, int* candidates);
+
+/* Find approximate centres by both metrics.
+ *  Dijkstra from sampleCount pivots, split over ranks and threads, estimates
+ *  every node's total distance, Eppstein-Wang style, and bounds its
+ *  eccentricity between its furthest pivot and its distance to a pivot plus
+ *  that pivot's eccentricity. Only the best candidates by each are then
+ *  searched from exactly. Requires non-negative weights and a connected
+ *  graph.
+ * Parameters:
+ *          graph - the graph in question
+ *          sampleCount - the number of pivots, and of candidates verified for
+ *                        each metric, at most the number of nodes
+ *          comm - the communicator the ranks share
+ *          minTotalCentres - out parameter on rank 0 holding the candidates
+ *                            with the least total distance
+ *          minMaxCentres - out parameter on rank 0 holding the candidates
+ *                          with the least maximum distance
+ * Return:
+ *          0 if the centres were found, 1 if the graph could not be solved.
+ */
+int approximate_centres(Graph* graph, int sampleCount, MPI_Comm comm,
+        ListNode** minTotalCentres, ListNode** minMaxCentres);
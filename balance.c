@@ -0,0 +1,230 @@
+/* =============================================================================
+ * balance.c    Dynamic load balancing between ranks of unequal speed, by
+ *              measured throughput or by handing out work on demand
+ * =============================================================================
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <mpi.h>
+#include "helper.h"
+#include "balance.h"
+
+/* Split rows into contiguous ranges in proportion to given weights.
+ *  Every rank keeps at least one row while there are enough, so that its
+ *  throughput can still be measured.
+ * Parameters:
+ *          weights - the weight of each rank
+ *          size - the total number of ranks
+ *          dataSize - the number of rows in the data
+ *          bounds - out parameter of size + 1 entries, rank r owning rows
+ *                   bounds[r] to bounds[r+1] - 1
+ */
+void set_weighted_bounds(double* weights, int size, int dataSize, int* bounds) {
+    double total = 0;
+    for (int r = 0; r < size; r++) {
+        total += weights[r];
+    }
+    int least = dataSize >= size ? 1 : 0;
+    double filled = 0;
+    bounds[0] = 0;
+    for (int r = 1; r < size; r++) {
+        filled += weights[r - 1];
+        int bound = (int) (dataSize * filled / total + 0.5);
+        if (bound < bounds[r - 1] + least) bound = bounds[r - 1] + least;
+        if (bound > dataSize - least * (size - r)) {
+            bound = dataSize - least * (size - r);
+        }
+        bounds[r] = bound;
+    }
+    bounds[size] = dataSize;
+}
+
+/* Get the rank owning a row under given bounds.
+ * Parameters:
+ *          bounds - the bounds of each rank's rows, as from set_weighted_bounds
+ *          size - the total number of ranks
+ *          i - the index of the row being looked-up
+ * Return:
+ *          The rank owning the row.
+ */
+int bound_owner(int* bounds, int size, int i) {
+    int low = 0;
+    int high = size - 1;
+    // The last rank whose first row is at most i, skipping empty ranges
+    while (low < high) {
+        int mid = (low + high + 1) / 2;
+        if (bounds[mid] <= i) {
+            low = mid;
+        } else {
+            high = mid - 1;
+        }
+    }
+    return low;
+}
+
+/* Decide new bounds from the time each rank spent relaxing its rows.
+ *  Each rank's throughput is its rows over its time, and rows are split in
+ *  proportion to throughput once the slowest rank is BALANCE_TOLERANCE
+ *  slower than the mean.
+ * Parameters:
+ *          busy - the time this rank spent relaxing since the last decision
+ *          bounds - the current bounds of each rank's rows
+ *          newBounds - out parameter holding the new bounds
+ *          dataSize - the number of rows in the data
+ *          comm - the communicator the ranks share
+ * Return:
+ *          1 if the bounds changed, 0 otherwise. The same on every rank.
+ */
+int rebalance_bounds(double busy, int* bounds, int* newBounds, int dataSize,
+        MPI_Comm comm) {
+    int size;
+    MPI_Comm_size(comm, &size);
+    double* times = malloc(size * sizeof(double));
+    MPI_Allgather(&busy, 1, MPI_DOUBLE, times, 1, MPI_DOUBLE, comm);
+
+    double slowest = 0;
+    double mean = 0;
+    for (int r = 0; r < size; r++) {
+        if (times[r] > slowest) slowest = times[r];
+        mean += times[r] / size;
+    }
+    int changed = 0;
+    if (slowest > mean * BALANCE_TOLERANCE) {
+        double* throughputs = malloc(size * sizeof(double));
+        double known = 0;
+        int measured = 0;
+        for (int r = 0; r < size; r++) {
+            int rows = bounds[r + 1] - bounds[r];
+            throughputs[r] = times[r] > 0 && rows > 0 ? rows / times[r] : 0;
+            if (throughputs[r] > 0) {
+                known += throughputs[r];
+                measured++;
+            }
+        }
+        // Ranks with nothing to measure are assumed to be average
+        for (int r = 0; r < size; r++) {
+            if (throughputs[r] == 0) {
+                throughputs[r] = measured > 0 ? known / measured : 1;
+            }
+        }
+        set_weighted_bounds(throughputs, size, dataSize, newBounds);
+        for (int r = 0; r <= size; r++) {
+            if (newBounds[r] != bounds[r]) changed = 1;
+        }
+        free(throughputs);
+    }
+    free(times);
+    return changed;
+}
+
+/* Move rows between ranks from old bounds to new ones.
+ * Parameters:
+ *          dist - the row pointers of the matrix, updated to the new rows
+ *          ownRows - in/out parameter holding this rank's contiguous rows,
+ *                    as from alloc_matrix, replaced by the new ones
+ *          bounds - the old bounds, replaced by the new ones
+ *          newBounds - the new bounds
+ *          nodeCount - the length of each row
+ *          comm - the communicator the ranks share
+ */
+void migrate_rows(dist_t** dist, dist_t*** ownRows, int* bounds,
+        int* newBounds, int nodeCount, MPI_Comm comm) {
+    int rank, size;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &size);
+    int start = bounds[rank];
+    int end = bounds[rank + 1] - 1;
+    int newStart = newBounds[rank];
+    int newEnd = newBounds[rank + 1] - 1;
+    dist_t** newRows = alloc_matrix(newEnd - newStart + 1, nodeCount);
+    // Ranges of rows are contiguous, padding included, so each overlap
+    // between an old and a new range moves as a single message
+    size_t stride = matrix_stride(nodeCount);
+
+    MPI_Request* requests = malloc(2 * size * sizeof(MPI_Request));
+    int requestCount = 0;
+    for (int r = 0; r < size; r++) {
+        // Rows this rank now owns that rank r held
+        int first = newStart > bounds[r] ? newStart : bounds[r];
+        int last = newEnd < bounds[r + 1] - 1 ? newEnd : bounds[r + 1] - 1;
+        if (first <= last) {
+            if (r == rank) {
+                memcpy(newRows[first - newStart], dist[first],
+                        (last - first + 1) * stride * sizeof(dist_t));
+            } else {
+                MPI_Irecv(newRows[first - newStart], (last - first + 1)
+                        * stride, MPI_DIST, r, 0, comm,
+                        &requests[requestCount++]);
+            }
+        }
+        // Rows this rank held that rank r now owns
+        first = newBounds[r] > start ? newBounds[r] : start;
+        last = newBounds[r + 1] - 1 < end ? newBounds[r + 1] - 1 : end;
+        if (first <= last && r != rank) {
+            MPI_Isend(dist[first], (last - first + 1) * stride, MPI_DIST, r,
+                    0, comm, &requests[requestCount++]);
+        }
+    }
+    MPI_Waitall(requestCount, requests, MPI_STATUSES_IGNORE);
+    free(requests);
+
+    for (int i = start; i <= end; i++) {
+        dist[i] = NULL;
+    }
+    free_matrix(*ownRows);
+    *ownRows = newRows;
+    for (int i = newStart; i <= newEnd; i++) {
+        dist[i] = newRows[i - newStart];
+    }
+    memcpy(bounds, newBounds, (size + 1) * sizeof(int));
+}
+
+/* Create a counter on rank 0 that ranks claim work from with one-sided
+ *  fetch-and-add, so no rank has to stop and hand work out.
+ * Parameters:
+ *          comm - the communicator the ranks share
+ * Return:
+ *          The window holding the counter, locked for access by every rank,
+ *          to be released with free_work_counter.
+ */
+MPI_Win create_work_counter(MPI_Comm comm) {
+    int rank;
+    MPI_Comm_rank(comm, &rank);
+    int* counter;
+    MPI_Win window;
+    MPI_Win_allocate(rank == 0 ? sizeof(int) : 0, sizeof(int), MPI_INFO_NULL,
+            comm, &counter, &window);
+    if (rank == 0) {
+        MPI_Win_lock(MPI_LOCK_EXCLUSIVE, 0, 0, window);
+        *counter = 0;
+        MPI_Win_unlock(0, window);
+    }
+    // Nobody claims work before the counter starts at zero
+    MPI_Barrier(comm);
+    MPI_Win_lock_all(0, window);
+    return window;
+}
+
+/* Claim the next items of work from a counter.
+ * Parameters:
+ *          counter - the window holding the counter
+ *          count - the number of items to claim
+ * Return:
+ *          The first item claimed, which may be past the last item.
+ */
+int claim_work(MPI_Win counter, int count) {
+    int first;
+    MPI_Fetch_and_op(&count, &first, MPI_INT, 0, 0, MPI_SUM, counter);
+    MPI_Win_flush(0, counter);
+    return first;
+}
+
+/* Release a work counter once every rank has finished claiming from it.
+ * Parameters:
+ *          counter - the window holding the counter
+ */
+void free_work_counter(MPI_Win counter) {
+    MPI_Win_unlock_all(counter);
+    MPI_Win_free(&counter);
+}
@@ -0,0 +1,91 @@
+/* =============================================================================
+ * balance.h    Dynamic load balancing between ranks of unequal speed, by
+ *              measured throughput or by handing out work on demand
+ * =============================================================================
+ */
+
+// Floyd-Warshall iterations between measurements of each rank's throughput
+#define BALANCE_INTERVAL 64
+
+// Rows only move when the slowest rank took this much longer than the mean
+#define BALANCE_TOLERANCE 1.1
+
+// Sources are claimed in chunks of the remainder over this many per rank,
+// so chunks shrink towards the end and no rank is left with a large one
+#define SOURCE_CHUNK_DIVISOR 4
+
+/* Split rows into contiguous ranges in proportion to given weights.
+ *  Every rank keeps at least one row while there are enough, so that its
+ *  throughput can still be measured.
+ * Parameters:
+ *          weights - the weight of each rank
+ *          size - the total number of ranks
+ *          dataSize - the number of rows in the data
+ *          bounds - out parameter of size + 1 entries, rank r owning rows
+ *                   bounds[r] to bounds[r+1] - 1
+ */
+void set_weighted_bounds(double* weights, int size, int dataSize, int* bounds);
+
+/* Get the rank owning a row under given bounds.
+ * Parameters:
+ *          bounds - the bounds of each rank's rows, as from set_weighted_bounds
+ *          size - the total number of ranks
+ *          i - the index of the row being looked-up
+ * Return:
+ *          The rank owning the row.
+ */
+int bound_owner(int* bounds, int size, int i);
+
+/* Decide new bounds from the time each rank spent relaxing its rows.
+ *  Each rank's throughput is its rows over its time, and rows are split in
+ *  proportion to throughput once the slowest rank is BALANCE_TOLERANCE
+ *  slower than the mean.
+ * Parameters:
+ *          busy - the time this rank spent relaxing since the last decision
+ *          bounds - the current bounds of each rank's rows
+ *          newBounds - out parameter holding the new bounds
+ *          dataSize - the number of rows in the data
+ *          comm - the communicator the ranks share
+ * Return:
+ *          1 if the bounds changed, 0 otherwise. The same on every rank.
+ */
+int rebalance_bounds(double busy, int* bounds, int* newBounds, int dataSize,
+        MPI_Comm comm);
+
+/* Move rows between ranks from old bounds to new ones.
+ * Parameters:
+ *          dist - the row pointers of the matrix, updated to the new rows
+ *          ownRows - in/out parameter holding this rank's contiguous rows,
+ *                    as from alloc_matrix, replaced by the new ones
+ *          bounds - the old bounds, replaced by the new ones
+ *          newBounds - the new bounds
+ *          nodeCount - the length of each row
+ *          comm - the communicator the ranks share
+ */
+void migrate_rows(dist_t** dist, dist_t*** ownRows, int* bounds,
+        int* newBounds, int nodeCount, MPI_Comm comm);
+
+/* Create a counter on rank 0 that ranks claim work from with one-sided
+ *  fetch-and-add, so no rank has to stop and hand work out.
+ * Parameters:
+ *          comm - the communicator the ranks share
+ * Return:
+ *          The window holding the counter, locked for access by every rank,
+ *          to be released with free_work_counter.
+ */
+MPI_Win create_work_counter(MPI_Comm comm);
+
+/* Claim the next items of work from a counter.
+ * Parameters:
+ *          counter - the window holding the counter
+ *          count - the number of items to claim
+ * Return:
+ *          The first item claimed, which may be past the last item.
+ */
+int claim_work(MPI_Win counter, int count);
+
+/* Release a work counter once every rank has finished claiming from it.
+ * Parameters:
+ *          counter - the window holding the counter
+ */
+void free_work_counter(MPI_Win counter);
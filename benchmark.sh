@@ -0,0 +1,75 @@
+#!/bin/bash
+# Benchmark the solver on generated graphs across rank and thread counts.
+# Usage: benchmark.sh [solver options...]
+#
+# Configured through the environment, each list space-separated:
+#   BENCH_GRAPHS   graph types to generate (complete random grid powerlaw
+#                  disconnected)
+#   BENCH_SIZES    node counts (500 1000)
+#   BENCH_RANKS    MPI rank counts (1 2)
+#   BENCH_THREADS  OMP_NUM_THREADS values (1 2)
+#   BENCH_DEGREE   average connections per node (8)
+#   BENCH_SEED     generator seed (1)
+#   BENCH_DIR      where graphs and results are written (bench)
+#   MPIRUN         the launcher, e.g. "mpirun --oversubscribe" (mpirun)
+#
+# Writes results.csv and results.json to BENCH_DIR, one record per run with
+# the slowest rank's load, compute, communication and gather seconds and the
+# largest peak RSS. Graphs are kept between runs, so sizes are reproducible
+# and only generated once.
+
+GRAPHS=${BENCH_GRAPHS:-complete random grid powerlaw disconnected}
+SIZES=${BENCH_SIZES:-500 1000}
+RANKS=${BENCH_RANKS:-1 2}
+THREADS=${BENCH_THREADS:-1 2}
+DEGREE=${BENCH_DEGREE:-8}
+SEED=${BENCH_SEED:-1}
+DIR=${BENCH_DIR:-bench}
+MPIRUN=${MPIRUN:-mpirun}
+
+mkdir -p $DIR
+CSV=$DIR/results.csv
+JSON=$DIR/results.json
+echo "graph,nodes,edges,ranks,threads,status,load,compute,com,gather,peak_rss_kb,total" > $CSV
+echo "[" > $JSON
+FIRST=1
+
+for GRAPH in $GRAPHS; do
+    for NODES in $SIZES; do
+        FILE=$DIR/$GRAPH-$NODES-d$DEGREE-s$SEED.graph
+        if [ ! -f $FILE ]; then
+            ./graph-generator -d $DEGREE -s $SEED $GRAPH $NODES $FILE || exit 1
+        fi
+        EDGES=$(sed -n 2p $FILE)
+        for NP in $RANKS; do
+            for NT in $THREADS; do
+                export OMP_NUM_THREADS=$NT
+                START=$(date +%s.%N)
+                OUTPUT=$($MPIRUN -n $NP ./centrality-solver -t "$@" $FILE 2>&1)
+                STATUS=$?
+                TOTAL=$(awk "BEGIN { printf \"%f\", $(date +%s.%N) - $START }")
+                # Disconnected graphs fail after solving, so times still count
+                TIMINGS=$(echo "$OUTPUT" | grep "^timings," | cut -d, -f2-)
+                if [ -z "$TIMINGS" ]; then
+                    TIMINGS=",,,,"
+                fi
+                echo "$GRAPH,$NODES,$EDGES,$NP,$NT,$STATUS,$TIMINGS,$TOTAL" \
+                    | tee -a $CSV
+
+                IFS=, read LOAD COMPUTE COM GATHER RSS <<< "$TIMINGS"
+                [ $FIRST = 1 ] || echo "," >> $JSON
+                FIRST=0
+                printf '  {"graph": "%s", "nodes": %s, "edges": %s, ' \
+                    $GRAPH $NODES $EDGES >> $JSON
+                printf '"ranks": %s, "threads": %s, "status": %s, ' \
+                    $NP $NT $STATUS >> $JSON
+                printf '"load": %s, "compute": %s, "com": %s, ' \
+                    ${LOAD:-null} ${COMPUTE:-null} ${COM:-null} >> $JSON
+                printf '"gather": %s, "peak_rss_kb": %s, "total": %s}' \
+                    ${GATHER:-null} ${RSS:-null} $TOTAL >> $JSON
+            done
+        done
+    done
+done
+echo "" >> $JSON
+echo "]" >> $JSON
@@ -0,0 +1,233 @@
+/* =============================================================================
+ * betweenness.c Betweenness centrality by Brandes' algorithm, from per-source
+ *              shortest path searches split over ranks and threads
+ * =============================================================================
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <omp.h>
+#include <mpi.h>
+#include "helper.h"
+#include "sparse.h"
+#include "approximate.h"
+#include "instrument.h"
+#include "betweenness.h"
+
+/* Check that every edge of a graph has a positive weight.
+ *  Paths are only counted correctly when no edge keeps the distance the same.
+ * Parameters:
+ *          graph - the graph in question
+ * Return:
+ *          1 if every weight is positive, 0 otherwise.
+ */
+int has_positive_weights(Graph* graph) {
+    for (int e = 0; e < graph->edgeCount; e++) {
+        if (graph->edgeWeights[e] <= 0) return 0;
+    }
+    return 1;
+}
+
+/* Add the dependencies of every node on one source to their scores.
+ *  Dijkstra from the source counts the shortest paths to each node, and the
+ *  nodes are then visited furthest first, each passing its dependency back
+ *  to the nodes it is reached through (Brandes).
+ * Parameters:
+ *          csr - the adjacency of the graph, with positive weights
+ *          source - the node the paths start from
+ *          dist - workspace for the length of each shortest path
+ *          paths - workspace for the number of shortest paths to each node
+ *          dependency - workspace for the dependency of the source on each
+ *                       node
+ *          order - workspace for the nodes in the order they are settled
+ *          heap - workspace for the heap, one entry per node
+ *          heapPos - workspace for heap positions, one entry per node
+ *          scores - the score of each node, added to in place
+ */
+void brandes(CSRGraph* csr, int source, dist_t* dist, double* paths,
+        double* dependency, int* order, int* heap, int* heapPos,
+        double* scores) {
+    // Heap position -1 marks an unseen node, -2 a settled one, and -3 one
+    // reached only by paths too long to hold
+    for (int i = 0; i < csr->nodeCount; i++) {
+        dist[i] = DIST_INF;
+        heapPos[i] = -1;
+        paths[i] = 0;
+        dependency[i] = 0;
+    }
+    dist[source] = 0;
+    paths[source] = 1;
+    heap[0] = source;
+    heapPos[source] = 0;
+    int heapSize = 1;
+    int settled = 0;
+
+    while (heapSize > 0) {
+        int u = heap[0];
+        heapPos[u] = -2;
+        order[settled++] = u;
+        heapSize--;
+        if (heapSize > 0) {
+            heap[0] = heap[heapSize];
+            heapPos[heap[0]] = 0;
+            heap_sift_down(heap, heapPos, dist, heapSize, 0);
+        }
+
+        for (int e = csr->rowStart[u]; e < csr->rowStart[u + 1]; e++) {
+            int v = csr->neighbours[e];
+            if (heapPos[v] == -2) continue;
+            dist_t candidate;
+            if (!checkedDistances) {
+                candidate = dist[u] + csr->weights[e];
+            } else if (add_distances(dist[u], csr->weights[e], &candidate)) {
+                // As in dijkstra, too long to hold unless reached otherwise
+                if (heapPos[v] == -1) heapPos[v] = -3;
+                continue;
+            }
+            if (candidate < dist[v]) {
+                dist[v] = candidate;
+                paths[v] = paths[u];
+                if (heapPos[v] < 0) {
+                    heap[heapSize] = v;
+                    heapPos[v] = heapSize;
+                    heapSize++;
+                }
+                heap_sift_up(heap, heapPos, dist, heapPos[v]);
+            } else if (candidate == dist[v]) {
+                paths[v] += paths[u];
+            }
+        }
+    }
+
+    if (checkedDistances) {
+        for (int i = 0; i < csr->nodeCount; i++) {
+            if (heapPos[i] == -3) mark_distance_overflow();
+        }
+    }
+
+    // Weights are positive, so every node a shortest path continues to was
+    // settled later, and its dependency is complete by the time it is read
+    for (int s = settled - 1; s > 0; s--) {
+        int v = order[s];
+        for (int e = csr->rowStart[v]; e < csr->rowStart[v + 1]; e++) {
+            int w = csr->neighbours[e];
+            // Compared as a difference, which cannot overflow
+            if (dist[w] != DIST_INF && dist[w] - dist[v] == csr->weights[e]) {
+                dependency[v] += paths[v] / paths[w] * (1 + dependency[w]);
+            }
+        }
+        scores[v] += dependency[v];
+    }
+}
+
+/* Find the betweenness centrality of every node, the number of shortest
+ *  paths between other nodes passing through it, each pair's paths counting
+ *  once in total. Sources are split over ranks and shared dynamically between
+ *  threads, each thread accumulating scores of its own, and the ranks' scores
+ *  are summed on rank 0.
+ * Parameters:
+ *          graph - the graph in question, as accepted by has_positive_weights
+ *          sampleCount - if between 0 and the node count, the number of
+ *                        sources sampled, whose scores are scaled up to
+ *                        estimate the whole graph's
+ *          comm - the communicator the ranks share
+ *          scores - out parameter on rank 0 holding the score of each node
+ */
+void betweenness_centrality(Graph* graph, int sampleCount, MPI_Comm comm,
+        double* scores) {
+    int rank, size;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &size);
+    int nodeCount = graph->nodeCount;
+
+    PHASE_START(PHASE_MATRIX_INIT);
+    CSRGraph* csr = build_csr(graph);
+    int sourceCount = sampleCount > 0 && sampleCount < nodeCount
+            ? sampleCount : nodeCount;
+    int* sources = malloc(sourceCount * sizeof(int));
+    if (sourceCount < nodeCount) {
+        choose_pivots(nodeCount, sourceCount, sources);
+    } else {
+        for (int i = 0; i < nodeCount; i++) {
+            sources[i] = i;
+        }
+    }
+    int start, end;
+    set_partition(rank, size, sourceCount, &start, &end);
+    double* localScores = calloc(nodeCount, sizeof(double));
+    PHASE_STOP(PHASE_MATRIX_INIT);
+
+    PHASE_START(PHASE_COMPUTE);
+    #pragma omp parallel
+    {
+        dist_t* dist = malloc(nodeCount * sizeof(dist_t));
+        double* paths = malloc(nodeCount * sizeof(double));
+        double* dependency = malloc(nodeCount * sizeof(double));
+        int* order = malloc(nodeCount * sizeof(int));
+        int* heap = malloc(nodeCount * sizeof(int));
+        int* heapPos = malloc(nodeCount * sizeof(int));
+        double* threadScores = calloc(nodeCount, sizeof(double));
+        // Searches end at different depths, so hand sources out dynamically
+        #pragma omp for schedule(dynamic, 1)
+        for (int s = start; s <= end; s++) {
+            brandes(csr, sources[s], dist, paths, dependency, order, heap,
+                    heapPos, threadScores);
+        }
+        #pragma omp critical
+        for (int i = 0; i < nodeCount; i++) {
+            localScores[i] += threadScores[i];
+        }
+        free(dist);
+        free(paths);
+        free(dependency);
+        free(order);
+        free(heap);
+        free(heapPos);
+        free(threadScores);
+    }
+    PHASE_STOP(PHASE_COMPUTE);
+    free_csr(csr);
+    free(sources);
+
+    PHASE_START(PHASE_GATHER);
+    MPI_Reduce(localScores, scores, nodeCount, MPI_DOUBLE, MPI_SUM, 0, comm);
+    PHASE_STOP(PHASE_GATHER);
+    free(localScores);
+
+    // Two-way paths are found from both their ends, and samples stand for
+    // every source
+    if (rank == 0) {
+        double scale = (graph->directed ? 1.0 : 0.5) * nodeCount / sourceCount;
+        for (int i = 0; i < nodeCount; i++) {
+            scores[i] *= scale;
+        }
+    }
+}
+
+/* Find the nodes with the highest betweenness, in ascending order.
+ * Parameters:
+ *          scores - the betweenness of each node
+ *          nodeCount - the number of nodes
+ * Return:
+ *          The head of a list of the nodes sharing the highest betweenness,
+ *          within BETWEENNESS_TIE_TOLERANCE.
+ */
+ListNode* max_betweenness_centres(double* scores, int nodeCount) {
+    double best = 0;
+    for (int i = 0; i < nodeCount; i++) {
+        if (scores[i] > best) best = scores[i];
+    }
+    // Iterate backwards so that list is in appearance order
+    ListNode* centres = NULL;
+    int length = 0;
+    for (int i = nodeCount - 1; i >= 0; i--) {
+        if (scores[i] < best - best * BETWEENNESS_TIE_TOLERANCE) continue;
+        ListNode* next = malloc(sizeof(ListNode));
+        next->value = i;
+        next->next = centres;
+        next->length = ++length;
+        centres = next;
+    }
+    return centres;
+}
@@ -0,0 +1,64 @@
+/* =============================================================================
+ * betweenness.h Betweenness centrality by Brandes' algorithm, from per-source
+ *              shortest path searches split over ranks and threads
+ * =============================================================================
+ */
+
+// Scores this close to the highest, relative to it, are taken as ties, since
+// threads and ranks add up each node's dependencies in varying orders
+#define BETWEENNESS_TIE_TOLERANCE 1e-9
+
+/* Check that every edge of a graph has a positive weight.
+ *  Paths are only counted correctly when no edge keeps the distance the same.
+ * Parameters:
+ *          graph - the graph in question
+ * Return:
+ *          1 if every weight is positive, 0 otherwise.
+ */
+int has_positive_weights(Graph* graph);
+
+/* Add the dependencies of every node on one source to their scores.
+ *  Dijkstra from the source counts the shortest paths to each node, and the
+ *  nodes are then visited furthest first, each passing its dependency back
+ *  to the nodes it is reached through (Brandes).
+ * Parameters:
+ *          csr - the adjacency of the graph, with positive weights
+ *          source - the node the paths start from
+ *          dist - workspace for the length of each shortest path
+ *          paths - workspace for the number of shortest paths to each node
+ *          dependency - workspace for the dependency of the source on each
+ *                       node
+ *          order - workspace for the nodes in the order they are settled
+ *          heap - workspace for the heap, one entry per node
+ *          heapPos - workspace for heap positions, one entry per node
+ *          scores - the score of each node, added to in place
+ */
+void brandes(CSRGraph* csr, int source, dist_t* dist, double* paths,
+        double* dependency, int* order, int* heap, int* heapPos,
+        double* scores);
+
+/* Find the betweenness centrality of every node, the number of shortest
+ *  paths between other nodes passing through it, each pair's paths counting
+ *  once in total. Sources are split over ranks and shared dynamically between
+ *  threads, each thread accumulating scores of its own, and the ranks' scores
+ *  are summed on rank 0.
+ * Parameters:
+ *          graph - the graph in question, as accepted by has_positive_weights
+ *          sampleCount - if between 0 and the node count, the number of
+ *                        sources sampled, whose scores are scaled up to
+ *                        estimate the whole graph's
+ *          comm - the communicator the ranks share
+ *          scores - out parameter on rank 0 holding the score of each node
+ */
+void betweenness_centrality(Graph* graph, int sampleCount, MPI_Comm comm,
+        double* scores);
+
+/* Find the nodes with the highest betweenness, in ascending order.
+ * Parameters:
+ *          scores - the betweenness of each node
+ *          nodeCount - the number of nodes
+ * Return:
+ *          The head of a list of the nodes sharing the highest betweenness,
+ *          within BETWEENNESS_TIE_TOLERANCE.
+ */
+ListNode* max_betweenness_centres(double* scores, int nodeCount);
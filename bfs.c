@@ -0,0 +1,196 @@
+/* =============================================================================
+ * bfs.c        Bit-parallel multi-source breadth-first search, for graphs
+ *              whose edges all share one weight
+ * =============================================================================
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <limits.h>
+#include <omp.h>
+#include <mpi.h>
+#include "helper.h"
+#include "sparse.h"
+#include "instrument.h"
+#include "bfs.h"
+
+/* Find the weight every edge of a graph shares.
+ * Parameters:
+ *          graph - the graph in question
+ * Return:
+ *          The weight of every edge, 1 if there are none, or -1 if the weights
+ *          differ or are negative.
+ */
+int uniform_weight(Graph* graph) {
+    if (graph->edgeCount == 0) return 1;
+    int weight = graph->edgeWeights[0];
+    if (weight < 0) return -1;
+    for (int e = 1; e < graph->edgeCount; e++) {
+        if (graph->edgeWeights[e] != weight) return -1;
+    }
+    return weight;
+}
+
+/* Search from a batch of sources at once, one bit of each node's words per
+ *  source (MS-BFS). Each level pushes every frontier node's bits to its
+ *  neighbours, so sources whose searches meet share the work from there.
+ *  Row totals and eccentricities in hops are counted as nodes are reached.
+ * Parameters:
+ *          csr - the adjacency of the graph
+ *          first - the first source of the batch
+ *          count - the number of sources in the batch, at most BFS_BATCH
+ *          seen - workspace of BFS_WORDS words per node
+ *          visit - workspace of BFS_WORDS words per node
+ *          next - workspace of BFS_WORDS words per node
+ *          sums - out parameter holding the total hops from each source,
+ *                 LLONG_MAX if any node is unreachable
+ *          maxes - out parameter holding the most hops from each source,
+ *                  LLONG_MAX if any node is unreachable
+ */
+void ms_bfs(CSRGraph* csr, int first, int count, uint64_t* seen,
+        uint64_t* visit, uint64_t* next, long long* sums, long long* maxes) {
+    int nodeCount = csr->nodeCount;
+    size_t words = (size_t) nodeCount * BFS_WORDS;
+    memset(seen, 0, words * sizeof(uint64_t));
+    memset(visit, 0, words * sizeof(uint64_t));
+    memset(next, 0, words * sizeof(uint64_t));
+    int reached[BFS_BATCH];
+    for (int b = 0; b < count; b++) {
+        uint64_t bit = (uint64_t) 1 << (b % 64);
+        seen[(size_t) (first + b) * BFS_WORDS + b / 64] |= bit;
+        visit[(size_t) (first + b) * BFS_WORDS + b / 64] |= bit;
+        sums[b] = 0;
+        maxes[b] = 0;
+        reached[b] = 1;
+    }
+
+    for (long long level = 1; ; level++) {
+        // Push every frontier to its neighbours, whole words at a time
+        for (int v = 0; v < nodeCount; v++) {
+            uint64_t* frontier = &visit[(size_t) v * BFS_WORDS];
+            uint64_t any = 0;
+            for (int w = 0; w < BFS_WORDS; w++) {
+                any |= frontier[w];
+            }
+            if (any == 0) continue;
+            for (int e = csr->rowStart[v]; e < csr->rowStart[v + 1]; e++) {
+                uint64_t* target = &next[(size_t) csr->neighbours[e]
+                        * BFS_WORDS];
+                for (int w = 0; w < BFS_WORDS; w++) {
+                    target[w] |= frontier[w];
+                }
+            }
+        }
+
+        // Bits new to a node are the sources reaching it at this level,
+        // and become the next frontier
+        uint64_t levelBits[BFS_WORDS] = {0};
+        for (int v = 0; v < nodeCount; v++) {
+            size_t offset = (size_t) v * BFS_WORDS;
+            for (int w = 0; w < BFS_WORDS; w++) {
+                uint64_t fresh = next[offset + w] & ~seen[offset + w];
+                next[offset + w] = 0;
+                visit[offset + w] = fresh;
+                seen[offset + w] |= fresh;
+                levelBits[w] |= fresh;
+                while (fresh != 0) {
+                    int b = w * 64 + __builtin_ctzll(fresh);
+                    sums[b] += level;
+                    reached[b]++;
+                    fresh &= fresh - 1;
+                }
+            }
+        }
+
+        int active = 0;
+        for (int w = 0; w < BFS_WORDS; w++) {
+            uint64_t bits = levelBits[w];
+            if (bits != 0) active = 1;
+            while (bits != 0) {
+                maxes[w * 64 + __builtin_ctzll(bits)] = level;
+                bits &= bits - 1;
+            }
+        }
+        if (!active) break;
+    }
+
+    for (int b = 0; b < count; b++) {
+        if (reached[b] < nodeCount) {
+            sums[b] = LLONG_MAX;
+            maxes[b] = LLONG_MAX;
+        }
+    }
+}
+
+/* Find the total and maximum shortest path length from every node of a
+ *  graph whose edges all share one weight.
+ *  Every path is then that weight times its hops, so batches of sources are
+ *  searched breadth-first together with ms_bfs, split over ranks and shared
+ *  dynamically between threads, for O(|V||E| / BFS_BATCH) word operations.
+ *  Only row summaries are kept, never the distances themselves.
+ * Parameters:
+ *          graph - the graph in question, as accepted by uniform_weight
+ *          comm - the communicator the ranks share
+ *          sums - out parameter on rank 0 holding the total of each row
+ *          maxes - out parameter on rank 0 holding the maximum of each row
+ */
+void bfs_all_pair_summaries(Graph* graph, MPI_Comm comm, long long* sums,
+        long long* maxes) {
+    int rank, size;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &size);
+    int nodeCount = graph->nodeCount;
+    long long weight = uniform_weight(graph);
+
+    PHASE_START(PHASE_MATRIX_INIT);
+    CSRGraph* csr = build_csr(graph);
+    int start, end;
+    set_partition(rank, size, nodeCount, &start, &end);
+    long long* localSums = malloc((end - start + 1) * sizeof(long long));
+    long long* localMaxes = malloc((end - start + 1) * sizeof(long long));
+    int batchCount = (end - start + BFS_BATCH) / BFS_BATCH;
+    PHASE_STOP(PHASE_MATRIX_INIT);
+    // Sources are independent, so the only communication is the gather
+    timings.com = 0;
+
+    PHASE_START(PHASE_COMPUTE);
+    #pragma omp parallel
+    {
+        size_t words = (size_t) nodeCount * BFS_WORDS;
+        uint64_t* seen = malloc(words * sizeof(uint64_t));
+        uint64_t* visit = malloc(words * sizeof(uint64_t));
+        uint64_t* next = malloc(words * sizeof(uint64_t));
+        // Batches meet at different depths, so hand them out dynamically
+        #pragma omp for schedule(dynamic, 1)
+        for (int batch = 0; batch < batchCount; batch++) {
+            int first = start + batch * BFS_BATCH;
+            int count = end - first + 1 < BFS_BATCH ? end - first + 1
+                    : BFS_BATCH;
+            ms_bfs(csr, first, count, seen, visit, next,
+                    &localSums[first - start], &localMaxes[first - start]);
+            for (int i = first - start; i < first - start + count; i++) {
+                if (localMaxes[i] == LLONG_MAX) continue;
+                // Only a total can exceed a long long, many paths long
+                if (__builtin_mul_overflow(localSums[i], weight,
+                        &localSums[i])) {
+                    mark_distance_overflow();
+                }
+                localMaxes[i] *= weight;
+            }
+        }
+        free(seen);
+        free(visit);
+        free(next);
+    }
+    PHASE_STOP(PHASE_COMPUTE);
+    free_csr(csr);
+
+    PHASE_START(PHASE_GATHER);
+    double startTime = MPI_Wtime();
+    gather_row_summaries(localSums, localMaxes, sums, maxes, nodeCount, comm);
+    timings.gather = MPI_Wtime() - startTime;
+    PHASE_STOP(PHASE_GATHER);
+    free(localSums);
+    free(localMaxes);
+}
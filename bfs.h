@@ -0,0 +1,53 @@
+/* =============================================================================
+ * bfs.h        Bit-parallel multi-source breadth-first search, for graphs
+ *              whose edges all share one weight
+ * =============================================================================
+ */
+
+// Words of sources searched together, one bit each, so a batch of
+// 64 * BFS_WORDS sources moves through the graph as one 512-bit vector a node
+#define BFS_WORDS 8
+#define BFS_BATCH (64 * BFS_WORDS)
+
+/* Find the weight every edge of a graph shares.
+ * Parameters:
+ *          graph - the graph in question
+ * Return:
+ *          The weight of every edge, 1 if there are none, or -1 if the weights
+ *          differ or are negative.
+ */
+int uniform_weight(Graph* graph);
+
+/* Search from a batch of sources at once, one bit of each node's words per
+ *  source (MS-BFS). Each level pushes every frontier node's bits to its
+ *  neighbours, so sources whose searches meet share the work from there.
+ *  Row totals and eccentricities in hops are counted as nodes are reached.
+ * Parameters:
+ *          csr - the adjacency of the graph
+ *          first - the first source of the batch
+ *          count - the number of sources in the batch, at most BFS_BATCH
+ *          seen - workspace of BFS_WORDS words per node
+ *          visit - workspace of BFS_WORDS words per node
+ *          next - workspace of BFS_WORDS words per node
+ *          sums - out parameter holding the total hops from each source,
+ *                 LLONG_MAX if any node is unreachable
+ *          maxes - out parameter holding the most hops from each source,
+ *                  LLONG_MAX if any node is unreachable
+ */
+void ms_bfs(CSRGraph* csr, int first, int count, uint64_t* seen,
+        uint64_t* visit, uint64_t* next, long long* sums, long long* maxes);
+
+/* Find the total and maximum shortest path length from every node of a
+ *  graph whose edges all share one weight.
+ *  Every path is then that weight times its hops, so batches of sources are
+ *  searched breadth-first together with ms_bfs, split over ranks and shared
+ *  dynamically between threads, for O(|V||E| / BFS_BATCH) word operations.
+ *  Only row summaries are kept, never the distances themselves.
+ * Parameters:
+ *          graph - the graph in question, as accepted by uniform_weight
+ *          comm - the communicator the ranks share
+ *          sums - out parameter on rank 0 holding the total of each row
+ *          maxes - out parameter on rank 0 holding the maximum of each row
+ */
+void bfs_all_pair_summaries(Graph* graph, MPI_Comm comm, long long* sums,
+        long long* maxes);
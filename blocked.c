@@ -0,0 +1,374 @@
+/* =============================================================================
+ * blocked.c    Blocked (tiled) Floyd-Warshall over a 2D block-cyclic
+ *              distribution of the distance matrix
+ * =============================================================================
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <omp.h>
+#include <mpi.h>
+#include "helper.h"
+#include "blocked.h"
+#include "kernel.h"
+#include "instrument.h"
+
+/* Relax every path in tile a through the intermediate nodes of one block.
+ *  That is, a[i][j] = min(a[i][j], b[i][k] + c[k][j]) for each k in the block.
+ *  The tiles may alias, which gives the diagonal (a == b == c), row panel
+ *  (a == c) and column panel (a == b) updates of blocked Floyd-Warshall.
+ * Parameters:
+ *          a - the tile being updated
+ *          b - the tile holding paths into the intermediate block
+ *          c - the tile holding paths out of the intermediate block
+ *          blockSize - the width of each square tile
+ */
+void fw_tile(dist_t* a, dist_t* b, dist_t* c, int blockSize) {
+    for (int k = 0; k < blockSize; k++) {
+        dist_t* rowC = &c[k * blockSize];
+        for (int i = 0; i < blockSize; i++) {
+            // Extract loop invariant access
+            dist_t distIK = b[i * blockSize + k];
+            if (distIK == DIST_INF) continue;
+            min_plus(&a[i * blockSize], rowC, distIK, blockSize);
+        }
+    }
+}
+
+/* Get the number of blocks in one dimension owned by a grid row or column.
+ * Parameters:
+ *          gridIndex - the row or column of the process grid
+ *          gridSize - the number of rows or columns in the process grid
+ *          blockCount - the number of blocks in that dimension
+ * Return:
+ *          The number of blocks owned.
+ */
+int local_block_count(int gridIndex, int gridSize, int blockCount) {
+    if (gridIndex >= blockCount) return 0;
+    return (blockCount - gridIndex + gridSize - 1) / gridSize;
+}
+
+/* Find where a rank keeps an entry of the distance matrix among its tiles.
+ * Parameters:
+ *          i - the row of the entry
+ *          j - the column of the entry
+ *          gridRow - the rank's row in the process grid
+ *          gridCol - the rank's column in the process grid
+ *          gridRows - the number of rows in the process grid
+ *          gridCols - the number of columns in the process grid
+ *          localCols - the number of block columns the rank owns
+ *          blockSize - the width of each square tile
+ * Return:
+ *          The offset of the entry in the rank's tiles, stored row-major by
+ *          local block index, or -1 if another rank owns it.
+ */
+long long owned_tile_offset(int i, int j, int gridRow, int gridCol,
+        int gridRows, int gridCols, int localCols, int blockSize) {
+    int bi = i / blockSize;
+    int bj = j / blockSize;
+    if (bi % gridRows != gridRow || bj % gridCols != gridCol) return -1;
+    long long tile = (long long) (bi / gridRows) * localCols + bj / gridCols;
+    return tile * blockSize * blockSize + (i % blockSize) * blockSize
+            + j % blockSize;
+}
+
+/* Set one row of a rank's tiles to the distances before any relaxation.
+ *  That is 0 on the diagonal, padding included, and DIST_INF elsewhere.
+ * Parameters:
+ *          tiles - the tiles of the local block row
+ *          lbi - the local index of the block row
+ *          gridRow - the rank's row in the process grid
+ *          gridCol - the rank's column in the process grid
+ *          gridRows - the number of rows in the process grid
+ *          gridCols - the number of columns in the process grid
+ *          localCols - the number of block columns the rank owns
+ *          blockSize - the width of each square tile
+ */
+void init_tile_row(dist_t* tiles, int lbi, int gridRow, int gridCol,
+        int gridRows, int gridCols, int localCols, int blockSize) {
+    size_t tileArea = (size_t) blockSize * blockSize;
+    int rowOffset = (lbi * gridRows + gridRow) * blockSize;
+    for (int lbj = 0; lbj < localCols; lbj++) {
+        dist_t* tile = &tiles[lbj * tileArea];
+        int colOffset = (lbj * gridCols + gridCol) * blockSize;
+        for (int ti = 0; ti < blockSize; ti++) {
+            for (int tj = 0; tj < blockSize; tj++) {
+                tile[ti * blockSize + tj] = rowOffset + ti == colOffset + tj 
+                        ? 0 : DIST_INF;
+            }
+        }
+    }
+}
+
+/* Copy the tiles owned by one rank into their place in the full matrix.
+ * Parameters:
+ *          dist - the full distance matrix
+ *          tiles - the rank's tiles, stored row-major by local block index
+ *          gridRow - the rank's row in the process grid
+ *          gridCol - the rank's column in the process grid
+ *          gridRows - the number of rows in the process grid
+ *          gridCols - the number of columns in the process grid
+ *          blockSize - the width of each square tile
+ *          nodeCount - the number of rows in the full matrix
+ */
+void unpack_tiles(dist_t** dist, dist_t* tiles, int gridRow, int gridCol,
+        int gridRows, int gridCols, int blockSize, int nodeCount) {
+    int blockCount = (nodeCount + blockSize - 1) / blockSize;
+    int localRows = local_block_count(gridRow, gridRows, blockCount);
+    int localCols = local_block_count(gridCol, gridCols, blockCount);
+    size_t tileArea = (size_t) blockSize * blockSize;
+
+    for (int lbi = 0; lbi < localRows; lbi++) {
+        for (int lbj = 0; lbj < localCols; lbj++) {
+            dist_t* tile = &tiles[(lbi * localCols + lbj) * tileArea];
+            int rowOffset = (lbi * gridRows + gridRow) * blockSize;
+            int colOffset = (lbj * gridCols + gridCol) * blockSize;
+            for (int ti = 0; ti < blockSize; ti++) {
+                int i = rowOffset + ti;
+                if (i >= nodeCount) break;
+                for (int tj = 0; tj < blockSize; tj++) {
+                    int j = colOffset + tj;
+                    if (j >= nodeCount) break;
+                    dist[i][j] = tile[ti * blockSize + tj];
+                }
+            }
+        }
+    }
+}
+
+/* Populate matrix of shortest paths between all pairs of nodes.
+ *  Use blocked Floyd-Warshall, with the matrix split into square tiles dealt
+ *  out block-cyclically over a 2D grid of ranks. Each block-step closes the
+ *  diagonal tile, then the row and column panels through it, then every
+ *  remaining tile, so communication happens once per block rather than once
+ *  per node.
+ * Parameters:
+ *          graph - the graph in question
+ *          blockSize - the width of each square tile
+ *          comm - the communicator the ranks share
+ *          sums - if not NULL, out parameter on rank 0 holding the total of
+ *                 each row, gathered in place of the matrix
+ *          maxes - if not NULL, out parameter on rank 0 holding the maximum
+ *                  of each row, gathered in place of the matrix
+ * Return:
+ *          On rank 0, a matrix containing the length of the shortest paths
+ *          between all nodes, or NULL if row summaries were gathered instead.
+ *          NULL on every other rank.
+ */
+dist_t** blocked_all_pair_shortest_path(Graph* graph, int blockSize,
+        MPI_Comm comm, long long* sums, long long* maxes) {
+    int rank, size;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &size);
+
+    // Arrange ranks in as square a grid as possible, which minimises the
+    // panel volume each rank has to receive
+    int dims[2] = {0, 0};
+    MPI_Dims_create(size, 2, dims);
+    int gridRows = dims[0];
+    int gridCols = dims[1];
+    int gridRow = rank / gridCols;
+    int gridCol = rank % gridCols;
+
+    // Row communicator ranks are ordered by grid column and vice versa, so
+    // grid coordinates can be used directly as broadcast roots
+    MPI_Comm rowComm, colComm;
+    MPI_Comm_split(comm, gridRow, gridCol, &rowComm);
+    MPI_Comm_split(comm, gridCol, gridRow, &colComm);
+
+    // Pad to a whole number of blocks, padding nodes being unreachable
+    int nodeCount = graph->nodeCount;
+    int blockCount = (nodeCount + blockSize - 1) / blockSize;
+    int localRows = local_block_count(gridRow, gridRows, blockCount);
+    int localCols = local_block_count(gridCol, gridCols, blockCount);
+    size_t tileArea = (size_t) blockSize * blockSize;
+
+    // Keep each tile contiguous so it stays cache-resident while being relaxed
+    PHASE_START(PHASE_MATRIX_INIT);
+    dist_t* tiles = alloc_aligned(localRows * localCols * tileArea);
+    for (int lbi = 0; lbi < localRows; lbi++) {
+        init_tile_row(&tiles[lbi * localCols * tileArea], lbi, gridRow,
+                gridCol, gridRows, gridCols, localCols, blockSize);
+    }
+    // Tiles are filled straight from the edges, so no rank ever holds the
+    // whole matrix. Later edges overwrite earlier ones, as in the full matrix
+    for (int e = 0; e < graph->edgeCount; e++) {
+        int from = graph->edgeFrom[e];
+        int to = graph->edgeTo[e];
+        if (from == to) continue;
+        long long offset = owned_tile_offset(from, to, gridRow, gridCol,
+                gridRows, gridCols, localCols, blockSize);
+        if (offset != -1) tiles[offset] = graph->edgeWeights[e];
+        if (graph->directed) continue;
+        offset = owned_tile_offset(to, from, gridRow, gridCol, gridRows,
+                gridCols, localCols, blockSize);
+        if (offset != -1) tiles[offset] = graph->edgeWeights[e];
+    }
+
+    dist_t* diag = alloc_aligned(tileArea);
+    dist_t* rowPanel = alloc_aligned(localCols * tileArea);
+    dist_t* colPanel = alloc_aligned(localRows * tileArea);
+    PHASE_STOP(PHASE_MATRIX_INIT);
+
+    double com = 0;
+    // Loop over each block of intermediate nodes
+    for (int kb = 0; kb < blockCount; kb++) {
+        int ownerRow = kb % gridRows;
+        int ownerCol = kb % gridCols;
+        int localK = kb / gridRows;
+        int localKCol = kb / gridCols;
+
+        // Close the diagonal tile on its own
+        PHASE_START(PHASE_COMPUTE);
+        if (gridRow == ownerRow && gridCol == ownerCol) {
+            dist_t* tile = &tiles[(localK * localCols + localKCol) * tileArea];
+            fw_tile(tile, tile, tile, blockSize);
+            // Any negative cycle shows up here once its highest node's block
+            // has been closed, since all of its nodes are then intermediates
+            for (int t = 0; t < blockSize; t++) {
+                if (tile[t * blockSize + t] < 0) mark_negative_cycle();
+            }
+            memcpy(diag, tile, tileArea * sizeof(dist_t));
+        }
+        PHASE_STOP(PHASE_COMPUTE);
+
+        PHASE_START(PHASE_EXCHANGE);
+        double _startTime = MPI_Wtime();
+        if (gridRow == ownerRow) {
+            MPI_Bcast(diag, tileArea, MPI_DIST, ownerCol, rowComm);
+        }
+        if (gridCol == ownerCol) {
+            MPI_Bcast(diag, tileArea, MPI_DIST, ownerRow, colComm);
+        }
+        com += MPI_Wtime() - _startTime;
+        PHASE_STOP(PHASE_EXCHANGE);
+
+        // Relax the row and column panels through the diagonal tile
+        PHASE_START(PHASE_COMPUTE);
+        // The owned row panel is already contiguous, so send it in place
+        dist_t* rowK = rowPanel;
+        if (gridRow == ownerRow) {
+            rowK = &tiles[localK * localCols * tileArea];
+            #pragma omp parallel for
+            for (int lbj = 0; lbj < localCols; lbj++) {
+                if (lbj * gridCols + gridCol == kb) continue;
+                dist_t* tile = &rowK[lbj * tileArea];
+                fw_tile(tile, diag, tile, blockSize);
+            }
+        }
+        if (gridCol == ownerCol) {
+            #pragma omp parallel for
+            for (int lbi = 0; lbi < localRows; lbi++) {
+                dist_t* tile = &tiles[(lbi * localCols + localKCol) * tileArea];
+                if (lbi * gridRows + gridRow != kb) {
+                    fw_tile(tile, tile, diag, blockSize);
+                }
+                memcpy(&colPanel[lbi * tileArea], tile,
+                        tileArea * sizeof(dist_t));
+            }
+        }
+
+        PHASE_STOP(PHASE_COMPUTE);
+
+        PHASE_START(PHASE_EXCHANGE);
+        _startTime = MPI_Wtime();
+        // Panels travel along the grid dimension that needs them: row panel
+        // tiles down each grid column, column panel tiles along each grid row
+        MPI_Bcast(rowK, localCols * tileArea, MPI_DIST, ownerRow, colComm);
+        MPI_Bcast(colPanel, localRows * tileArea, MPI_DIST, ownerCol, rowComm);
+        com += MPI_Wtime() - _startTime;
+        PHASE_STOP(PHASE_EXCHANGE);
+
+        // Relax every remaining tile through its row and column panel tiles
+        PHASE_START(PHASE_COMPUTE);
+        #pragma omp parallel for schedule(dynamic)
+        for (int t = 0; t < localRows * localCols; t++) {
+            int lbi = t / localCols;
+            int lbj = t % localCols;
+            if (lbi * gridRows + gridRow == kb
+                    || lbj * gridCols + gridCol == kb) {
+                continue;
+            }
+            fw_tile(&tiles[t * tileArea], &colPanel[lbi * tileArea],
+                    &rowK[lbj * tileArea], blockSize);
+        }
+        PHASE_STOP(PHASE_COMPUTE);
+    }
+
+    free(diag);
+    free(rowPanel);
+    free(colPanel);
+    MPI_Comm_free(&rowComm);
+    MPI_Comm_free(&colComm);
+    timings.com = com;
+
+    PHASE_START(PHASE_GATHER);
+    double startTime = MPI_Wtime();
+    if (sums != NULL) {
+        // Ranks only hold pieces of each row, so reduce the pieces locally
+        // then combine them across ranks
+        long long* partialSums = calloc(nodeCount, sizeof(long long));
+        long long* partialMaxes = calloc(nodeCount, sizeof(long long));
+        #pragma omp parallel for
+        for (int lbi = 0; lbi < localRows; lbi++) {
+            for (int lbj = 0; lbj < localCols; lbj++) {
+                dist_t* tile = &tiles[(lbi * localCols + lbj) * tileArea];
+                int rowOffset = (lbi * gridRows + gridRow) * blockSize;
+                int colOffset = (lbj * gridCols + gridCol) * blockSize;
+                for (int ti = 0; ti < blockSize && rowOffset + ti < nodeCount;
+                        ti++) {
+                    int i = rowOffset + ti;
+                    for (int tj = 0; tj < blockSize 
+                            && colOffset + tj < nodeCount; tj++) {
+                        dist_t value = tile[ti * blockSize + tj];
+                        if (value == DIST_INF) {
+                            partialMaxes[i] = LLONG_MAX;
+                            continue;
+                        }
+                        partialSums[i] += value;
+                        if (value > partialMaxes[i]) partialMaxes[i] = value;
+                    }
+                }
+            }
+        }
+        reduce_partial_summaries(partialSums, partialMaxes, sums, maxes,
+                nodeCount, comm);
+        timings.gather = MPI_Wtime() - startTime;
+        PHASE_STOP(PHASE_GATHER);
+        free(partialSums);
+        free(partialMaxes);
+        free(tiles);
+        return NULL;
+    }
+
+    // Collect on rank 0 only since we only need to process once.
+    dist_t** dist = NULL;
+    if (rank == 0) {
+        dist = alloc_matrix(nodeCount, nodeCount);
+        unpack_tiles(dist, tiles, gridRow, gridCol, gridRows, gridCols,
+                blockSize, nodeCount);
+        for (int other = 1; other < size; other++) {
+            int otherRow = other / gridCols;
+            int otherCol = other % gridCols;
+            int count = local_block_count(otherRow, gridRows, blockCount)
+                    * local_block_count(otherCol, gridCols, blockCount)
+                    * tileArea;
+            if (count == 0) continue;
+            dist_t* otherTiles = malloc(count * sizeof(dist_t));
+            MPI_Recv(otherTiles, count, MPI_DIST, other, 0, comm,
+                    MPI_STATUS_IGNORE);
+            unpack_tiles(dist, otherTiles, otherRow, otherCol, gridRows,
+                    gridCols, blockSize, nodeCount);
+            free(otherTiles);
+        }
+    } else if (localRows * localCols > 0) {
+        MPI_Send(tiles, localRows * localCols * tileArea, MPI_DIST, 0, 0,
+                comm);
+    }
+    timings.gather = MPI_Wtime() - startTime;
+    PHASE_STOP(PHASE_GATHER);
+
+    free(tiles);
+    return dist;
+}
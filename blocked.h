@@ -0,0 +1,95 @@
+/* =============================================================================
+ * blocked.h    Blocked (tiled) Floyd-Warshall over a 2D block-cyclic
+ *              distribution of the distance matrix
+ * =============================================================================
+ */
+
+/* Relax every path in tile a through the intermediate nodes of one block.
+ *  That is, a[i][j] = min(a[i][j], b[i][k] + c[k][j]) for each k in the block.
+ *  The tiles may alias, which gives the diagonal (a == b == c), row panel
+ *  (a == c) and column panel (a == b) updates of blocked Floyd-Warshall.
+ * Parameters:
+ *          a - the tile being updated
+ *          b - the tile holding paths into the intermediate block
+ *          c - the tile holding paths out of the intermediate block
+ *          blockSize - the width of each square tile
+ */
+void fw_tile(dist_t* a, dist_t* b, dist_t* c, int blockSize);
+
+/* Populate matrix of shortest paths between all pairs of nodes.
+ *  Use blocked Floyd-Warshall, with the matrix split into square tiles dealt
+ *  out block-cyclically over a 2D grid of ranks. Each block-step closes the
+ *  diagonal tile, then the row and column panels through it, then every
+ *  remaining tile, so communication happens once per block rather than once
+ *  per node.
+ * Parameters:
+ *          graph - the graph in question
+ *          blockSize - the width of each square tile
+ *          comm - the communicator the ranks share
+ *          sums - if not NULL, out parameter on rank 0 holding the total of
+ *                 each row, gathered in place of the matrix
+ *          maxes - if not NULL, out parameter on rank 0 holding the maximum
+ *                  of each row, gathered in place of the matrix
+ * Return:
+ *          On rank 0, a matrix containing the length of the shortest paths
+ *          between all nodes, or NULL if row summaries were gathered instead.
+ *          NULL on every other rank.
+ */
+dist_t** blocked_all_pair_shortest_path(Graph* graph, int blockSize,
+        MPI_Comm comm, long long* sums, long long* maxes);
+
+/* Find where a rank keeps an entry of the distance matrix among its tiles.
+ * Parameters:
+ *          i - the row of the entry
+ *          j - the column of the entry
+ *          gridRow - the rank's row in the process grid
+ *          gridCol - the rank's column in the process grid
+ *          gridRows - the number of rows in the process grid
+ *          gridCols - the number of columns in the process grid
+ *          localCols - the number of block columns the rank owns
+ *          blockSize - the width of each square tile
+ * Return:
+ *          The offset of the entry in the rank's tiles, stored row-major by
+ *          local block index, or -1 if another rank owns it.
+ */
+long long owned_tile_offset(int i, int j, int gridRow, int gridCol,
+        int gridRows, int gridCols, int localCols, int blockSize);
+
+/* Set one row of a rank's tiles to the distances before any relaxation.
+ *  That is 0 on the diagonal, padding included, and DIST_INF elsewhere.
+ * Parameters:
+ *          tiles - the tiles of the local block row
+ *          lbi - the local index of the block row
+ *          gridRow - the rank's row in the process grid
+ *          gridCol - the rank's column in the process grid
+ *          gridRows - the number of rows in the process grid
+ *          gridCols - the number of columns in the process grid
+ *          localCols - the number of block columns the rank owns
+ *          blockSize - the width of each square tile
+ */
+void init_tile_row(dist_t* tiles, int lbi, int gridRow, int gridCol,
+        int gridRows, int gridCols, int localCols, int blockSize);
+
+/* Copy the tiles owned by one rank into their place in the full matrix.
+ * Parameters:
+ *          dist - the full distance matrix
+ *          tiles - the rank's tiles, stored row-major by local block index
+ *          gridRow - the rank's row in the process grid
+ *          gridCol - the rank's column in the process grid
+ *          gridRows - the number of rows in the process grid
+ *          gridCols - the number of columns in the process grid
+ *          blockSize - the width of each square tile
+ *          nodeCount - the number of rows in the full matrix
+ */
+void unpack_tiles(dist_t** dist, dist_t* tiles, int gridRow, int gridCol,
+        int gridRows, int gridCols, int blockSize, int nodeCount);
+
+/* Get the number of blocks in one dimension owned by a grid row or column.
+ * Parameters:
+ *          gridIndex - the row or column of the process grid
+ *          gridSize - the number of rows or columns in the process grid
+ *          blockCount - the number of blocks in that dimension
+ * Return:
+ *          The number of blocks owned.
+ */
+int local_block_count(int gridIndex, int gridSize, int blockCount);
@@ -0,0 +1,239 @@
+/* =============================================================================
+ * checkpoint.c Checkpoint and restart of Floyd-Warshall progress, written in
+ *              the background so the k loop is only held up by a copy
+ * =============================================================================
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/stat.h>
+#include <mpi.h>
+#include "helper.h"
+#include "checkpoint.h"
+
+/* Set up checkpointing for this rank's partition.
+ * Parameters:
+ *          directory - the directory checkpoints are written to, created if
+ *                      it does not exist
+ *          every - checkpoint every this many iterations, 0 for no limit
+ *          seconds - checkpoint after this much wall time, 0 for no limit
+ *          resume - whether to resume from the latest checkpoint
+ *          nodeCount - the number of rows in the data
+ *          start - the first row owned by this rank, inclusive
+ *          end - the last row owned by this rank, inclusive
+ *          comm - the communicator the ranks share
+ * Return:
+ *          The checkpoint state.
+ */
+Checkpoint* checkpoint_init(char* directory, int every, double seconds,
+        int resume, int nodeCount, int start, int end, MPI_Comm comm) {
+    Checkpoint* checkpoint = malloc(sizeof(Checkpoint));
+    checkpoint->directory = directory;
+    checkpoint->resume = resume;
+    checkpoint->every = every;
+    checkpoint->seconds = seconds;
+    checkpoint->lastTime = MPI_Wtime();
+    MPI_Comm_rank(comm, &checkpoint->rank);
+    MPI_Comm_size(comm, &checkpoint->ranks);
+    checkpoint->nodeCount = nodeCount;
+    checkpoint->start = start;
+    checkpoint->end = end;
+    checkpoint->slot = 0;
+    checkpoint->nextK = 0;
+    checkpoint->snapshot = malloc(((size_t) (end - start + 1) * nodeCount + 1)
+            * sizeof(dist_t));
+    checkpoint->writing = 0;
+
+    if (checkpoint->rank == 0 && mkdir(directory, 0755) != 0
+            && errno != EEXIST) {
+        printf("Checkpoint directory %s could not be created.\n", directory);
+        exit(1);
+    }
+    MPI_Barrier(comm);
+    return checkpoint;
+}
+
+/* Get the path of one of a rank's checkpoint slots.
+ * Parameters:
+ *          checkpoint - the checkpoint state
+ *          slot - the slot, 0 or 1
+ *          path - out parameter holding the path
+ *          length - the space available in path
+ */
+void checkpoint_path(Checkpoint* checkpoint, int slot, char* path,
+        int length) {
+    snprintf(path, length, "%s/rank%i-slot%i.ckpt", checkpoint->directory,
+            checkpoint->rank, slot);
+}
+
+/* Decide whether to checkpoint before an iteration.
+ *  Every rank must call this for every k, since the wall time cadence is
+ *  agreed collectively.
+ * Parameters:
+ *          checkpoint - the checkpoint state
+ *          k - the iteration about to start
+ *          comm - the communicator the ranks share
+ * Return:
+ *          1 if every rank should checkpoint now, 0 otherwise.
+ */
+int checkpoint_due(Checkpoint* checkpoint, int k, MPI_Comm comm) {
+    if (k == checkpoint->nextK) return 0;
+    if (checkpoint->every > 0 && k - checkpoint->nextK >= checkpoint->every) {
+        return 1;
+    }
+    if (checkpoint->seconds > 0 && k % CHECKPOINT_POLL_INTERVAL == 0) {
+        // Clocks differ between ranks, so rank 0's decides for everyone
+        int due = MPI_Wtime() - checkpoint->lastTime >= checkpoint->seconds;
+        MPI_Bcast(&due, 1, MPI_INT, 0, comm);
+        return due;
+    }
+    return 0;
+}
+
+/* Snapshot this rank's rows and write them in the background.
+ *  Waits for any earlier write to finish first.
+ * Parameters:
+ *          checkpoint - the checkpoint state
+ *          dist - the distance matrix
+ *          nextK - the first iteration the rows have not been relaxed for
+ */
+void checkpoint_save(Checkpoint* checkpoint, dist_t** dist, int nextK) {
+    if (checkpoint->writing) {
+        pthread_join(checkpoint->writer, NULL);
+    }
+    for (int i = checkpoint->start; i <= checkpoint->end; i++) {
+        memcpy(&checkpoint->snapshot[(size_t) (i - checkpoint->start)
+                * checkpoint->nodeCount], dist[i],
+                checkpoint->nodeCount * sizeof(dist_t));
+    }
+    checkpoint->nextK = nextK;
+    checkpoint->lastTime = MPI_Wtime();
+    checkpoint->writing = pthread_create(&checkpoint->writer, NULL,
+            checkpoint_write, checkpoint) == 0;
+    if (!checkpoint->writing) {
+        // No thread to spare, so write it here instead
+        checkpoint_write(checkpoint);
+    }
+}
+
+/* Write a snapshot to its slot. Run on the writer thread.
+ * Parameters:
+ *          arg - the checkpoint state
+ * Return:
+ *          NULL
+ */
+void* checkpoint_write(void* arg) {
+    Checkpoint* checkpoint = arg;
+    char path[4096];
+    char tempPath[4096 + 8];
+    checkpoint_path(checkpoint, checkpoint->slot, path, sizeof(path));
+    snprintf(tempPath, sizeof(tempPath), "%s.tmp", path);
+
+    CheckpointHeader header = {CHECKPOINT_MAGIC, DIST_BITS,
+            checkpoint->nodeCount, checkpoint->ranks, checkpoint->start,
+            checkpoint->end, checkpoint->nextK};
+    size_t count = (size_t) (checkpoint->end - checkpoint->start + 1)
+            * checkpoint->nodeCount;
+    FILE* file = fopen(tempPath, "wb");
+    if (file == NULL || fwrite(&header, sizeof(header), 1, file) != 1
+            || fwrite(checkpoint->snapshot, sizeof(dist_t), count, file)
+            != count || fclose(file) != 0) {
+        // A failed checkpoint shouldn't end the run, the last one still holds
+        printf("Checkpoint %s could not be written.\n", tempPath);
+        return NULL;
+    }
+    // Only replace the slot once the new checkpoint is complete
+    rename(tempPath, path);
+    checkpoint->slot = 1 - checkpoint->slot;
+    return NULL;
+}
+
+/* Reload this rank's rows from the newest checkpoint every rank has.
+ * Parameters:
+ *          checkpoint - the checkpoint state
+ *          dist - the distance matrix to fill in
+ *          comm - the communicator the ranks share
+ * Return:
+ *          The iteration to continue from, 0 if there is no checkpoint.
+ */
+int checkpoint_load(Checkpoint* checkpoint, dist_t** dist, MPI_Comm comm) {
+    // Find the checkpoint in each slot that matches this partition
+    int slotK[2] = {-1, -1};
+    int otherBits = 0;
+    char path[4096];
+    for (int slot = 0; slot < 2; slot++) {
+        checkpoint_path(checkpoint, slot, path, sizeof(path));
+        FILE* file = fopen(path, "rb");
+        if (file == NULL) continue;
+        CheckpointHeader header;
+        int valid = fread(&header, sizeof(header), 1, file) == 1
+                && header.magic == CHECKPOINT_MAGIC;
+        if (valid && header.distBits != DIST_BITS) {
+            otherBits = header.distBits;
+        } else if (valid && header.nodeCount == checkpoint->nodeCount
+                && header.ranks == checkpoint->ranks
+                && header.start == checkpoint->start
+                && header.end == checkpoint->end) {
+            slotK[slot] = header.nextK;
+        }
+        fclose(file);
+    }
+
+    // Rows of another width cannot be read as this build's distances
+    MPI_Allreduce(MPI_IN_PLACE, &otherBits, 1, MPI_INT, MPI_MAX, comm);
+    if (otherBits != 0) {
+        if (checkpoint->rank == 0) {
+            printf("Checkpoint in %s has %i-bit distances, rebuild with make "
+                    "DIST_BITS=%i to resume.\n", checkpoint->directory,
+                    otherBits, otherBits);
+        }
+        exit(1);
+    }
+
+    // Ranks write in step, so the oldest newest checkpoint is on every rank
+    int newest = slotK[0] > slotK[1] ? slotK[0] : slotK[1];
+    int nextK;
+    MPI_Allreduce(&newest, &nextK, 1, MPI_INT, MPI_MIN, comm);
+    if (nextK <= 0) return 0;
+
+    int slot = slotK[0] == nextK ? 0 : 1;
+    int found = slotK[slot] == nextK;
+    if (found) {
+        checkpoint_path(checkpoint, slot, path, sizeof(path));
+        FILE* file = fopen(path, "rb");
+        fseek(file, sizeof(CheckpointHeader), SEEK_SET);
+        for (int i = checkpoint->start; i <= checkpoint->end && found; i++) {
+            found = fread(dist[i], sizeof(dist_t), checkpoint->nodeCount, file)
+                    == (size_t) checkpoint->nodeCount;
+        }
+        fclose(file);
+    }
+    int allFound;
+    MPI_Allreduce(&found, &allFound, 1, MPI_INT, MPI_LAND, comm);
+    if (!allFound) {
+        if (checkpoint->rank == 0) {
+            printf("Checkpoint in %s is incomplete, cannot resume.\n",
+                    checkpoint->directory);
+        }
+        exit(1);
+    }
+
+    // Keep the checkpoint being resumed from until a newer one is written
+    checkpoint->slot = 1 - slot;
+    checkpoint->nextK = nextK;
+    checkpoint->lastTime = MPI_Wtime();
+    return nextK;
+}
+
+/* Wait for any write in progress and free the checkpoint state.
+ * Parameters:
+ *          checkpoint - the checkpoint state
+ */
+void checkpoint_finish(Checkpoint* checkpoint) {
+    if (checkpoint->writing) {
+        pthread_join(checkpoint->writer, NULL);
+    }
+    free(checkpoint->snapshot);
+    free(checkpoint);
+}
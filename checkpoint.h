@@ -0,0 +1,121 @@
+/* =============================================================================
+ * checkpoint.h Checkpoint and restart of Floyd-Warshall progress, written in
+ *              the background so the k loop is only held up by a copy
+ * =============================================================================
+ */
+#include <pthread.h>
+
+// Identifies checkpoint files, and the layout they were written with
+#define CHECKPOINT_MAGIC 0x43504b32
+
+// Wall time cadence is agreed between ranks only every this many iterations
+#define CHECKPOINT_POLL_INTERVAL 32
+
+// Seconds between checkpoints when no cadence is given
+#define DEFAULT_CHECKPOINT_SECONDS 600
+
+/* The checkpoint state of one rank.
+ *  Each rank writes its own rows to one of two slots in turn, so a crash
+ *  part way through a write always leaves the previous checkpoint intact.
+ */
+typedef struct {
+    char* directory;
+    int resume;
+    int every;
+    double seconds;
+    double lastTime;
+    int rank;
+    int ranks;
+    int nodeCount;
+    int start;
+    int end;
+    int slot;
+    int nextK;
+    dist_t* snapshot;
+    pthread_t writer;
+    int writing;
+} Checkpoint;
+
+/* Header at the start of every checkpoint file, followed by the rows.
+ */
+typedef struct {
+    int magic;
+    int distBits;
+    int nodeCount;
+    int ranks;
+    int start;
+    int end;
+    int nextK;
+} CheckpointHeader;
+
+/* Set up checkpointing for this rank's partition.
+ * Parameters:
+ *          directory - the directory checkpoints are written to, created if
+ *                      it does not exist
+ *          every - checkpoint every this many iterations, 0 for no limit
+ *          seconds - checkpoint after this much wall time, 0 for no limit
+ *          resume - whether to resume from the latest checkpoint
+ *          nodeCount - the number of rows in the data
+ *          start - the first row owned by this rank, inclusive
+ *          end - the last row owned by this rank, inclusive
+ *          comm - the communicator the ranks share
+ * Return:
+ *          The checkpoint state.
+ */
+Checkpoint* checkpoint_init(char* directory, int every, double seconds,
+        int resume, int nodeCount, int start, int end, MPI_Comm comm);
+
+/* Get the path of one of a rank's checkpoint slots.
+ * Parameters:
+ *          checkpoint - the checkpoint state
+ *          slot - the slot, 0 or 1
+ *          path - out parameter holding the path
+ *          length - the space available in path
+ */
+void checkpoint_path(Checkpoint* checkpoint, int slot, char* path,
+        int length);
+
+/* Decide whether to checkpoint before an iteration.
+ *  Every rank must call this for every k, since the wall time cadence is
+ *  agreed collectively.
+ * Parameters:
+ *          checkpoint - the checkpoint state
+ *          k - the iteration about to start
+ *          comm - the communicator the ranks share
+ * Return:
+ *          1 if every rank should checkpoint now, 0 otherwise.
+ */
+int checkpoint_due(Checkpoint* checkpoint, int k, MPI_Comm comm);
+
+/* Snapshot this rank's rows and write them in the background.
+ *  Waits for any earlier write to finish first.
+ * Parameters:
+ *          checkpoint - the checkpoint state
+ *          dist - the distance matrix
+ *          nextK - the first iteration the rows have not been relaxed for
+ */
+void checkpoint_save(Checkpoint* checkpoint, dist_t** dist, int nextK);
+
+/* Write a snapshot to its slot. Run on the writer thread.
+ * Parameters:
+ *          arg - the checkpoint state
+ * Return:
+ *          NULL
+ */
+void* checkpoint_write(void* arg);
+
+/* Reload this rank's rows from the newest checkpoint every rank has.
+ * Parameters:
+ *          checkpoint - the checkpoint state
+ *          dist - the distance matrix to fill in
+ *          comm - the communicator the ranks share
+ * Return:
+ *          The iteration to continue from, 0 if there is no checkpoint.
+ */
+int checkpoint_load(Checkpoint* checkpoint, dist_t** dist, MPI_Comm comm);
+
+/* Wait for any write in progress and free the checkpoint state.
+ * Parameters:
+ *          checkpoint - the checkpoint state
+ */
+void checkpoint_finish(Checkpoint* checkpoint);
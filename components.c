@@ -0,0 +1,305 @@
+/* =============================================================================
+ * components.c Connected component decomposition, so each component can be
+ *              solved on its own before any shortest path work is wasted
+ * =============================================================================
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <limits.h>
+#include <omp.h>
+#include <mpi.h>
+#include "helper.h"
+#include "io.h"
+#include "kernel.h"
+#include "components.h"
+
+/* Find the root of a node's set, halving the path to it as it goes.
+ *  Safe to call while other threads are joining sets.
+ * Parameters:
+ *          parent - the parent of each node, roots being their own parent
+ *          node - the node in question
+ * Return:
+ *          The root of the node's set.
+ */
+int find_root(int* parent, int node) {
+    while (1) {
+        int up = __atomic_load_n(&parent[node], __ATOMIC_RELAXED);
+        if (up == node) return node;
+        int upper = __atomic_load_n(&parent[up], __ATOMIC_RELAXED);
+        // Skip a level if no other thread has moved it meanwhile
+        if (upper != up) {
+            __sync_bool_compare_and_swap(&parent[node], up, upper);
+        }
+        node = up;
+    }
+}
+
+/* Join the sets of two nodes.
+ *  The larger root is always linked under the smaller, so every set ends up
+ *  rooted at its smallest node whatever order threads join them in.
+ * Parameters:
+ *          parent - the parent of each node, roots being their own parent
+ *          a - a node in the first set
+ *          b - a node in the second set
+ */
+void union_nodes(int* parent, int a, int b) {
+    while (1) {
+        a = find_root(parent, a);
+        b = find_root(parent, b);
+        if (a == b) return;
+        if (a < b) {
+            int swap = a;
+            a = b;
+            b = swap;
+        }
+        // Fails if another thread linked a first, so look again
+        if (__sync_bool_compare_and_swap(&parent[a], a, b)) return;
+    }
+}
+
+/* Find the connected components of a graph.
+ *  Edges are joined in parallel with a lock-free union-find, then nodes and
+ *  edges are grouped by component.
+ * Parameters:
+ *          graph - the graph in question
+ * Return:
+ *          The components of the graph.
+ */
+Components* find_components(Graph* graph) {
+    int nodeCount = graph->nodeCount;
+    int* parent = malloc(nodeCount * sizeof(int));
+    #pragma omp parallel for
+    for (int i = 0; i < nodeCount; i++) {
+        parent[i] = i;
+    }
+    #pragma omp parallel for schedule(dynamic, 4096)
+    for (int e = 0; e < graph->edgeCount; e++) {
+        union_nodes(parent, graph->edgeFrom[e], graph->edgeTo[e]);
+    }
+
+    // Roots are the smallest node of each set, so numbering roots in order
+    // numbers components by their smallest node
+    Components* components = malloc(sizeof(Components));
+    components->labels = malloc(nodeCount * sizeof(int));
+    components->localIndex = malloc(nodeCount * sizeof(int));
+    int count = 0;
+    for (int i = 0; i < nodeCount; i++) {
+        int root = find_root(parent, i);
+        components->labels[i] = root == i ? count++ : components->labels[root];
+    }
+    components->count = count;
+    free(parent);
+
+    // Group nodes, then edges, by component with a counting sort
+    components->start = calloc(count + 1, sizeof(int));
+    components->nodes = malloc((nodeCount + 1) * sizeof(int));
+    for (int i = 0; i < nodeCount; i++) {
+        components->start[components->labels[i] + 1]++;
+    }
+    for (int c = 0; c < count; c++) {
+        components->start[c + 1] += components->start[c];
+    }
+    int* fill = malloc((count + 1) * sizeof(int));
+    for (int c = 0; c < count; c++) {
+        fill[c] = components->start[c];
+    }
+    for (int i = 0; i < nodeCount; i++) {
+        int c = components->labels[i];
+        components->localIndex[i] = fill[c] - components->start[c];
+        components->nodes[fill[c]++] = i;
+    }
+
+    components->edgeStart = calloc(count + 1, sizeof(int));
+    components->edges = malloc((graph->edgeCount + 1) * sizeof(int));
+    for (int e = 0; e < graph->edgeCount; e++) {
+        components->edgeStart[components->labels[graph->edgeFrom[e]] + 1]++;
+    }
+    for (int c = 0; c < count; c++) {
+        components->edgeStart[c + 1] += components->edgeStart[c];
+        fill[c] = components->edgeStart[c];
+    }
+    // Edges stay in input order within each component, so the last of a
+    // repeated edge still wins
+    for (int e = 0; e < graph->edgeCount; e++) {
+        components->edges[fill[components->labels[graph->edgeFrom[e]]]++] = e;
+    }
+    free(fill);
+    return components;
+}
+
+/* Free the components of a graph.
+ * Parameters:
+ *          components - the components to be freed
+ */
+void free_components(Components* components) {
+    free(components->labels);
+    free(components->start);
+    free(components->nodes);
+    free(components->localIndex);
+    free(components->edgeStart);
+    free(components->edges);
+    free(components);
+}
+
+/* Build the graph of a single component.
+ *  Nodes are renumbered from 0 in the order of components->nodes, and labels
+ *  are shared with the whole graph.
+ * Parameters:
+ *          graph - the whole graph
+ *          components - the components of the graph
+ *          component - the component in question
+ * Return:
+ *          The graph of the component, to be released with free_subgraph.
+ */
+Graph* component_subgraph(Graph* graph, Components* components,
+        int component) {
+    int* nodes = &components->nodes[components->start[component]];
+    int* edges = &components->edges[components->edgeStart[component]];
+    Graph* subgraph = malloc(sizeof(Graph));
+    subgraph->nodeCount = components->start[component + 1]
+            - components->start[component];
+    subgraph->edgeCount = components->edgeStart[component + 1]
+            - components->edgeStart[component];
+    subgraph->directed = graph->directed;
+    subgraph->storage = GRAPH_HEAP;
+    subgraph->connections = NULL;
+
+    subgraph->nodeLabels = malloc(subgraph->nodeCount * sizeof(char*));
+    for (int i = 0; i < subgraph->nodeCount; i++) {
+        subgraph->nodeLabels[i] = graph->nodeLabels[nodes[i]];
+    }
+    subgraph->edgeFrom = malloc((subgraph->edgeCount + 1) * sizeof(int));
+    subgraph->edgeTo = malloc((subgraph->edgeCount + 1) * sizeof(int));
+    subgraph->edgeWeights = malloc((subgraph->edgeCount + 1) * sizeof(int));
+    int* localIndex = components->localIndex;
+    for (int e = 0; e < subgraph->edgeCount; e++) {
+        subgraph->edgeFrom[e] = localIndex[graph->edgeFrom[edges[e]]];
+        subgraph->edgeTo[e] = localIndex[graph->edgeTo[edges[e]]];
+        subgraph->edgeWeights[e] = graph->edgeWeights[edges[e]];
+    }
+    return subgraph;
+}
+
+/* Free the graph of a single component.
+ * Parameters:
+ *          subgraph - the graph to be freed
+ */
+void free_subgraph(Graph* subgraph) {
+    if (subgraph->connections != NULL) free_matrix(subgraph->connections);
+    free(subgraph->nodeLabels);
+    free(subgraph->edgeFrom);
+    free(subgraph->edgeTo);
+    free(subgraph->edgeWeights);
+    free(subgraph);
+}
+
+/* Order component sizes from largest to smallest, then by component.
+ * Parameters:
+ *          a - the first component size
+ *          b - the second component size
+ * Return:
+ *          Negative, zero or positive as a sorts before, with or after b.
+ */
+int compare_component_sizes(const void* a, const void* b) {
+    const ComponentSize* sizeA = a;
+    const ComponentSize* sizeB = b;
+    if (sizeA->nodeCount != sizeB->nodeCount) {
+        return sizeA->nodeCount > sizeB->nodeCount ? -1 : 1;
+    }
+    return (sizeA->component > sizeB->component)
+            - (sizeA->component < sizeB->component);
+}
+
+/* Share the small components out between ranks.
+ *  Components are taken largest first and given to the rank with the least
+ *  cubic cost so far, which every rank works out the same way.
+ * Parameters:
+ *          components - the components of the graph
+ *          size - the total number of ranks
+ *          owners - out parameter holding the rank solving each small
+ *                   component, -1 for components solved across every rank
+ */
+void assign_components(Components* components, int size, int* owners) {
+    ComponentSize* sizes = malloc(components->count * sizeof(ComponentSize));
+    for (int c = 0; c < components->count; c++) {
+        sizes[c].nodeCount = components->start[c + 1] - components->start[c];
+        sizes[c].component = c;
+    }
+    qsort(sizes, components->count, sizeof(ComponentSize),
+            compare_component_sizes);
+
+    double* load = calloc(size, sizeof(double));
+    for (int s = 0; s < components->count; s++) {
+        int c = sizes[s].component;
+        double n = sizes[s].nodeCount;
+        if (n > SMALL_COMPONENT_NODES) {
+            owners[c] = -1;
+            continue;
+        }
+        int lightest = 0;
+        for (int r = 1; r < size; r++) {
+            if (load[r] < load[lightest]) lightest = r;
+        }
+        owners[c] = lightest;
+        load[lightest] += n * n * n;
+    }
+    free(load);
+    free(sizes);
+}
+
+/* Solve a small component on the calling thread.
+ *  Floyd-Warshall over its dense matrix, reducing each row to its total and
+ *  maximum.
+ * Parameters:
+ *          subgraph - the graph of the component
+ *          nodes - the node of the whole graph for each node of the component
+ *          sums - out parameter holding the total of each row, indexed by
+ *                 node of the whole graph
+ *          maxes - out parameter holding the maximum of each row, indexed by
+ *                  node of the whole graph
+ */
+void solve_component(Graph* subgraph, int* nodes, long long* sums,
+        long long* maxes) {
+    int nodeCount = subgraph->nodeCount;
+    build_connections(subgraph);
+    dist_t** dist = subgraph->connections;
+    for (int k = 0; k < nodeCount; k++) {
+        for (int i = 0; i < nodeCount; i++) {
+            if (dist[i][k] == DIST_INF || i == k) continue;
+            min_plus(dist[i], dist[k], dist[i][k], nodeCount);
+            if (dist[i][i] < 0) {
+                // The graph has no centres, so its rows are never used
+                mark_negative_cycle();
+                return;
+            }
+        }
+    }
+    for (int i = 0; i < nodeCount; i++) {
+        summarise_row(dist[i], nodeCount, &sums[nodes[i]], &maxes[nodes[i]]);
+    }
+}
+
+/* Write the centres of each component to a file.
+ *  Each component's block is its header line, "# component <index> <nodes>",
+ *  followed by its centres in the same form as write_file.
+ * Parameters:
+ *          filename - the file being written to
+ *          centres - the centres of each component, with nodes numbered as
+ *                    in the whole graph
+ *          components - the components of the graph
+ *          graph - the graph in question
+ */
+void write_component_file(char* filename, ListNode** centres,
+        Components* components, Graph* graph) {
+    FILE* file = fopen(filename, "w");
+    for (int c = 0; c < components->count; c++) {
+        fprintf(file, "# component %i %i\n", c,
+                components->start[c + 1] - components->start[c]);
+        fprintf(file, "%i\n", centres[c]->length);
+        for (ListNode* node = centres[c]; node != NULL; node = node->next) {
+            fprintf(file, "%i %s\n", node->value,
+                    graph->nodeLabels[node->value]);
+        }
+    }
+    fclose(file);
+}
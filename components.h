@@ -0,0 +1,132 @@
+/* =============================================================================
+ * components.h Connected component decomposition, so each component can be
+ *              solved on its own before any shortest path work is wasted
+ * =============================================================================
+ */
+
+// Components up to this many nodes are solved whole by a single thread,
+// larger ones by the distributed solvers across every rank
+#define SMALL_COMPONENT_NODES 512
+
+/* The connected components of a graph.
+ *  For directed graphs these are weakly connected components. Components are
+ *  numbered in order of their smallest node, and nodes within each are in
+ *  ascending order.
+ */
+typedef struct {
+    int count;
+    int* labels;
+    int* start;
+    int* nodes;
+    int* localIndex;
+    int* edgeStart;
+    int* edges;
+} Components;
+
+/* A component and its size, for ordering components by cost.
+ */
+typedef struct {
+    int nodeCount;
+    int component;
+} ComponentSize;
+
+/* Find the root of a node's set, halving the path to it as it goes.
+ *  Safe to call while other threads are joining sets.
+ * Parameters:
+ *          parent - the parent of each node, roots being their own parent
+ *          node - the node in question
+ * Return:
+ *          The root of the node's set.
+ */
+int find_root(int* parent, int node);
+
+/* Join the sets of two nodes.
+ *  The larger root is always linked under the smaller, so every set ends up
+ *  rooted at its smallest node whatever order threads join them in.
+ * Parameters:
+ *          parent - the parent of each node, roots being their own parent
+ *          a - a node in the first set
+ *          b - a node in the second set
+ */
+void union_nodes(int* parent, int a, int b);
+
+/* Find the connected components of a graph.
+ *  Edges are joined in parallel with a lock-free union-find, then nodes and
+ *  edges are grouped by component.
+ * Parameters:
+ *          graph - the graph in question
+ * Return:
+ *          The components of the graph.
+ */
+Components* find_components(Graph* graph);
+
+/* Free the components of a graph.
+ * Parameters:
+ *          components - the components to be freed
+ */
+void free_components(Components* components);
+
+/* Build the graph of a single component.
+ *  Nodes are renumbered from 0 in the order of components->nodes, and labels
+ *  are shared with the whole graph.
+ * Parameters:
+ *          graph - the whole graph
+ *          components - the components of the graph
+ *          component - the component in question
+ * Return:
+ *          The graph of the component, to be released with free_subgraph.
+ */
+Graph* component_subgraph(Graph* graph, Components* components, int component);
+
+/* Free the graph of a single component.
+ * Parameters:
+ *          subgraph - the graph to be freed
+ */
+void free_subgraph(Graph* subgraph);
+
+/* Order component sizes from largest to smallest, then by component.
+ * Parameters:
+ *          a - the first component size
+ *          b - the second component size
+ * Return:
+ *          Negative, zero or positive as a sorts before, with or after b.
+ */
+int compare_component_sizes(const void* a, const void* b);
+
+/* Share the small components out between ranks.
+ *  Components are taken largest first and given to the rank with the least
+ *  cubic cost so far, which every rank works out the same way.
+ * Parameters:
+ *          components - the components of the graph
+ *          size - the total number of ranks
+ *          owners - out parameter holding the rank solving each small
+ *                   component, -1 for components solved across every rank
+ */
+void assign_components(Components* components, int size, int* owners);
+
+/* Solve a small component on the calling thread.
+ *  Floyd-Warshall over its dense matrix, reducing each row to its total and
+ *  maximum.
+ * Parameters:
+ *          subgraph - the graph of the component
+ *          nodes - the node of the whole graph for each node of the component
+ *          sums - out parameter holding the total of each row, indexed by
+ *                 node of the whole graph
+ *          maxes - out parameter holding the maximum of each row, indexed by
+ *                  node of the whole graph
+ */
+void solve_component(Graph* subgraph, int* nodes, long long* sums,
+        long long* maxes);
+
+/* Write the centres of each component to a file.
+ *  Each component's block is its header line, "# component <index> <nodes>",
+ *  followed by its centres in the same form as write_file.
+ * Parameters:
+ *          filename - the file being written to
+ *          centres - the centres of each component, with nodes numbered as
+ *                    in the whole graph
+ *          components - the components of the graph
+ *          graph - the graph in question
+ */
+void write_component_file(char* filename, ListNode** centres,
+        Components* components, Graph* graph);
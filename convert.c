@@ -0,0 +1,22 @@
+/* =============================================================================
+ * convert.c    Converts a graph from the text input format to the binary graph
+ *              format, which the solver memory-maps instead of parsing
+ * =============================================================================
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <mpi.h>
+#include "helper.h"
+#include "io.h"
+
+int main(int argc, char** argv) {
+    if (argc != 3) {
+        printf("Usage: %s text-graph-file binary-graph-file\n", argv[0]);
+        return 1;
+    }
+
+    Graph* graph = read_file(argv[1]);
+    if (graph == NULL) return 1;
+    write_binary_file(argv[2], graph);
+    return 0;
+}
@@ -0,0 +1,222 @@
+/* =============================================================================
+ * eccentricity.c Exact minimum eccentricity centres from searches pruned by
+ *                eccentricity bounds, without solving every pair
+ * =============================================================================
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <limits.h>
+#include <omp.h>
+#include <mpi.h>
+#include "helper.h"
+#include "sparse.h"
+#include "instrument.h"
+#include "eccentricity.h"
+
+/* Choose the next node to search from.
+ *  Alternates, Takes-Kosters style, between the unsearched node that could
+ *  still be a centre with the smallest lower bound, whose search settles it,
+ *  and the unsearched node with the largest upper bound, whose large
+ *  eccentricity raises the lower bounds of nodes near it.
+ * Parameters:
+ *          lower - a lower bound on the eccentricity of each node
+ *          upper - an upper bound on the eccentricity of each node
+ *          searched - whether each node has been searched from
+ *          nodeCount - the number of nodes in the graph
+ *          threshold - the least upper bound, above which no node is a centre
+ *          periphery - 1 for the largest upper bound, 0 for the smallest lower
+ * Return:
+ *          The node, or -1 if there is none.
+ */
+int next_bound_search(long long* lower, long long* upper, char* searched,
+        int nodeCount, long long threshold, int periphery) {
+    int best = -1;
+    for (int v = 0; v < nodeCount; v++) {
+        if (searched[v]) continue;
+        if (periphery) {
+            if (best == -1 || upper[v] > upper[best]) best = v;
+        } else if (lower[v] <= threshold) {
+            // Of equal lower bounds, the smaller upper bound is likelier exact
+            if (best == -1 || lower[v] < lower[best]
+                    || (lower[v] == lower[best] && upper[v] < upper[best])) {
+                best = v;
+            }
+        }
+    }
+    return best;
+}
+
+/* Find the nodes with the least maximum distance to any other node.
+ *  Searches run in rounds, from a batch of nodes chosen by next_bound_search
+ *  split over ranks and threads, each search tightening every node's bounds
+ *  by ecc(w) - d(w, v) <= ecc(v) <= d(v, w) + ecc(w) and d(v, w) <= ecc(v).
+ *  Stops once every node that could still be a centre has been searched, so
+ *  the result is exact. Requires non-negative weights and a connected graph.
+ * Parameters:
+ *          graph - the graph in question
+ *          comm - the communicator the ranks share
+ *          centres - out parameter on rank 0 holding the centres in
+ *                    ascending order
+ * Return:
+ *          0 if the centres were found, 1 if the graph could not be solved.
+ */
+int bounded_min_max_centres(Graph* graph, MPI_Comm comm, ListNode** centres) {
+    int rank, size;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &size);
+    int nodeCount = graph->nodeCount;
+    if (has_negative_weights(graph)) {
+        if (rank == 0) {
+            printf("Bounded eccentricity needs non-negative edge weights.\n");
+        }
+        return 1;
+    }
+
+    PHASE_START(PHASE_MATRIX_INIT);
+    CSRGraph* csr = build_csr(graph);
+    // d(v, w) for every v is a search from w over the reversed graph, which
+    // for undirected graphs is the forward search again
+    CSRGraph* incoming = csr;
+    if (graph->directed) {
+        Graph reversed = *graph;
+        reversed.edgeFrom = graph->edgeTo;
+        reversed.edgeTo = graph->edgeFrom;
+        incoming = build_csr(&reversed);
+    }
+    long long* lower = calloc(nodeCount, sizeof(long long));
+    long long* upper = malloc(nodeCount * sizeof(long long));
+    char* searched = calloc(nodeCount, sizeof(char));
+    for (int v = 0; v < nodeCount; v++) {
+        upper[v] = LLONG_MAX;
+    }
+    // Enough searches per round to keep every thread of every rank busy
+    int batchSize = size * omp_get_max_threads();
+    int* batch = malloc(batchSize * sizeof(int));
+    long long* eccentricities = malloc(batchSize * sizeof(long long));
+    PHASE_STOP(PHASE_MATRIX_INIT);
+
+    double com = 0;
+    int failed = 0;
+    for (int round = 0; !failed; round++) {
+        long long threshold = LLONG_MAX;
+        for (int v = 0; v < nodeCount; v++) {
+            if (upper[v] < threshold) threshold = upper[v];
+        }
+        // Done once every node that could still be a centre is searched
+        if (next_bound_search(lower, upper, searched, nodeCount, threshold,
+                0) == -1) {
+            break;
+        }
+        // Every rank holds the same bounds, so chooses the same batch. Picks
+        // alternate across rounds as well as within them, so that rounds of
+        // a single search still take both in turn.
+        int count = 0;
+        for (int b = 0; b < batchSize; b++) {
+            int periphery = (round + b) % 2;
+            int v = next_bound_search(lower, upper, searched, nodeCount,
+                    threshold, periphery);
+            if (v == -1) {
+                if (!periphery) break;
+                continue;
+            }
+            searched[v] = 1;
+            batch[count++] = v;
+        }
+
+        int start, end;
+        set_partition(rank, size, count, &start, &end);
+        for (int b = 0; b < count; b++) {
+            eccentricities[b] = -1;
+        }
+        PHASE_START(PHASE_COMPUTE);
+        #pragma omp parallel
+        {
+            int* heap = malloc(nodeCount * sizeof(int));
+            int* heapPos = malloc(nodeCount * sizeof(int));
+            dist_t* from = malloc(nodeCount * sizeof(dist_t));
+            dist_t* to = graph->directed ? malloc(nodeCount * sizeof(dist_t))
+                    : from;
+            #pragma omp for schedule(dynamic, 1)
+            for (int b = start; b <= end; b++) {
+                dijkstra(csr, batch[b], from, heap, heapPos);
+                if (graph->directed) {
+                    dijkstra(incoming, batch[b], to, heap, heapPos);
+                }
+                long long eccentricity = 0;
+                for (int v = 0; v < nodeCount; v++) {
+                    if (from[v] > eccentricity) eccentricity = from[v];
+                    // Someone cannot reach w, so has no finite eccentricity
+                    if (to[v] == DIST_INF) eccentricity = LLONG_MAX;
+                }
+                eccentricities[b] = eccentricity;
+                if (eccentricity == LLONG_MAX) continue;
+                #pragma omp critical
+                {
+                    for (int v = 0; v < nodeCount; v++) {
+                        long long bound = eccentricity - from[v];
+                        if (to[v] > bound) bound = to[v];
+                        if (bound > lower[v]) lower[v] = bound;
+                        long long reach = to[v] + eccentricity;
+                        if (reach < upper[v]) upper[v] = reach;
+                    }
+                }
+            }
+            free(heap);
+            free(heapPos);
+            free(from);
+            if (graph->directed) free(to);
+        }
+        PHASE_STOP(PHASE_COMPUTE);
+
+        PHASE_START(PHASE_EXCHANGE);
+        double startTime = MPI_Wtime();
+        MPI_Allreduce(MPI_IN_PLACE, eccentricities, count, MPI_LONG_LONG,
+                MPI_MAX, comm);
+        MPI_Allreduce(MPI_IN_PLACE, lower, nodeCount, MPI_LONG_LONG, MPI_MAX,
+                comm);
+        MPI_Allreduce(MPI_IN_PLACE, upper, nodeCount, MPI_LONG_LONG, MPI_MIN,
+                comm);
+        com += MPI_Wtime() - startTime;
+        PHASE_STOP(PHASE_EXCHANGE);
+
+        for (int b = 0; b < count; b++) {
+            if (eccentricities[b] == LLONG_MAX) {
+                // Paths too long to hold also leave nodes unreached
+                MPI_Allreduce(MPI_IN_PLACE, &distanceOverflow, 1, MPI_INT,
+                        MPI_MAX, comm);
+                if (rank == 0 && distanceOverflow) {
+                    report_distance_overflow(graph);
+                } else if (rank == 0) {
+                    printf("Disconnected subgraph detected, solution "
+                            "undefined\n");
+                }
+                failed = 1;
+                break;
+            }
+            lower[batch[b]] = eccentricities[b];
+            upper[batch[b]] = eccentricities[b];
+        }
+    }
+    timings.com = com;
+    timings.gather = 0;
+
+    // Every node that could tie the least eccentricity has been searched,
+    // leaving its bounds equal
+    if (rank == 0 && !failed) {
+        long long* scores = malloc(nodeCount * sizeof(long long));
+        for (int v = 0; v < nodeCount; v++) {
+            scores[v] = searched[v] ? upper[v] : LLONG_MAX;
+        }
+        *centres = min_centres(scores, nodeCount);
+        free(scores);
+    }
+
+    free(lower);
+    free(upper);
+    free(searched);
+    free(batch);
+    free(eccentricities);
+    if (incoming != csr) free_csr(incoming);
+    free_csr(csr);
+    return failed;
+}
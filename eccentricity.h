@@ -0,0 +1,39 @@
+/* =============================================================================
+ * eccentricity.h Exact minimum eccentricity centres from searches pruned by
+ *                eccentricity bounds, without solving every pair
+ * =============================================================================
+ */
+
+/* Choose the next node to search from.
+ *  Alternates, Takes-Kosters style, between the unsearched node that could
+ *  still be a centre with the smallest lower bound, whose search settles it,
+ *  and the unsearched node with the largest upper bound, whose large
+ *  eccentricity raises the lower bounds of nodes near it.
+ * Parameters:
+ *          lower - a lower bound on the eccentricity of each node
+ *          upper - an upper bound on the eccentricity of each node
+ *          searched - whether each node has been searched from
+ *          nodeCount - the number of nodes in the graph
+ *          threshold - the least upper bound, above which no node is a centre
+ *          periphery - 1 for the largest upper bound, 0 for the smallest lower
+ * Return:
+ *          The node, or -1 if there is none.
+ */
+int next_bound_search(long long* lower, long long* upper, char* searched,
+        int nodeCount, long long threshold, int periphery);
+
+/* Find the nodes with the least maximum distance to any other node.
+ *  Searches run in rounds, from a batch of nodes chosen by next_bound_search
+ *  split over ranks and threads, each search tightening every node's bounds
+ *  by ecc(w) - d(w, v) <= ecc(v) <= d(v, w) + ecc(w) and d(v, w) <= ecc(v).
+ *  Stops once every node that could still be a centre has been searched, so
+ *  the result is exact. Requires non-negative weights and a connected graph.
+ * Parameters:
+ *          graph - the graph in question
+ *          comm - the communicator the ranks share
+ *          centres - out parameter on rank 0 holding the centres in
+ *                    ascending order
+ * Return:
+ *          0 if the centres were found, 1 if the graph could not be solved.
+ */
+int bounded_min_max_centres(Graph* graph, MPI_Comm comm, ListNode** centres);
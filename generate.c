@@ -0,0 +1,244 @@
+/* =============================================================================
+ * generate.c   Generates synthetic graphs in the text input format, for
+ *              benchmarking the solver on reproducible workloads
+ * =============================================================================
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+
+// Weights are drawn from 1 to this when no maximum is given
+#define DEFAULT_MAX_WEIGHT 100
+
+// Average connections per node for random, power-law and disconnected graphs
+#define DEFAULT_DEGREE 8
+
+/* Draw the next number from a xorshift generator.
+ *  Used instead of rand so a seed gives the same graph on every platform.
+ * Parameters:
+ *          state - the generator state, updated in place, never 0
+ * Return:
+ *          The next pseudo-random number.
+ */
+unsigned long long next_random(unsigned long long* state) {
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+    return *state;
+}
+
+/* Draw a number uniformly from 0 to bound - 1.
+ * Parameters:
+ *          state - the generator state
+ *          bound - one more than the largest number drawn
+ * Return:
+ *          The number drawn.
+ */
+int random_below(unsigned long long* state, int bound) {
+    return (int) (next_random(state) % bound);
+}
+
+/* Store the edges of a graph as they are generated.
+ */
+typedef struct {
+    int count;
+    int capacity;
+    int* from;
+    int* to;
+} EdgeList;
+
+/* Add an edge to a list, growing it as needed.
+ * Parameters:
+ *          edges - the list of edges
+ *          from - the index of one end of the edge
+ *          to - the index of the other end of the edge
+ */
+void add_edge(EdgeList* edges, int from, int to) {
+    if (edges->count == edges->capacity) {
+        edges->capacity = edges->capacity > 0 ? edges->capacity * 2 : 1024;
+        edges->from = realloc(edges->from, edges->capacity * sizeof(int));
+        edges->to = realloc(edges->to, edges->capacity * sizeof(int));
+    }
+    edges->from[edges->count] = from;
+    edges->to[edges->count] = to;
+    edges->count++;
+}
+
+/* Connect every pair of nodes.
+ * Parameters:
+ *          edges - the list the edges are added to
+ *          offset - the index of the first node
+ *          nodeCount - the number of nodes
+ */
+void generate_complete(EdgeList* edges, int offset, int nodeCount) {
+    for (int i = 0; i < nodeCount; i++) {
+        for (int j = i + 1; j < nodeCount; j++) {
+            add_edge(edges, offset + i, offset + j);
+        }
+    }
+}
+
+/* Connect random pairs of nodes, as an Erdos-Renyi G(n, m) graph.
+ *  Pairs may repeat, in which case the solver keeps the last weight.
+ * Parameters:
+ *          edges - the list the edges are added to
+ *          offset - the index of the first node
+ *          nodeCount - the number of nodes
+ *          degree - the average number of connections per node
+ *          state - the generator state
+ */
+void generate_random(EdgeList* edges, int offset, int nodeCount, int degree,
+        unsigned long long* state) {
+    if (nodeCount < 2) return;
+    long long edgeCount = (long long) nodeCount * degree / 2;
+    for (long long e = 0; e < edgeCount; e++) {
+        int from = random_below(state, nodeCount);
+        int to = random_below(state, nodeCount - 1);
+        // Skip over from so there are no self-loops
+        if (to >= from) to++;
+        add_edge(edges, offset + from, offset + to);
+    }
+}
+
+/* Connect nodes to their neighbours on a square grid, row by row.
+ *  The last row is partial when the node count is not a square.
+ * Parameters:
+ *          edges - the list the edges are added to
+ *          offset - the index of the first node
+ *          nodeCount - the number of nodes
+ */
+void generate_grid(EdgeList* edges, int offset, int nodeCount) {
+    int width = (int) ceil(sqrt((double) nodeCount));
+    for (int i = 0; i < nodeCount; i++) {
+        if ((i + 1) % width != 0 && i + 1 < nodeCount) {
+            add_edge(edges, offset + i, offset + i + 1);
+        }
+        if (i + width < nodeCount) {
+            add_edge(edges, offset + i, offset + i + width);
+        }
+    }
+}
+
+/* Grow a scale-free graph by preferential attachment (Barabasi-Albert).
+ *  Each new node connects to degree / 2 existing nodes, chosen in proportion
+ *  to their degree by picking a random end of a random existing edge.
+ * Parameters:
+ *          edges - the list the edges are added to
+ *          offset - the index of the first node
+ *          nodeCount - the number of nodes
+ *          degree - the average number of connections per node
+ *          state - the generator state
+ */
+void generate_powerlaw(EdgeList* edges, int offset, int nodeCount, int degree,
+        unsigned long long* state) {
+    int links = degree / 2 > 0 ? degree / 2 : 1;
+    int first = edges->count;
+    // Seed with a small complete graph so every node has a degree
+    int seedCount = links + 1 < nodeCount ? links + 1 : nodeCount;
+    generate_complete(edges, offset, seedCount);
+    for (int i = seedCount; i < nodeCount; i++) {
+        int existing = edges->count - first;
+        for (int l = 0; l < links; l++) {
+            int target;
+            if (existing == 0) {
+                target = offset + random_below(state, i);
+            } else {
+                int e = first + random_below(state, existing);
+                target = random_below(state, 2) ? edges->from[e] : edges->to[e];
+            }
+            add_edge(edges, offset + i, target);
+        }
+    }
+}
+
+/* Print command line usage.
+ * Parameters:
+ *          program - the name the generator was invoked with
+ */
+void print_usage(char* program) {
+    printf("Usage: %s [-d degree] [-w max-weight] [-s seed] "
+            "complete|random|grid|powerlaw|disconnected node-count "
+            "graph-file\n", program);
+    printf("  -d  average connections per node for random, powerlaw and "
+            "disconnected (default %i)\n", DEFAULT_DEGREE);
+    printf("  -w  largest edge weight, weights being drawn from 1 (default "
+            "%i)\n", DEFAULT_MAX_WEIGHT);
+    printf("  -s  random seed (default 1)\n");
+}
+
+int main(int argc, char** argv) {
+    int degree = DEFAULT_DEGREE;
+    int maxWeight = DEFAULT_MAX_WEIGHT;
+    unsigned long long seed = 1;
+    int opt;
+    while ((opt = getopt(argc, argv, "d:w:s:")) != -1) {
+        switch (opt) {
+            case 'd':
+                degree = atoi(optarg);
+                break;
+            case 'w':
+                maxWeight = atoi(optarg);
+                break;
+            case 's':
+                seed = strtoull(optarg, NULL, 10);
+                break;
+            default:
+                print_usage(argv[0]);
+                return 1;
+        }
+    }
+    if (argc - optind != 3 || degree < 1 || maxWeight < 1) {
+        print_usage(argv[0]);
+        return 1;
+    }
+    char* type = argv[optind];
+    int nodeCount = atoi(argv[optind + 1]);
+    char* filename = argv[optind + 2];
+    if (nodeCount < 1) {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    // Mix the seed so that small seeds still give well spread states
+    unsigned long long state = seed * 0x9E3779B97F4A7C15ULL + 1;
+    if (state == 0) state = 1;
+
+    EdgeList edges = {0, 0, NULL, NULL};
+    if (strcmp(type, "complete") == 0) {
+        generate_complete(&edges, 0, nodeCount);
+    } else if (strcmp(type, "random") == 0) {
+        generate_random(&edges, 0, nodeCount, degree, &state);
+    } else if (strcmp(type, "grid") == 0) {
+        generate_grid(&edges, 0, nodeCount);
+    } else if (strcmp(type, "powerlaw") == 0) {
+        generate_powerlaw(&edges, 0, nodeCount, degree, &state);
+    } else if (strcmp(type, "disconnected") == 0) {
+        // Two random components with nothing between them
+        int half = nodeCount / 2;
+        generate_random(&edges, 0, half, degree, &state);
+        generate_random(&edges, half, nodeCount - half, degree, &state);
+    } else {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    FILE* file = fopen(filename, "w");
+    if (file == NULL) {
+        printf("File %s could not be written.\n", filename);
+        exit(1);
+    }
+    fprintf(file, "%i\n%i\n", nodeCount, edges.count);
+    for (int i = 0; i < nodeCount; i++) {
+        fprintf(file, "Node%i\n", i);
+    }
+    for (int e = 0; e < edges.count; e++) {
+        fprintf(file, "%i %i %i\n", edges.from[e], edges.to[e],
+                1 + random_below(&state, maxWeight));
+    }
+    fclose(file);
+    free(edges.from);
+    free(edges.to);
+    return 0;
+}
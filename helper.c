@@ -6,8 +6,14 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <limits.h>
+#include <mpi.h>
 #include "helper.h"
 
+Timings timings;
+int checkedDistances = 0;
+int distanceOverflow = 0;
+int negativeCycle = 0;
+
 /* Print node labels for a graph.
  * Parameters: 
  *          graph - the graph in question
@@ -27,8 +33,9 @@ void print_graph(Graph* graph) {
     for (int i = 0; i < graph->nodeCount; i++) {
         for (int j = 0; j < graph->nodeCount; j++) {
             if (graph->connections[i][j] != 0) {
-                printf("%s <---> %s weight %i\n", graph->nodeLabels[i], 
-                        graph->nodeLabels[j], graph->connections[i][j]);
+                printf("%s <---> %s weight %lli\n", graph->nodeLabels[i], 
+                        graph->nodeLabels[j],
+                        (long long) graph->connections[i][j]);
             }
         } 
     }
@@ -44,9 +51,10 @@ void print_graph_DOT(Graph* graph) {
         printf("\t%s\n", graph->nodeLabels[i]);
         for (int j = 0; j < graph->nodeCount; j++) {
             if (graph->connections[i][j] != 0 
-                    && graph->connections[i][j] != INT_MAX) {
-                printf("\t\"%s\" -> \"%s\" [label=%i]\n", graph->nodeLabels[i],
-                        graph->nodeLabels[j], graph->connections[i][j]);
+                    && graph->connections[i][j] != DIST_INF) {
+                printf("\t\"%s\" -> \"%s\" [label=%lli]\n",
+                        graph->nodeLabels[i], graph->nodeLabels[j],
+                        (long long) graph->connections[i][j]);
             }
         }
     }
@@ -60,10 +68,10 @@ void print_graph_DOT(Graph* graph) {
  *          rows - the number of rows
  *          cols - the number of columns
  */
-void print_matrix(int** matrix, int rows, int cols) {
+void print_matrix(dist_t** matrix, int rows, int cols) {
     for (int i = 0; i < rows; i++) {
         for (int j = 0; j < cols; j++) {
-            printf("%i\t", matrix[i][j]);
+            printf("%lli\t", (long long) matrix[i][j]);
         }
         printf("\n");
     }
@@ -105,14 +113,180 @@ void free_list(ListNode* head) {
  * Return:
  *          The largest value.
  */
-int max_val(int* arr, int size) {
-    int champ = 0;
+dist_t max_val(dist_t* arr, int size) {
+    dist_t champ = 0;
     for (int i = 0; i < size; i++) {
         if (arr[i] > champ) champ = arr[i];
     }
     return champ;
 }
 
+/* Allocate an array aligned to MATRIX_ALIGNMENT bytes.
+ * Parameters:
+ *          count - the number of distances in the array
+ * Return:
+ *          The array, to be released with free.
+ */
+dist_t* alloc_aligned(size_t count) {
+    void* data;
+    if (posix_memalign(&data, MATRIX_ALIGNMENT, 
+            (count > 0 ? count : 1) * sizeof(dist_t)) != 0) {
+        printf("Could not allocate %zu distances\n", count);
+        exit(1);
+    }
+    return data;
+}
+
+/* Get the padded length of each row in a contiguous matrix.
+ * Parameters:
+ *          cols - the number of columns in the matrix
+ * Return:
+ *          The number of distances between the starts of consecutive rows.
+ */
+int matrix_stride(int cols) {
+    int perLine = MATRIX_ALIGNMENT / sizeof(dist_t);
+    return (cols + perLine - 1) / perLine * perLine;
+}
+
+/* Allocate a matrix as one contiguous, aligned buffer.
+ *  Rows are padded so that each one starts on a MATRIX_ALIGNMENT boundary, and
+ *  are reached through the returned row pointers as with any dist_t** matrix.
+ * Parameters:
+ *          rows - the number of rows
+ *          cols - the number of columns
+ * Return:
+ *          The row pointers of the matrix, to be released with free_matrix.
+ */
+dist_t** alloc_matrix(int rows, int cols) {
+    size_t stride = matrix_stride(cols);
+    // Always keep one row pointer so free_matrix can find the buffer
+    dist_t** matrix = malloc((rows > 0 ? rows : 1) * sizeof(dist_t*));
+    dist_t* data = alloc_aligned(rows * stride);
+    matrix[0] = data;
+    for (int i = 1; i < rows; i++) {
+        matrix[i] = &data[i * stride];
+    }
+    return matrix;
+}
+
+/* Free a matrix allocated with alloc_matrix.
+ * Parameters:
+ *          matrix - the matrix to be freed
+ */
+void free_matrix(dist_t** matrix) {
+    free(matrix[0]);
+    free(matrix);
+}
+
+/* Check whether a graph has any negative edge weights.
+ * Parameters:
+ *          graph - the graph in question
+ * Return:
+ *          1 if any edge weight is negative, 0 otherwise.
+ */
+int has_negative_weights(Graph* graph) {
+    for (int e = 0; e < graph->edgeCount; e++) {
+        if (graph->edgeWeights[e] < 0) return 1;
+    }
+    return 0;
+}
+
+/* Check whether an edge weight is itself a distance of this build.
+ *  16-bit distances are unsigned, so hold no negative weight, and no width
+ *  holds DIST_INF, which marks a missing edge.
+ * Parameters:
+ *          weight - the edge weight
+ * Return:
+ *          1 if the weight fits, 0 otherwise.
+ */
+int weight_fits_distance(int weight) {
+    if (DIST_BITS == 16 && weight < 0) return 0;
+    return (long long) weight < (long long) DIST_INF;
+}
+
+/* Check whether every edge weight of a graph is a distance of this build.
+ *  Sums of distances can be checked as they are found, but a weight that
+ *  does not fit is wrong before any sum is taken.
+ * Parameters:
+ *          graph - the graph in question
+ * Return:
+ *          1 if every weight fits, 0 otherwise.
+ */
+int weights_fit_distances(Graph* graph) {
+    for (int e = 0; e < graph->edgeCount; e++) {
+        if (!weight_fits_distance(graph->edgeWeights[e])) return 0;
+    }
+    return 1;
+}
+
+/* Find the narrowest distance width that holds every shortest path.
+ *  A shortest path has at most |V| - 1 edges, so is bounded by the largest
+ *  weight times that, and relaxing adds two paths, so a width must hold
+ *  twice the bound. Totals of |V| paths must also fit in 64 bits.
+ * Parameters:
+ *          graph - the graph in question
+ * Return:
+ *          16, 32 or 64, or 0 if no width is safe.
+ */
+int distance_bits_needed(Graph* graph) {
+    double heaviest = 0;
+    for (int e = 0; e < graph->edgeCount; e++) {
+        double weight = graph->edgeWeights[e];
+        if (weight < 0) weight = -weight;
+        if (weight > heaviest) heaviest = weight;
+    }
+    double longest = heaviest * (graph->nodeCount > 1 
+            ? graph->nodeCount - 1 : 1);
+    if (longest * graph->nodeCount >= (double) LLONG_MAX) return 0;
+    if (!has_negative_weights(graph) && 2 * longest < USHRT_MAX) return 16;
+    if (2 * longest < INT_MAX) return 32;
+    if (2 * longest < (double) LLONG_MAX) return 64;
+    return 0;
+}
+
+/* Add two distances, checking that the sum is a distance.
+ * Parameters:
+ *          a - the first distance, not DIST_INF
+ *          b - the second distance, not DIST_INF
+ *          sum - out parameter holding the sum
+ * Return:
+ *          0 if the sum fits below DIST_INF, 1 otherwise.
+ */
+int add_distances(dist_t a, dist_t b, dist_t* sum) {
+    return __builtin_add_overflow(a, b, sum) || *sum == DIST_INF;
+}
+
+/* Record that a shortest path is too long for dist_t, from any thread.
+ */
+void mark_distance_overflow() {
+    #pragma omp atomic write
+    distanceOverflow = 1;
+}
+
+/* Print that shortest paths are too long for this build's distances.
+ *  Names the width distance_bits_needed finds safe, or 64 bits if it finds
+ *  none wider than this build's.
+ * Parameters:
+ *          graph - the graph in question
+ */
+void report_distance_overflow(Graph* graph) {
+    int bitsNeeded = distance_bits_needed(graph);
+    if (bitsNeeded <= DIST_BITS) bitsNeeded = 64;
+    if (DIST_BITS < 64) {
+        printf("Path lengths overflow %i-bit distances, rebuild with "
+                "make DIST_BITS=%i.\n", DIST_BITS, bitsNeeded);
+    } else {
+        printf("Path lengths overflow 64-bit distances.\n");
+    }
+}
+
+/* Record that a negative cycle has been found, from any thread.
+ */
+void mark_negative_cycle() {
+    #pragma omp atomic write
+    negativeCycle = 1;
+}
+
 /* Partition the data for a given rank.
  * Balances remainders so that the largest partitions are only one element 
  * larger than the smallest.
@@ -156,3 +330,269 @@ int get_partition(int i, int size, int dataSize) {
     }
 }
 
+
+/* Reduce a row of distances to its total and its maximum.
+ *  Both are 64-bit, so totals of narrow distances cannot overflow.
+ * Parameters:
+ *          row - the row of distances
+ *          size - the length of the row
+ *          sum - out parameter holding the total, LLONG_MAX if any distance is
+ *                DIST_INF
+ *          max - out parameter holding the largest distance, LLONG_MAX if any
+ *                distance is DIST_INF
+ */
+void summarise_row(dist_t* row, int size, long long* sum, long long* max) {
+    long long total = 0;
+    long long champ = 0;
+    for (int j = 0; j < size; j++) {
+        if (row[j] == DIST_INF) {
+            *sum = LLONG_MAX;
+            *max = LLONG_MAX;
+            return;
+        }
+        // Only 64-bit distances can add up past a long long
+        if (__builtin_add_overflow(total, (long long) row[j], &total)) {
+            mark_distance_overflow();
+        }
+        if (row[j] > champ) champ = row[j];
+    }
+    *sum = total;
+    *max = champ;
+}
+
+/* Gather per-row totals and maxima from every rank's partition onto rank 0.
+ *  Partitions are as given by set_partition.
+ * Parameters:
+ *          localSums - the totals of this rank's rows
+ *          localMaxes - the maxima of this rank's rows
+ *          sums - out parameter on rank 0 holding the totals of all rows
+ *          maxes - out parameter on rank 0 holding the maxima of all rows
+ *          dataSize - the number of rows in the data
+ *          comm - the communicator the ranks share
+ */
+void gather_row_summaries(long long* localSums, long long* localMaxes,
+        long long* sums, long long* maxes, int dataSize, MPI_Comm comm) {
+    int size;
+    MPI_Comm_size(comm, &size);
+
+    int* bounds = malloc((size + 1) * sizeof(int));
+    for (int i = 0; i < size; i++) {
+        int end;
+        set_partition(i, size, dataSize, &bounds[i], &end);
+    }
+    bounds[size] = dataSize;
+    gather_bounded_summaries(localSums, localMaxes, sums, maxes, bounds, comm);
+    free(bounds);
+}
+
+/* Gather per-row totals and maxima from every rank's rows onto rank 0.
+ *  Each rank holds a contiguous range of rows given by bounds.
+ * Parameters:
+ *          localSums - the totals of this rank's rows
+ *          localMaxes - the maxima of this rank's rows
+ *          sums - out parameter on rank 0 holding the totals of all rows
+ *          maxes - out parameter on rank 0 holding the maxima of all rows
+ *          bounds - the bounds of each rank's rows, rank r owning rows
+ *                   bounds[r] to bounds[r+1] - 1
+ *          comm - the communicator the ranks share
+ */
+void gather_bounded_summaries(long long* localSums, long long* localMaxes,
+        long long* sums, long long* maxes, int* bounds, MPI_Comm comm) {
+    int rank, size;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &size);
+
+    int* counts = malloc(size * sizeof(int));
+    for (int i = 0; i < size; i++) {
+        counts[i] = bounds[i + 1] - bounds[i];
+    }
+    MPI_Gatherv(localSums, counts[rank], MPI_LONG_LONG, sums, counts, bounds,
+            MPI_LONG_LONG, 0, comm);
+    MPI_Gatherv(localMaxes, counts[rank], MPI_LONG_LONG, maxes, counts,
+            bounds, MPI_LONG_LONG, 0, comm);
+    free(counts);
+}
+
+/* Combine partial per-row totals and maxima from every rank onto rank 0.
+ *  For when each rank only holds pieces of rows. A partial maximum of
+ *  LLONG_MAX marks a row with an unreachable node, whose total is then
+ *  LLONG_MAX.
+ * Parameters:
+ *          partialSums - this rank's contribution to the total of each row
+ *          partialMaxes - this rank's contribution to the maximum of each row
+ *          sums - out parameter on rank 0 holding the totals of all rows
+ *          maxes - out parameter on rank 0 holding the maxima of all rows
+ *          dataSize - the number of rows in the data
+ *          comm - the communicator the ranks share
+ */
+void reduce_partial_summaries(long long* partialSums,
+        long long* partialMaxes, long long* sums, long long* maxes,
+        int dataSize, MPI_Comm comm) {
+    int rank;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Reduce(partialSums, sums, dataSize, MPI_LONG_LONG, MPI_SUM, 0, comm);
+    MPI_Reduce(partialMaxes, maxes, dataSize, MPI_LONG_LONG, MPI_MAX, 0, comm);
+    if (rank == 0) {
+        // An unreachable node leaves no finite total
+        for (int i = 0; i < dataSize; i++) {
+            if (maxes[i] == LLONG_MAX) sums[i] = LLONG_MAX;
+        }
+    }
+}
+
+/* Partition the rows of an upper triangle between ranks.
+ *  Row i of the triangle holds dataSize - i entries, so rows are split to 
+ *  balance entries rather than rows.
+ * Parameters:
+ *          size - the total number of ranks
+ *          dataSize - the number of rows in the data
+ *          bounds - out parameter of size + 1 entries, rank r owning rows
+ *                   bounds[r] to bounds[r+1] - 1
+ */
+void set_triangle_bounds(int size, int dataSize, int* bounds) {
+    double total = (double) dataSize * (dataSize + 1) / 2;
+    int row = 0;
+    double filled = 0;
+    bounds[0] = 0;
+    for (int r = 1; r < size; r++) {
+        // Take whole rows until this rank's share of entries is reached
+        double target = total * r / size;
+        while (row < dataSize && filled + (dataSize - row) / 2.0 < target) {
+            filled += dataSize - row;
+            row++;
+        }
+        bounds[r] = row;
+    }
+    bounds[size] = dataSize;
+}
+
+/* Find the ids with the minimum score, in ascending order.
+ * Parameters:
+ *          scores - the score of each id
+ *          size - the number of ids
+ * Return:
+ *          The head of a list of the ids sharing the minimum score.
+ */
+ListNode* min_centres(long long* scores, int size) {
+    long long champ = LLONG_MAX;
+    #pragma omp parallel for reduction(min:champ)
+    for (int i = 0; i < size; i++) {
+        if (scores[i] < champ) champ = scores[i];
+    }
+    // Iterate backwards so that list is in appearance order, allocating
+    // only for the ties themselves
+    ListNode* centres = NULL;
+    int length = 0;
+    for (int i = size - 1; i >= 0; i--) {
+        if (scores[i] != champ) continue;
+        ListNode* next = malloc(sizeof(ListNode));
+        next->value = i;
+        next->next = centres;
+        next->length = ++length;
+        centres = next;
+    }
+    return centres;
+}
+
+/* Whether one id ranks before another, by lower score then lower id.
+ * Parameters:
+ *          scores - the score of each id
+ *          a - the first id
+ *          b - the second id
+ * Return:
+ *          1 if a ranks before b, 0 otherwise.
+ */
+int ranks_before(long long* scores, int a, int b) {
+    return scores[a] < scores[b] || (scores[a] == scores[b] && a < b);
+}
+
+/* Restore a heap of ids, whose root ranks last, below one of its entries.
+ * Parameters:
+ *          heap - the ids in the heap
+ *          count - the number of ids in the heap
+ *          i - the entry that may rank before one of its children
+ *          scores - the score of each id
+ */
+void sift_down_ranked(int* heap, int count, int i, long long* scores) {
+    while (1) {
+        int last = i;
+        int left = 2 * i + 1;
+        int right = left + 1;
+        if (left < count && ranks_before(scores, heap[last], heap[left])) {
+            last = left;
+        }
+        if (right < count && ranks_before(scores, heap[last], heap[right])) {
+            last = right;
+        }
+        if (last == i) return;
+        int swap = heap[i];
+        heap[i] = heap[last];
+        heap[last] = swap;
+        i = last;
+    }
+}
+
+/* Offer an id to a heap holding the best ids seen so far.
+ *  Once full, the id replaces the root, which ranks last, if it ranks before
+ *  it.
+ * Parameters:
+ *          heap - the ids in the heap, room for k
+ *          count - the number of ids in the heap, updated as it grows
+ *          k - the most ids the heap holds, at least 1
+ *          id - the id being offered
+ *          scores - the score of each id
+ */
+void push_ranked(int* heap, int* count, int k, int id, long long* scores) {
+    if (*count < k) {
+        int i = (*count)++;
+        heap[i] = id;
+        while (i > 0 && ranks_before(scores, heap[(i - 1) / 2], heap[i])) {
+            int swap = heap[i];
+            heap[i] = heap[(i - 1) / 2];
+            heap[(i - 1) / 2] = swap;
+            i = (i - 1) / 2;
+        }
+    } else if (ranks_before(scores, id, heap[0])) {
+        heap[0] = id;
+        sift_down_ranked(heap, k, 0, scores);
+    }
+}
+
+/* Find the ids with the k lowest scores, ties going to the lower id.
+ *  Each thread keeps a heap of the best ids of its share, and the heaps are
+ *  merged, so only O(k) ids per thread are ever compared against each other.
+ * Parameters:
+ *          scores - the score of each id
+ *          size - the number of ids
+ *          k - the number of ids wanted
+ *          top - out parameter of k entries holding the ids, best first
+ * Return:
+ *          The number of ids found, the lesser of k and size.
+ */
+int top_ids(long long* scores, int size, int k, int* top) {
+    if (k > size) k = size;
+    if (k <= 0) return 0;
+    int count = 0;
+    #pragma omp parallel
+    {
+        int* local = malloc(k * sizeof(int));
+        int localCount = 0;
+        #pragma omp for nowait
+        for (int i = 0; i < size; i++) {
+            push_ranked(local, &localCount, k, i, scores);
+        }
+        #pragma omp critical
+        for (int i = 0; i < localCount; i++) {
+            push_ranked(top, &count, k, local[i], scores);
+        }
+        free(local);
+    }
+    // Move the last of the heap to the end until it is in order
+    for (int end = count - 1; end > 0; end--) {
+        int swap = top[0];
+        top[0] = top[end];
+        top[end] = swap;
+        sift_down_ranked(top, end, 0, scores);
+    }
+    return count;
+}
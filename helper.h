@@ -4,15 +4,63 @@
  * =============================================================================
  */
 
+// Rows of contiguous matrices start on cache line boundaries
+#define MATRIX_ALIGNMENT 64
+
+// Width of a shortest path length, chosen at build time with make DIST_BITS.
+// 16-bit distances are unsigned, so only for non-negative weights, and halve
+// the matrices; 64-bit distances hold paths too long for 32 bits
+#ifndef DIST_BITS
+#define DIST_BITS 32
+#endif
+#if DIST_BITS == 16
+typedef unsigned short dist_t;
+#define DIST_INF USHRT_MAX
+#define MPI_DIST MPI_UNSIGNED_SHORT
+#elif DIST_BITS == 64
+typedef long long dist_t;
+#define DIST_INF LLONG_MAX
+#define MPI_DIST MPI_LONG_LONG
+#else
+typedef int dist_t;
+#define DIST_INF INT_MAX
+#define MPI_DIST MPI_INT
+#endif
+
+// How a graph's edges and labels are held: allocated, with the labels in one
+// buffer, memory-mapped from a binary file, or in a host's shared memory
+#define GRAPH_HEAP 0
+#define GRAPH_MAPPED 1
+#define GRAPH_SHARED 2
+
 /* Store a graph with weighted edges and labelled nodes.
+ *  Edges are kept as read, and only expanded into the dense connections matrix
+ *  for the algorithms that need it. Edges are two-way unless the graph is
+ *  directed, in which case each runs from edgeFrom to edgeTo only.
 */
 typedef struct {
     int nodeCount;
     int edgeCount;
+    int directed;
+    int storage;
     char** nodeLabels;
-    int** connections;
+    dist_t** connections;
+    int* edgeFrom;
+    int* edgeTo;
+    int* edgeWeights;
 } Graph;
 
+/* Store a graph's adjacency in compressed sparse row form.
+ *  The neighbours of node i are neighbours[rowStart[i]] to 
+ *  neighbours[rowStart[i+1] - 1], with matching weights.
+ */
+typedef struct {
+    int nodeCount;
+    int* rowStart;
+    int* neighbours;
+    dist_t* weights;
+} CSRGraph;
+
 /* A linked-list node.
  */
 typedef struct listNode {
@@ -21,6 +69,28 @@ typedef struct listNode {
     int length;
 } ListNode;
 
+/* Wall time spent in each phase of a solve on this rank, in seconds.
+ *  Solvers fill in com and gather, and the rest is timed by the caller.
+ */
+typedef struct {
+    double load;
+    double compute;
+    double com;
+    double gather;
+} Timings;
+
+// Phase times of the most recent solve
+extern Timings timings;
+
+// Whether paths could be too long for dist_t, so that sums of distances are
+// checked, and whether any path has been found to be
+extern int checkedDistances;
+extern int distanceOverflow;
+
+// Whether any path has been found to loop through a negative cycle, leaving
+// shortest paths undefined
+extern int negativeCycle;
+
 /* Print node labels for a graph.
  * Parameters: 
  *          graph - the graph in question
@@ -46,7 +116,7 @@ void print_graph_DOT(Graph* graph);
  *          rows - the number of rows
  *          cols - the number of columns
  */
-void print_matrix(int** matrix, int rows, int cols);
+void print_matrix(dist_t** matrix, int rows, int cols);
 
 /* Print a list of centres.
  * Parameters:
@@ -68,7 +138,105 @@ void free_list(ListNode* head);
  * Return:
  *          The largest value.
  */
-int max_val(int* arr, int size);
+dist_t max_val(dist_t* arr, int size);
+
+/* Allocate an array aligned to MATRIX_ALIGNMENT bytes.
+ * Parameters:
+ *          count - the number of distances in the array
+ * Return:
+ *          The array, to be released with free.
+ */
+dist_t* alloc_aligned(size_t count);
+
+/* Get the padded length of each row in a contiguous matrix.
+ * Parameters:
+ *          cols - the number of columns in the matrix
+ * Return:
+ *          The number of distances between the starts of consecutive rows.
+ */
+int matrix_stride(int cols);
+
+/* Allocate a matrix as one contiguous, aligned buffer.
+ *  Rows are padded so that each one starts on a MATRIX_ALIGNMENT boundary, and
+ *  are reached through the returned row pointers as with any dist_t** matrix.
+ * Parameters:
+ *          rows - the number of rows
+ *          cols - the number of columns
+ * Return:
+ *          The row pointers of the matrix, to be released with free_matrix.
+ */
+dist_t** alloc_matrix(int rows, int cols);
+
+/* Free a matrix allocated with alloc_matrix.
+ * Parameters:
+ *          matrix - the matrix to be freed
+ */
+void free_matrix(dist_t** matrix);
+
+/* Check whether a graph has any negative edge weights.
+ * Parameters:
+ *          graph - the graph in question
+ * Return:
+ *          1 if any edge weight is negative, 0 otherwise.
+ */
+int has_negative_weights(Graph* graph);
+
+/* Check whether an edge weight is itself a distance of this build.
+ *  16-bit distances are unsigned, so hold no negative weight, and no width
+ *  holds DIST_INF, which marks a missing edge.
+ * Parameters:
+ *          weight - the edge weight
+ * Return:
+ *          1 if the weight fits, 0 otherwise.
+ */
+int weight_fits_distance(int weight);
+
+/* Check whether every edge weight of a graph is a distance of this build.
+ *  Sums of distances can be checked as they are found, but a weight that
+ *  does not fit is wrong before any sum is taken.
+ * Parameters:
+ *          graph - the graph in question
+ * Return:
+ *          1 if every weight fits, 0 otherwise.
+ */
+int weights_fit_distances(Graph* graph);
+
+/* Find the narrowest distance width that holds every shortest path.
+ *  A shortest path has at most |V| - 1 edges, so is bounded by the largest
+ *  weight times that, and relaxing adds two paths, so a width must hold
+ *  twice the bound. Totals of |V| paths must also fit in 64 bits.
+ * Parameters:
+ *          graph - the graph in question
+ * Return:
+ *          16, 32 or 64, or 0 if no width is safe.
+ */
+int distance_bits_needed(Graph* graph);
+
+/* Add two distances, checking that the sum is a distance.
+ * Parameters:
+ *          a - the first distance, not DIST_INF
+ *          b - the second distance, not DIST_INF
+ *          sum - out parameter holding the sum
+ * Return:
+ *          0 if the sum fits below DIST_INF, 1 otherwise.
+ */
+int add_distances(dist_t a, dist_t b, dist_t* sum);
+
+/* Record that a shortest path is too long for dist_t, from any thread.
+ */
+void mark_distance_overflow();
+
+/* Print that shortest paths are too long for this build's distances.
+ *  Names the width distance_bits_needed finds safe, or 64 bits if it finds
+ *  none wider than this build's.
+ * Parameters:
+ *          graph - the graph in question
+ */
+void report_distance_overflow(Graph* graph);
+
+/* Record that a negative cycle has been found, from any thread.
+ */
+void mark_negative_cycle();
 
 /* Partition the data for a given rank.
  * Balances remainders so that the largest partitions are only one element 
@@ -92,3 +260,122 @@ void set_partition(int rank, int size, int dataSize, int* start, int* end);
  *          The rank owning the partition containing the row.
  */
 int get_partition(int i, int size, int dataSize);
+
+/* Reduce a row of distances to its total and its maximum.
+ *  Both are 64-bit, so totals of narrow distances cannot overflow.
+ * Parameters:
+ *          row - the row of distances
+ *          size - the length of the row
+ *          sum - out parameter holding the total, LLONG_MAX if any distance is
+ *                DIST_INF
+ *          max - out parameter holding the largest distance, LLONG_MAX if any
+ *                distance is DIST_INF
+ */
+void summarise_row(dist_t* row, int size, long long* sum, long long* max);
+
+/* Gather per-row totals and maxima from every rank's partition onto rank 0.
+ *  Partitions are as given by set_partition.
+ * Parameters:
+ *          localSums - the totals of this rank's rows
+ *          localMaxes - the maxima of this rank's rows
+ *          sums - out parameter on rank 0 holding the totals of all rows
+ *          maxes - out parameter on rank 0 holding the maxima of all rows
+ *          dataSize - the number of rows in the data
+ *          comm - the communicator the ranks share
+ */
+void gather_row_summaries(long long* localSums, long long* localMaxes,
+        long long* sums, long long* maxes, int dataSize, MPI_Comm comm);
+
+/* Gather per-row totals and maxima from every rank's rows onto rank 0.
+ *  Each rank holds a contiguous range of rows given by bounds.
+ * Parameters:
+ *          localSums - the totals of this rank's rows
+ *          localMaxes - the maxima of this rank's rows
+ *          sums - out parameter on rank 0 holding the totals of all rows
+ *          maxes - out parameter on rank 0 holding the maxima of all rows
+ *          bounds - the bounds of each rank's rows, rank r owning rows
+ *                   bounds[r] to bounds[r+1] - 1
+ *          comm - the communicator the ranks share
+ */
+void gather_bounded_summaries(long long* localSums, long long* localMaxes,
+        long long* sums, long long* maxes, int* bounds, MPI_Comm comm);
+
+/* Combine partial per-row totals and maxima from every rank onto rank 0.
+ *  For when each rank only holds pieces of rows. A partial maximum of
+ *  LLONG_MAX marks a row with an unreachable node, whose total is then
+ *  LLONG_MAX.
+ * Parameters:
+ *          partialSums - this rank's contribution to the total of each row
+ *          partialMaxes - this rank's contribution to the maximum of each row
+ *          sums - out parameter on rank 0 holding the totals of all rows
+ *          maxes - out parameter on rank 0 holding the maxima of all rows
+ *          dataSize - the number of rows in the data
+ *          comm - the communicator the ranks share
+ */
+void reduce_partial_summaries(long long* partialSums,
+        long long* partialMaxes, long long* sums, long long* maxes,
+        int dataSize, MPI_Comm comm);
+
+/* Partition the rows of an upper triangle between ranks.
+ *  Row i of the triangle holds dataSize - i entries, so rows are split to 
+ *  balance entries rather than rows.
+ * Parameters:
+ *          size - the total number of ranks
+ *          dataSize - the number of rows in the data
+ *          bounds - out parameter of size + 1 entries, rank r owning rows
+ *                   bounds[r] to bounds[r+1] - 1
+ */
+void set_triangle_bounds(int size, int dataSize, int* bounds);
+
+/* Find the ids with the minimum score, in ascending order.
+ * Parameters:
+ *          scores - the score of each id
+ *          size - the number of ids
+ * Return:
+ *          The head of a list of the ids sharing the minimum score.
+ */
+ListNode* min_centres(long long* scores, int size);
+
+/* Whether one id ranks before another, by lower score then lower id.
+ * Parameters:
+ *          scores - the score of each id
+ *          a - the first id
+ *          b - the second id
+ * Return:
+ *          1 if a ranks before b, 0 otherwise.
+ */
+int ranks_before(long long* scores, int a, int b);
+
+/* Restore a heap of ids, whose root ranks last, below one of its entries.
+ * Parameters:
+ *          heap - the ids in the heap
+ *          count - the number of ids in the heap
+ *          i - the entry that may rank before one of its children
+ *          scores - the score of each id
+ */
+void sift_down_ranked(int* heap, int count, int i, long long* scores);
+
+/* Offer an id to a heap holding the best ids seen so far.
+ *  Once full, the id replaces the root, which ranks last, if it ranks before
+ *  it.
+ * Parameters:
+ *          heap - the ids in the heap, room for k
+ *          count - the number of ids in the heap, updated as it grows
+ *          k - the most ids the heap holds, at least 1
+ *          id - the id being offered
+ *          scores - the score of each id
+ */
+void push_ranked(int* heap, int* count, int k, int id, long long* scores);
+
+/* Find the ids with the k lowest scores, ties going to the lower id.
+ *  Each thread keeps a heap of the best ids of its share, and the heaps are
+ *  merged, so only O(k) ids per thread are ever compared against each other.
+ * Parameters:
+ *          scores - the score of each id
+ *          size - the number of ids
+ *          k - the number of ids wanted
+ *          top - out parameter of k entries holding the ids, best first
+ * Return:
+ *          The number of ids found, the lesser of k and size.
+ */
+int top_ids(long long* scores, int size, int k, int* top);
@@ -0,0 +1,534 @@
+/* =============================================================================
+ * incremental.c Long-running solves kept up to date as edges are inserted,
+ *               lowered and deleted, rather than solved again from scratch
+ * =============================================================================
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <omp.h>
+#include <mpi.h>
+#include "helper.h"
+#include "io.h"
+#include "sparse.h"
+#include "instrument.h"
+#include "incremental.h"
+
+/* Solve a graph and set up the state kept between updates.
+ *  Each rank searches from the sources in its partition with Dijkstra,
+ *  keeping the rows. Requires non-negative weights.
+ * Parameters:
+ *          graph - the graph in question, whose edges are copied
+ *          comm - the communicator the ranks share
+ * Return:
+ *          The state of this rank.
+ */
+UpdateState* update_init(Graph* graph, MPI_Comm comm) {
+    UpdateState* state = malloc(sizeof(UpdateState));
+    state->comm = comm;
+    MPI_Comm_rank(comm, &state->rank);
+    MPI_Comm_size(comm, &state->size);
+    if (has_negative_weights(graph)) {
+        if (state->rank == 0) {
+            printf("Updates need non-negative edge weights.\n");
+        }
+        exit(1);
+    }
+
+    PHASE_START(PHASE_MATRIX_INIT);
+    // Binary graphs are memory-mapped, so the edges are copied to grow them
+    state->graph = *graph;
+    state->graph.connections = NULL;
+    state->edgeCapacity = graph->edgeCount > 0 ? graph->edgeCount : 1;
+    state->graph.edgeFrom = malloc(state->edgeCapacity * sizeof(int));
+    state->graph.edgeTo = malloc(state->edgeCapacity * sizeof(int));
+    state->graph.edgeWeights = malloc(state->edgeCapacity * sizeof(int));
+    memcpy(state->graph.edgeFrom, graph->edgeFrom,
+            graph->edgeCount * sizeof(int));
+    memcpy(state->graph.edgeTo, graph->edgeTo, graph->edgeCount * sizeof(int));
+    memcpy(state->graph.edgeWeights, graph->edgeWeights,
+            graph->edgeCount * sizeof(int));
+
+    int nodeCount = graph->nodeCount;
+    set_partition(state->rank, state->size, nodeCount, &state->start,
+            &state->end);
+    int rowCount = state->end - state->start + 1;
+    state->rows = alloc_matrix(rowCount, nodeCount);
+    state->localSums = malloc((rowCount > 0 ? rowCount : 1)
+            * sizeof(long long));
+    state->localMaxes = malloc((rowCount > 0 ? rowCount : 1)
+            * sizeof(long long));
+    state->changed = malloc(rowCount > 0 ? rowCount : 1);
+    state->fromRow = malloc(nodeCount * sizeof(dist_t));
+    state->toRow = malloc(nodeCount * sizeof(dist_t));
+    memset(state->changed, 1, rowCount > 0 ? rowCount : 1);
+    PHASE_STOP(PHASE_MATRIX_INIT);
+
+    PHASE_START(PHASE_COMPUTE);
+    search_sources(state, state->changed);
+    PHASE_STOP(PHASE_COMPUTE);
+    return state;
+}
+
+/* Free the state kept between updates.
+ * Parameters:
+ *          state - the state of this rank
+ */
+void free_update_state(UpdateState* state) {
+    free(state->graph.edgeFrom);
+    free(state->graph.edgeTo);
+    free(state->graph.edgeWeights);
+    free_matrix(state->rows);
+    free(state->localSums);
+    free(state->localMaxes);
+    free(state->changed);
+    free(state->fromRow);
+    free(state->toRow);
+    free(state);
+}
+
+/* Search from the chosen resident sources over the current edges.
+ * Parameters:
+ *          state - the state of this rank
+ *          sources - whether to search from each row of this rank's partition
+ */
+void search_sources(UpdateState* state, char* sources) {
+    CSRGraph* csr = build_csr(&state->graph);
+    int nodeCount = state->graph.nodeCount;
+    #pragma omp parallel
+    {
+        int* heap = malloc(nodeCount * sizeof(int));
+        int* heapPos = malloc(nodeCount * sizeof(int));
+        // Search cost varies by source, so hand them out dynamically
+        #pragma omp for schedule(dynamic, 4)
+        for (int i = state->start; i <= state->end; i++) {
+            if (!sources[i - state->start]) continue;
+            dijkstra(csr, i, state->rows[i - state->start], heap, heapPos);
+        }
+        free(heap);
+        free(heapPos);
+    }
+    free_csr(csr);
+}
+
+/* Broadcast a row from the rank holding it.
+ * Parameters:
+ *          state - the state of this rank
+ *          node - the source of the row
+ *          row - out parameter holding a copy of the row
+ */
+void broadcast_row(UpdateState* state, int node, dist_t* row) {
+    int nodeCount = state->graph.nodeCount;
+    int owner = get_partition(node, state->size, nodeCount);
+    if (owner == state->rank) {
+        memcpy(row, state->rows[node - state->start],
+                nodeCount * sizeof(dist_t));
+    }
+    MPI_Bcast(row, nodeCount, MPI_DIST, owner, state->comm);
+}
+
+/* Find the edge between two nodes, as the sparse adjacency would.
+ *  Where an edge is given more than once the last weight wins, so this is
+ *  the last one given. Edges of undirected graphs match either way round.
+ * Parameters:
+ *          graph - the graph in question
+ *          from - the first node of the edge
+ *          to - the second node of the edge
+ * Return:
+ *          The index of the edge, or -1 if there is none.
+ */
+int find_edge(Graph* graph, int from, int to) {
+    for (int e = graph->edgeCount - 1; e >= 0; e--) {
+        if ((graph->edgeFrom[e] == from && graph->edgeTo[e] == to)
+                || (!graph->directed && graph->edgeFrom[e] == to
+                && graph->edgeTo[e] == from)) {
+            return e;
+        }
+    }
+    return -1;
+}
+
+/* Add an edge to the end of the state's edges, growing them as needed.
+ * Parameters:
+ *          state - the state of this rank
+ *          from - the first node of the edge
+ *          to - the second node of the edge
+ *          weight - the weight of the edge
+ */
+void append_edge(UpdateState* state, int from, int to, int weight) {
+    Graph* graph = &state->graph;
+    if (graph->edgeCount == state->edgeCapacity) {
+        state->edgeCapacity *= 2;
+        graph->edgeFrom = realloc(graph->edgeFrom,
+                state->edgeCapacity * sizeof(int));
+        graph->edgeTo = realloc(graph->edgeTo,
+                state->edgeCapacity * sizeof(int));
+        graph->edgeWeights = realloc(graph->edgeWeights,
+                state->edgeCapacity * sizeof(int));
+    }
+    graph->edgeFrom[graph->edgeCount] = from;
+    graph->edgeTo[graph->edgeCount] = to;
+    graph->edgeWeights[graph->edgeCount] = weight;
+    graph->edgeCount++;
+}
+
+/* Remove every copy of the edge between two nodes, keeping the order of the
+ *  rest so repeated edges still resolve the same way.
+ * Parameters:
+ *          graph - the graph in question
+ *          from - the first node of the edge
+ *          to - the second node of the edge
+ */
+void remove_edges(Graph* graph, int from, int to) {
+    int kept = 0;
+    for (int e = 0; e < graph->edgeCount; e++) {
+        if ((graph->edgeFrom[e] == from && graph->edgeTo[e] == to)
+                || (!graph->directed && graph->edgeFrom[e] == to
+                && graph->edgeTo[e] == from)) {
+            continue;
+        }
+        graph->edgeFrom[kept] = graph->edgeFrom[e];
+        graph->edgeTo[kept] = graph->edgeTo[e];
+        graph->edgeWeights[kept] = graph->edgeWeights[e];
+        kept++;
+    }
+    graph->edgeCount = kept;
+}
+
+/* Parse and check one line of the update stream, on rank 0.
+ *  Lines are insert from to weight, decrease from to weight, or delete from
+ *  to. Blank lines and lines starting with # are skipped, and events that do
+ *  not apply to the graph are reported and skipped.
+ * Parameters:
+ *          state - the state of this rank
+ *          text - the line, without its newline
+ *          line - the line number, 1-indexed
+ *          event - out parameter holding the event
+ */
+void parse_update(UpdateState* state, char* text, int line,
+        UpdateEvent* event) {
+    Graph* graph = &state->graph;
+    event->type = UPDATE_SKIP;
+    char name[16];
+    int fields = sscanf(text, "%15s %d %d %d", name, &event->from, &event->to,
+            &event->weight);
+    if (fields <= 0 || name[0] == '#') return;
+
+    int type = UPDATE_SKIP;
+    if (strcmp(name, "insert") == 0 && fields == 4) {
+        type = UPDATE_INSERT;
+    } else if (strcmp(name, "decrease") == 0 && fields == 4) {
+        type = UPDATE_DECREASE;
+    } else if (strcmp(name, "delete") == 0 && fields >= 3) {
+        type = UPDATE_DELETE;
+    } else {
+        printf("Update line %i is not insert, decrease or delete.\n", line);
+        return;
+    }
+    if (event->from < 0 || event->from >= graph->nodeCount || event->to < 0
+            || event->to >= graph->nodeCount) {
+        printf("Update line %i names a node outside the graph.\n", line);
+        return;
+    }
+    if (event->from == event->to) {
+        // Self-loops never shorten a path
+        return;
+    }
+    if (type != UPDATE_DELETE && event->weight < 0) {
+        printf("Update line %i has a negative weight.\n", line);
+        return;
+    }
+
+    int edge = find_edge(graph, event->from, event->to);
+    if (type == UPDATE_INSERT) {
+        if (edge != -1) {
+            printf("Update line %i inserts an edge that already exists.\n",
+                    line);
+            return;
+        }
+        // Long paths are checked as they are relaxed, as on loading, but
+        // the weight itself must be a distance
+        if (!weight_fits_distance(event->weight)) {
+            printf("Update line %i has a weight too large for %i-bit "
+                    "distances.\n", line, DIST_BITS);
+            return;
+        }
+    } else if (edge == -1) {
+        printf("Update line %i changes an edge that does not exist.\n", line);
+        return;
+    } else if (type == UPDATE_DECREASE
+            && event->weight > graph->edgeWeights[edge]) {
+        printf("Update line %i raises a weight, delete and insert instead.\n",
+                line);
+        return;
+    } else if (type == UPDATE_DELETE) {
+        // Deletion needs the weight the edge had to find affected sources
+        event->weight = graph->edgeWeights[edge];
+    }
+    event->type = type;
+}
+
+/* Lower the length of the edge from one node to another, including from no
+ *  edge at all, and relax every resident row through it.
+ *  A shortest path uses the edge at most once, so with the old distances
+ *  d(i, j) becomes min(d(i, j), d(i, from) + weight + d(to, j)), and the
+ *  reverse for undirected graphs. O(|V|^2 / ranks) per edge.
+ * Parameters:
+ *          state - the state of this rank
+ *          from - the first node of the edge
+ *          to - the second node of the edge
+ *          weight - the new, lower, weight of the edge
+ */
+void relax_through_edge(UpdateState* state, int from, int to, int weight) {
+    int nodeCount = state->graph.nodeCount;
+    int directed = state->graph.directed;
+    dist_t* fromRow = state->fromRow;
+    dist_t* toRow = state->toRow;
+
+    // Rows are relaxed in place, so both ends' old rows are copied first
+    PHASE_START(PHASE_EXCHANGE);
+    broadcast_row(state, to, toRow);
+    if (!directed) broadcast_row(state, from, fromRow);
+    PHASE_STOP(PHASE_EXCHANGE);
+
+    PHASE_START(PHASE_COMPUTE);
+    #pragma omp parallel for
+    for (int i = state->start; i <= state->end; i++) {
+        dist_t* row = state->rows[i - state->start];
+        dist_t toFrom = row[from];
+        dist_t toTo = row[to];
+        int changed = 0;
+        if (toFrom != DIST_INF) {
+            long long via = (long long) toFrom + weight;
+            for (int j = 0; j < nodeCount; j++) {
+                if (toRow[j] == DIST_INF) continue;
+                long long candidate = via + toRow[j];
+                if (candidate < row[j]) {
+                    row[j] = candidate;
+                    changed = 1;
+                } else if (row[j] == DIST_INF) {
+                    // A path, but too long for dist_t
+                    mark_distance_overflow();
+                }
+            }
+        }
+        if (!directed && toTo != DIST_INF) {
+            long long via = (long long) toTo + weight;
+            for (int j = 0; j < nodeCount; j++) {
+                if (fromRow[j] == DIST_INF) continue;
+                long long candidate = via + fromRow[j];
+                if (candidate < row[j]) {
+                    row[j] = candidate;
+                    changed = 1;
+                } else if (row[j] == DIST_INF) {
+                    mark_distance_overflow();
+                }
+            }
+        }
+        if (changed) state->changed[i - state->start] = 1;
+    }
+    PHASE_STOP(PHASE_COMPUTE);
+}
+
+/* Search again from every resident source whose shortest paths may have used
+ *  an edge that has been deleted.
+ *  Only sources for which the edge was tight, d(i, to) = d(i, from) + weight
+ *  or the reverse for undirected graphs, can have used it.
+ * Parameters:
+ *          state - the state of this rank, with the edge already removed
+ *          from - the first node of the edge
+ *          to - the second node of the edge
+ *          weight - the weight the edge had
+ */
+void research_affected_sources(UpdateState* state, int from, int to,
+        int weight) {
+    int directed = state->graph.directed;
+    int rowCount = state->end - state->start + 1;
+    char* affected = calloc(rowCount > 0 ? rowCount : 1, sizeof(char));
+
+    PHASE_START(PHASE_COMPUTE);
+    for (int r = 0; r < rowCount; r++) {
+        dist_t* row = state->rows[r];
+        affected[r] = (row[from] != DIST_INF
+                && (long long) row[from] + weight == row[to])
+                || (!directed && row[to] != DIST_INF
+                && (long long) row[to] + weight == row[from]);
+    }
+    search_sources(state, affected);
+    for (int r = 0; r < rowCount; r++) {
+        if (affected[r]) state->changed[r] = 1;
+    }
+    PHASE_STOP(PHASE_COMPUTE);
+    free(affected);
+}
+
+/* Apply an event to the edges and the resident rows.
+ * Parameters:
+ *          state - the state of this rank
+ *          event - the event, the same on every rank
+ */
+void apply_update(UpdateState* state, UpdateEvent* event) {
+    if (event->type == UPDATE_INSERT) {
+        // Only the new weight can push paths past what the build holds, in
+        // which case later searches check their sums as if loaded with it
+        Graph probe = state->graph;
+        probe.edgeCount = 1;
+        probe.edgeWeights = &event->weight;
+        int bitsNeeded = distance_bits_needed(&probe);
+        if (bitsNeeded == 0 || bitsNeeded > DIST_BITS) checkedDistances = 1;
+        append_edge(state, event->from, event->to, event->weight);
+        relax_through_edge(state, event->from, event->to, event->weight);
+    } else if (event->type == UPDATE_DECREASE) {
+        int edge = find_edge(&state->graph, event->from, event->to);
+        state->graph.edgeWeights[edge] = event->weight;
+        relax_through_edge(state, event->from, event->to, event->weight);
+    } else if (event->type == UPDATE_DELETE) {
+        remove_edges(&state->graph, event->from, event->to);
+        research_affected_sources(state, event->from, event->to,
+                event->weight);
+    }
+}
+
+/* Write centres to a file by way of a temporary file, so readers of a
+ *  long-running solve only ever see a whole file.
+ * Parameters:
+ *          filename - the path and name of the file
+ *          head - the head of the list of centres
+ *          graph - the graph in question
+ */
+void replace_file(char* filename, ListNode* head, Graph* graph) {
+    char* tempFilename = malloc((strlen(filename) + 8) * sizeof(char));
+    sprintf(tempFilename, "%s.tmp", filename);
+    write_file(tempFilename, head, graph);
+    rename(tempFilename, filename);
+    free(tempFilename);
+}
+
+/* Gather the row totals and maxima and write the centres by both metrics.
+ *  Only rows changed since the last write are summarised again. Files are
+ *  replaced whole, so readers never see a partial write. Nothing is written
+ *  while the graph is disconnected.
+ * Parameters:
+ *          state - the state of this rank
+ *          minTotalFilename - where the minimum total distance centres go
+ *          minMaxFilename - where the minimum maximum distance centres go
+ */
+void write_updated_centres(UpdateState* state, char* minTotalFilename,
+        char* minMaxFilename) {
+    int nodeCount = state->graph.nodeCount;
+    int rowCount = state->end - state->start + 1;
+
+    PHASE_START(PHASE_COMPUTE);
+    #pragma omp parallel for schedule(dynamic, 16)
+    for (int r = 0; r < rowCount; r++) {
+        if (!state->changed[r]) continue;
+        summarise_row(state->rows[r], nodeCount, &state->localSums[r],
+                &state->localMaxes[r]);
+        state->changed[r] = 0;
+    }
+    PHASE_STOP(PHASE_COMPUTE);
+
+    PHASE_START(PHASE_GATHER);
+    long long* sums = NULL;
+    long long* maxes = NULL;
+    if (state->rank == 0) {
+        sums = malloc(nodeCount * sizeof(long long));
+        maxes = malloc(nodeCount * sizeof(long long));
+    }
+    gather_row_summaries(state->localSums, state->localMaxes, sums, maxes,
+            nodeCount, state->comm);
+    int overflow = 0;
+    MPI_Reduce(&distanceOverflow, &overflow, 1, MPI_INT, MPI_MAX, 0,
+            state->comm);
+    PHASE_STOP(PHASE_GATHER);
+    if (state->rank != 0) return;
+    // Distances once too long stay wrong, so nothing more can be written
+    if (overflow) {
+        report_distance_overflow(&state->graph);
+        free(sums);
+        free(maxes);
+        return;
+    }
+
+    PHASE_START(PHASE_CENTRES);
+    int connected = 1;
+    for (int i = 0; i < nodeCount; i++) {
+        if (sums[i] == LLONG_MAX) connected = 0;
+    }
+    ListNode* minTotalCentres = NULL;
+    ListNode* minMaxCentres = NULL;
+    if (connected) {
+        minTotalCentres = min_centres(sums, nodeCount);
+        minMaxCentres = min_centres(maxes, nodeCount);
+    }
+    PHASE_STOP(PHASE_CENTRES);
+
+    // A later event may reconnect it, so keep going either way
+    if (!connected) {
+        printf("Disconnected subgraph detected, solution undefined\n");
+    } else {
+        PHASE_START(PHASE_WRITE);
+        replace_file(minTotalFilename, minTotalCentres, &state->graph);
+        replace_file(minMaxFilename, minMaxCentres, &state->graph);
+        PHASE_STOP(PHASE_WRITE);
+        free_list(minTotalCentres);
+        free_list(minMaxCentres);
+    }
+    free(sums);
+    free(maxes);
+}
+
+/* Solve a graph, then keep its centres up to date through a stream of edge
+ *  events until the stream ends.
+ *  Rank 0 reads the stream, which may be a named pipe, or - for standard
+ *  input, and the centres are written again after every event.
+ * Parameters:
+ *          graph - the graph in question
+ *          updateFile - the path of the update stream
+ *          minTotalFilename - where the minimum total distance centres go
+ *          minMaxFilename - where the minimum maximum distance centres go
+ *          comm - the communicator the ranks share
+ */
+void run_updates(Graph* graph, char* updateFile, char* minTotalFilename,
+        char* minMaxFilename, MPI_Comm comm) {
+    UpdateState* state = update_init(graph, comm);
+    write_updated_centres(state, minTotalFilename, minMaxFilename);
+
+    FILE* stream = NULL;
+    if (state->rank == 0) {
+        stream = strcmp(updateFile, "-") == 0 ? stdin
+                : fopen(updateFile, "r");
+        if (stream == NULL) {
+            printf("Update stream %s could not be opened.\n", updateFile);
+            exit(1);
+        }
+    }
+
+    char text[UPDATE_LINE_LENGTH];
+    int line = 0;
+    UpdateEvent event;
+    while (1) {
+        if (state->rank == 0) {
+            if (fgets(text, sizeof(text), stream) == NULL) {
+                event.type = UPDATE_END;
+            } else {
+                line++;
+                text[strcspn(text, "\r\n")] = '\0';
+                parse_update(state, text, line, &event);
+            }
+            // Streams are watched as they run, so don't hold messages back
+            fflush(stdout);
+        }
+        MPI_Bcast(&event, sizeof(UpdateEvent) / sizeof(int), MPI_INT, 0,
+                comm);
+        if (event.type == UPDATE_END) break;
+        if (event.type == UPDATE_SKIP) continue;
+
+        apply_update(state, &event);
+        write_updated_centres(state, minTotalFilename, minMaxFilename);
+    }
+
+    if (stream != NULL && stream != stdin) fclose(stream);
+    free_update_state(state);
+}
@@ -0,0 +1,189 @@
+/* =============================================================================
+ * incremental.h Long-running solves kept up to date as edges are inserted,
+ *               lowered and deleted, rather than solved again from scratch
+ * =============================================================================
+ */
+
+// Longest line of an update stream
+#define UPDATE_LINE_LENGTH 256
+
+// Kinds of update event
+enum {
+    UPDATE_END,
+    UPDATE_SKIP,
+    UPDATE_INSERT,
+    UPDATE_DECREASE,
+    UPDATE_DELETE
+};
+
+/* An edge event read from the update stream.
+ */
+typedef struct {
+    int type;
+    int from;
+    int to;
+    int weight;
+} UpdateEvent;
+
+/* The resident state of one rank between updates.
+ *  Each rank keeps the full rows of its partition of sources, with their
+ *  totals and maxima, and every rank keeps the same copy of the edges.
+ */
+typedef struct {
+    Graph graph;
+    int edgeCapacity;
+    int start;
+    int end;
+    dist_t** rows;
+    long long* localSums;
+    long long* localMaxes;
+    char* changed;
+    dist_t* fromRow;
+    dist_t* toRow;
+    int rank;
+    int size;
+    MPI_Comm comm;
+} UpdateState;
+
+/* Solve a graph and set up the state kept between updates.
+ *  Each rank searches from the sources in its partition with Dijkstra,
+ *  keeping the rows. Requires non-negative weights.
+ * Parameters:
+ *          graph - the graph in question, whose edges are copied
+ *          comm - the communicator the ranks share
+ * Return:
+ *          The state of this rank.
+ */
+UpdateState* update_init(Graph* graph, MPI_Comm comm);
+
+/* Free the state kept between updates.
+ * Parameters:
+ *          state - the state of this rank
+ */
+void free_update_state(UpdateState* state);
+
+/* Search from the chosen resident sources over the current edges.
+ * Parameters:
+ *          state - the state of this rank
+ *          sources - whether to search from each row of this rank's partition
+ */
+void search_sources(UpdateState* state, char* sources);
+
+/* Broadcast a row from the rank holding it.
+ * Parameters:
+ *          state - the state of this rank
+ *          node - the source of the row
+ *          row - out parameter holding a copy of the row
+ */
+void broadcast_row(UpdateState* state, int node, dist_t* row);
+
+/* Find the edge between two nodes, as the sparse adjacency would.
+ *  Where an edge is given more than once the last weight wins, so this is
+ *  the last one given. Edges of undirected graphs match either way round.
+ * Parameters:
+ *          graph - the graph in question
+ *          from - the first node of the edge
+ *          to - the second node of the edge
+ * Return:
+ *          The index of the edge, or -1 if there is none.
+ */
+int find_edge(Graph* graph, int from, int to);
+
+/* Add an edge to the end of the state's edges, growing them as needed.
+ * Parameters:
+ *          state - the state of this rank
+ *          from - the first node of the edge
+ *          to - the second node of the edge
+ *          weight - the weight of the edge
+ */
+void append_edge(UpdateState* state, int from, int to, int weight);
+
+/* Remove every copy of the edge between two nodes, keeping the order of the
+ *  rest so repeated edges still resolve the same way.
+ * Parameters:
+ *          graph - the graph in question
+ *          from - the first node of the edge
+ *          to - the second node of the edge
+ */
+void remove_edges(Graph* graph, int from, int to);
+
+/* Parse and check one line of the update stream, on rank 0.
+ *  Lines are insert from to weight, decrease from to weight, or delete from
+ *  to. Blank lines and lines starting with # are skipped, and events that do
+ *  not apply to the graph are reported and skipped.
+ * Parameters:
+ *          state - the state of this rank
+ *          text - the line, without its newline
+ *          line - the line number, 1-indexed
+ *          event - out parameter holding the event
+ */
+void parse_update(UpdateState* state, char* text, int line,
+        UpdateEvent* event);
+
+/* Lower the length of the edge from one node to another, including from no
+ *  edge at all, and relax every resident row through it.
+ *  A shortest path uses the edge at most once, so with the old distances
+ *  d(i, j) becomes min(d(i, j), d(i, from) + weight + d(to, j)), and the
+ *  reverse for undirected graphs. O(|V|^2 / ranks) per edge.
+ * Parameters:
+ *          state - the state of this rank
+ *          from - the first node of the edge
+ *          to - the second node of the edge
+ *          weight - the new, lower, weight of the edge
+ */
+void relax_through_edge(UpdateState* state, int from, int to, int weight);
+
+/* Search again from every resident source whose shortest paths may have used
+ *  an edge that has been deleted.
+ *  Only sources for which the edge was tight, d(i, to) = d(i, from) + weight
+ *  or the reverse for undirected graphs, can have used it.
+ * Parameters:
+ *          state - the state of this rank, with the edge already removed
+ *          from - the first node of the edge
+ *          to - the second node of the edge
+ *          weight - the weight the edge had
+ */
+void research_affected_sources(UpdateState* state, int from, int to,
+        int weight);
+
+/* Apply an event to the edges and the resident rows.
+ * Parameters:
+ *          state - the state of this rank
+ *          event - the event, the same on every rank
+ */
+void apply_update(UpdateState* state, UpdateEvent* event);
+
+/* Write centres to a file by way of a temporary file, so readers of a
+ *  long-running solve only ever see a whole file.
+ * Parameters:
+ *          filename - the path and name of the file
+ *          head - the head of the list of centres
+ *          graph - the graph in question
+ */
+void replace_file(char* filename, ListNode* head, Graph* graph);
+
+/* Gather the row totals and maxima and write the centres by both metrics.
+ *  Only rows changed since the last write are summarised again. Files are
+ *  replaced whole, so readers never see a partial write. Nothing is written
+ *  while the graph is disconnected.
+ * Parameters:
+ *          state - the state of this rank
+ *          minTotalFilename - where the minimum total distance centres go
+ *          minMaxFilename - where the minimum maximum distance centres go
+ */
+void write_updated_centres(UpdateState* state, char* minTotalFilename,
+        char* minMaxFilename);
+
+/* Solve a graph, then keep its centres up to date through a stream of edge
+ *  events until the stream ends.
+ *  Rank 0 reads the stream, which may be a named pipe, or - for standard
+ *  input, and the centres are written again after every event.
+ * Parameters:
+ *          graph - the graph in question
+ *          updateFile - the path of the update stream
+ *          minTotalFilename - where the minimum total distance centres go
+ *          minMaxFilename - where the minimum maximum distance centres go
+ *          comm - the communicator the ranks share
+ */
+void run_updates(Graph* graph, char* updateFile, char* minTotalFilename,
+        char* minMaxFilename, MPI_Comm comm);
@@ -0,0 +1,151 @@
+/* =============================================================================
+ * instrument.c Named phase timers aggregated across ranks into a report.
+ *              Only compiled in with -DINSTRUMENT, see make instrument
+ * =============================================================================
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <mpi.h>
+#include "instrument.h"
+
+char* phaseNames[PHASE_COUNT] = {"parse", "components", "matrix_init",
+        "exchange", "compute", "checkpoint", "gather", "centres", "write"};
+
+Instrument instrument;
+
+Instrument* rankInstruments = NULL;
+int rankCount = 0;
+
+/* Reset every phase timer.
+ * Parameters:
+ *          histograms - whether to bucket each call by its duration
+ */
+void instrument_init(int histograms) {
+    memset(&instrument, 0, sizeof(Instrument));
+    instrument.histograms = histograms;
+}
+
+/* Start timing a phase.
+ * Parameters:
+ *          phase - the phase being started
+ */
+void instrument_start(int phase) {
+    instrument.started[phase] = MPI_Wtime();
+}
+
+/* Stop timing a phase, adding the time since it started to its total.
+ *  Does nothing if the phase was not started.
+ * Parameters:
+ *          phase - the phase being stopped
+ */
+void instrument_stop(int phase) {
+    if (instrument.started[phase] == 0) return;
+    double elapsed = MPI_Wtime() - instrument.started[phase];
+    instrument.started[phase] = 0;
+    instrument.total[phase] += elapsed;
+    instrument.calls[phase]++;
+    if (instrument.histograms) {
+        instrument.buckets[phase][histogram_bucket(elapsed)]++;
+    }
+}
+
+/* Get the histogram bucket of a duration.
+ * Parameters:
+ *          seconds - the duration
+ * Return:
+ *          The bucket, from 0 to HISTOGRAM_BUCKETS - 1.
+ */
+int histogram_bucket(double seconds) {
+    double micros = seconds * 1e6;
+    int bucket = 0;
+    double limit = 1;
+    while (micros >= limit && bucket < HISTOGRAM_BUCKETS - 1) {
+        limit *= 2;
+        bucket++;
+    }
+    return bucket;
+}
+
+/* Gather the phase timers of every rank onto rank 0.
+ *  Rank 0's own timers are taken again at the report, so phases it runs
+ *  alone afterwards are still included.
+ * Parameters:
+ *          comm - the communicator the ranks share
+ */
+void instrument_collect(MPI_Comm comm) {
+    int rank;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &rankCount);
+    if (rank == 0) rankInstruments = malloc(rankCount * sizeof(Instrument));
+    MPI_Gather(&instrument, sizeof(Instrument), MPI_BYTE, rankInstruments,
+            sizeof(Instrument), MPI_BYTE, 0, comm);
+}
+
+/* Write the collected phase timers to a JSON report, on rank 0.
+ *  Each phase gets its call count and the minimum, mean and maximum of its
+ *  total over ranks, with the slowest rank. Histograms, if enabled, are given
+ *  for every rank so that stragglers show.
+ * Parameters:
+ *          filename - the file the report is written to
+ */
+void instrument_report(char* filename) {
+    if (rankInstruments == NULL) return;
+    rankInstruments[0] = instrument;
+
+    FILE* file = fopen(filename, "w");
+    if (file == NULL) {
+        printf("Report %s could not be written.\n", filename);
+        return;
+    }
+    fprintf(file, "{\n  \"ranks\": %i,\n  \"phases\": {\n", rankCount);
+    for (int p = 0; p < PHASE_COUNT; p++) {
+        double min = rankInstruments[0].total[p];
+        double max = min;
+        double sum = 0;
+        int maxRank = 0;
+        long calls = 0;
+        for (int r = 0; r < rankCount; r++) {
+            double total = rankInstruments[r].total[p];
+            sum += total;
+            if (total < min) min = total;
+            if (total > max) {
+                max = total;
+                maxRank = r;
+            }
+            if (rankInstruments[r].calls[p] > calls) {
+                calls = rankInstruments[r].calls[p];
+            }
+        }
+        fprintf(file, "    \"%s\": {\"calls\": %li, \"min\": %f, "
+                "\"mean\": %f, \"max\": %f, \"max_rank\": %i}%s\n",
+                phaseNames[p], calls, min, sum / rankCount, max, maxRank,
+                p + 1 < PHASE_COUNT ? "," : "");
+    }
+    fprintf(file, "  }");
+    if (instrument.histograms) {
+        // Bucket b counts calls under 2^b microseconds
+        fprintf(file, ",\n  \"histogram_bucket_us\": [");
+        for (int b = 0; b < HISTOGRAM_BUCKETS; b++) {
+            fprintf(file, "%s%lli", b > 0 ? ", " : "", 1LL << b);
+        }
+        fprintf(file, "],\n  \"histograms\": [\n");
+        for (int r = 0; r < rankCount; r++) {
+            fprintf(file, "    {\"rank\": %i", r);
+            for (int p = 0; p < PHASE_COUNT; p++) {
+                fprintf(file, ", \"%s\": [", phaseNames[p]);
+                for (int b = 0; b < HISTOGRAM_BUCKETS; b++) {
+                    fprintf(file, "%s%li", b > 0 ? ", " : "",
+                            rankInstruments[r].buckets[p][b]);
+                }
+                fprintf(file, "]");
+            }
+            fprintf(file, "}%s\n", r + 1 < rankCount ? "," : "");
+        }
+        fprintf(file, "  ]");
+    }
+    fprintf(file, "\n}\n");
+    fclose(file);
+    free(rankInstruments);
+    rankInstruments = NULL;
+}
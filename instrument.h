@@ -0,0 +1,104 @@
+/* =============================================================================
+ * instrument.h Named phase timers aggregated across ranks into a report.
+ *              Only compiled in with -DINSTRUMENT, see make instrument
+ * =============================================================================
+ */
+
+// Histogram bucket b counts phase calls taking under 2^b microseconds
+#define HISTOGRAM_BUCKETS 32
+
+// The phases of a solve that are timed
+enum {
+    PHASE_PARSE,
+    PHASE_COMPONENTS,
+    PHASE_MATRIX_INIT,
+    PHASE_EXCHANGE,
+    PHASE_COMPUTE,
+    PHASE_CHECKPOINT,
+    PHASE_GATHER,
+    PHASE_CENTRES,
+    PHASE_WRITE,
+    PHASE_COUNT
+};
+
+/* Timers for each phase on this rank.
+ *  Phases may be started and stopped many times, as the per-k phases are, and
+ *  each call is counted and optionally bucketed by its duration.
+ */
+typedef struct {
+    double started[PHASE_COUNT];
+    double total[PHASE_COUNT];
+    long calls[PHASE_COUNT];
+    int histograms;
+    long buckets[PHASE_COUNT][HISTOGRAM_BUCKETS];
+} Instrument;
+
+// Names of the phases in the report
+extern char* phaseNames[PHASE_COUNT];
+
+// Phase timers of this rank
+extern Instrument instrument;
+
+// Phase timers of every rank, on rank 0 once collected
+extern Instrument* rankInstruments;
+extern int rankCount;
+
+// Timers are only called in instrumented builds, so the hot loops carry
+// nothing otherwise. Only call them from one thread per rank.
+#ifdef INSTRUMENT
+#define INSTRUMENT_INIT(histograms) instrument_init(histograms)
+#define PHASE_START(phase) instrument_start(phase)
+#define PHASE_STOP(phase) instrument_stop(phase)
+#define INSTRUMENT_COLLECT(comm) instrument_collect(comm)
+#define INSTRUMENT_REPORT(filename) instrument_report(filename)
+#else
+#define INSTRUMENT_INIT(histograms) ((void) 0)
+#define PHASE_START(phase) ((void) 0)
+#define PHASE_STOP(phase) ((void) 0)
+#define INSTRUMENT_COLLECT(comm) ((void) 0)
+#define INSTRUMENT_REPORT(filename) ((void) 0)
+#endif
+
+/* Reset every phase timer.
+ * Parameters:
+ *          histograms - whether to bucket each call by its duration
+ */
+void instrument_init(int histograms);
+
+/* Start timing a phase.
+ * Parameters:
+ *          phase - the phase being started
+ */
+void instrument_start(int phase);
+
+/* Stop timing a phase, adding the time since it started to its total.
+ *  Does nothing if the phase was not started.
+ * Parameters:
+ *          phase - the phase being stopped
+ */
+void instrument_stop(int phase);
+
+/* Get the histogram bucket of a duration.
+ * Parameters:
+ *          seconds - the duration
+ * Return:
+ *          The bucket, from 0 to HISTOGRAM_BUCKETS - 1.
+ */
+int histogram_bucket(double seconds);
+
+/* Gather the phase timers of every rank onto rank 0.
+ *  Rank 0's own timers are taken again at the report, so phases it runs
+ *  alone afterwards are still included.
+ * Parameters:
+ *          comm - the communicator the ranks share
+ */
+void instrument_collect(MPI_Comm comm);
+
+/* Write the collected phase timers to a JSON report, on rank 0.
+ *  Each phase gets its call count and the minimum, mean and maximum of its
+ *  total over ranks, with the slowest rank. Histograms, if enabled, are given
+ *  for every rank so that stragglers show.
+ * Parameters:
+ *          filename - the file the report is written to
+ */
+void instrument_report(char* filename);
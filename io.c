@@ -7,58 +7,447 @@
 #include <stdlib.h>
 #include <string.h>
 #include <limits.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <omp.h>
+#include <mpi.h>
 #include "helper.h"
 #include "io.h"
 
 /* Read an input file describing a graph and construct that graph.
+ *  Files in the binary graph format are detected and memory-mapped.
  * Parameters:
  *          filename - the path and name of the file
  * Return:
- *          A fully constructed graph.
+ *          A fully constructed graph, or NULL if the file could not be read.
  */
 Graph* read_file(char* filename) {
     FILE* file = fopen(filename, "r");
     if (file == NULL) {
         printf("File %s could not be opened.\n", filename);
-        exit(1);
+        return NULL;
+    }
+
+    char magic[sizeof(BINARY_GRAPH_MAGIC) - 1];
+    if (fread(magic, 1, sizeof(magic), file) == sizeof(magic)
+            && memcmp(magic, BINARY_GRAPH_MAGIC, sizeof(magic)) == 0) {
+        fclose(file);
+        return read_binary_file(filename);
     }
 
+    // Read the whole file in large blocks rather than a character at a time
+    fseek(file, 0, SEEK_END);
+    size_t fileSize = ftell(file);
+    rewind(file);
+    char* text = malloc(fileSize + 1);
+    size_t length = 0;
+    size_t got;
+    while (length < fileSize && (got = fread(&text[length], 1, 
+            fileSize - length < READ_BLOCK_SIZE ? fileSize - length 
+            : READ_BLOCK_SIZE, file)) > 0) {
+        length += got;
+    }
+    text[length] = '\0';
+    fclose(file);
+
     Graph* graph = malloc(sizeof(Graph));
+    graph->nodeCount = 0;
+    graph->edgeCount = 0;
+    graph->storage = GRAPH_HEAP;
 
-    int bufferSize = sizeof(char) * 80;
-    char* lineBuffer = malloc(sizeof(char) * bufferSize);
-    int bufferPos = 0;
-    char c = 0;
+    // Header and label lines must be taken in order, and are few
+    size_t pos = 0;
     int line = 0;
+    while (pos < length && (line < 2 || line < 2 + graph->nodeCount)) {
+        char* lineEnd = memchr(&text[pos], '\n', length - pos);
+        size_t lineLength = lineEnd != NULL ? (size_t) (lineEnd - &text[pos])
+                : length - pos;
+        text[pos + lineLength] = '\0';
+        line++;
 
-    while ((c = fgetc(file)) != EOF) {
-        if (c == '\n') {
-            lineBuffer[bufferPos] = '\0';
-            line++;
+        process_line(&text[pos], line, lineLength, graph);
+        pos += lineLength + 1;
+    }
 
-            process_line(lineBuffer, line, bufferPos, graph);
+    parse_edges(&text[pos], pos < length ? length - pos : 0, graph);
+    free(text);
 
-            // Reset buffer
-            bufferPos = 0;
-            bufferSize = sizeof(char) * 80;
-            memset(&lineBuffer[0], 0, bufferSize);
-        } else {
-            lineBuffer[bufferPos] = c;
-            bufferPos++;
-            // Increase buffer size
-            if (bufferPos == bufferSize) {
-                bufferSize *= 2;
-                lineBuffer = realloc(lineBuffer, sizeof(char) * bufferSize);
+    return graph;
+}
+
+/* Parse an integer, skipping leading spaces and tabs, as atoi would.
+ * Parameters:
+ *          cursor - in/out parameter holding the position to parse from,
+ *                   left just after the integer
+ * Return:
+ *          The integer parsed, 0 if there was none.
+ */
+int parse_int(char** cursor) {
+    char* c = *cursor;
+    while (*c == ' ' || *c == '\t') c++;
+    int negative = 0;
+    if (*c == '-' || *c == '+') {
+        negative = *c == '-';
+        c++;
+    }
+    int value = 0;
+    while (*c >= '0' && *c <= '9') {
+        value = value * 10 + (*c - '0');
+        c++;
+    }
+    *cursor = c;
+    return negative ? -value : value;
+}
+
+/* Parse the edge lines of an input file into a graph's edge arrays.
+ *  The text is split into one chunk per thread at line boundaries. Lines are
+ *  counted per chunk first so each thread knows the index of its first edge,
+ *  then every chunk is parsed in parallel.
+ * Parameters:
+ *          text - the edge lines, followed by a NUL
+ *          length - the number of characters in the edge lines
+ *          graph - the graph being read in, with its edge arrays allocated
+ */
+void parse_edges(char* text, size_t length, Graph* graph) {
+    int chunks = omp_get_max_threads();
+    size_t* chunkStart = malloc((chunks + 1) * sizeof(size_t));
+    int* firstEdge = malloc((chunks + 1) * sizeof(int));
+    chunkStart[0] = 0;
+    chunkStart[chunks] = length;
+    for (int t = 1; t < chunks; t++) {
+        size_t pos = length / chunks * t;
+        if (pos < chunkStart[t - 1]) pos = chunkStart[t - 1];
+        // Move to the start of the next line
+        while (pos < length && pos > 0 && text[pos - 1] != '\n') pos++;
+        chunkStart[t] = pos;
+    }
+
+    // Count line starts, so a last line without a newline still counts
+    #pragma omp parallel for
+    for (int t = 0; t < chunks; t++) {
+        int lines = 0;
+        for (size_t pos = chunkStart[t]; pos < chunkStart[t + 1]; pos++) {
+            if (pos == 0 || text[pos - 1] == '\n') lines++;
+        }
+        firstEdge[t + 1] = lines;
+    }
+    firstEdge[0] = 0;
+    for (int t = 0; t < chunks; t++) {
+        firstEdge[t + 1] += firstEdge[t];
+    }
+
+    #pragma omp parallel for
+    for (int t = 0; t < chunks; t++) {
+        char* cursor = &text[chunkStart[t]];
+        char* chunkEnd = &text[chunkStart[t + 1]];
+        for (int e = firstEdge[t]; e < firstEdge[t + 1]; e++) {
+            if (e < graph->edgeCount) {
+                graph->edgeFrom[e] = parse_int(&cursor);
+                graph->edgeTo[e] = parse_int(&cursor);
+                graph->edgeWeights[e] = parse_int(&cursor);
             }
+            while (cursor < chunkEnd && *cursor != '\n') cursor++;
+            cursor++;
         }
     }
 
-    free(lineBuffer);
-    fclose(file);
+    // Only keep the edges actually given
+    if (firstEdge[chunks] < graph->edgeCount) {
+        graph->edgeCount = firstEdge[chunks];
+    }
+    free(chunkStart);
+    free(firstEdge);
+}
+
+/* Read a graph on rank 0 and broadcast it to every other rank.
+ *  Binary graphs are memory-mapped by every rank instead, since mapping
+ *  needs no parsing.
+ * Parameters:
+ *          filename - the path and name of the file
+ *          comm - the communicator the ranks share
+ * Return:
+ *          A fully constructed graph, or NULL on every rank if the file could
+ *          not be read.
+ */
+Graph* read_graph(char* filename, MPI_Comm comm) {
+    int rank;
+    MPI_Comm_rank(comm, &rank);
+
+    int binary = 0;
+    if (rank == 0) {
+        FILE* file = fopen(filename, "r");
+        char magic[sizeof(BINARY_GRAPH_MAGIC) - 1];
+        binary = file != NULL 
+                && fread(magic, 1, sizeof(magic), file) == sizeof(magic)
+                && memcmp(magic, BINARY_GRAPH_MAGIC, sizeof(magic)) == 0;
+        if (file != NULL) fclose(file);
+    }
+    MPI_Bcast(&binary, 1, MPI_INT, 0, comm);
+    if (binary) {
+        return agree_graph(read_binary_file(filename), comm);
+    }
+
+    Graph* graph = NULL;
+    if (rank == 0) {
+        graph = read_file(filename);
+    } else {
+        graph = malloc(sizeof(Graph));
+        graph->connections = NULL;
+        graph->directed = 0;
+        graph->storage = GRAPH_HEAP;
+    }
+    int failed = graph == NULL;
+    MPI_Bcast(&failed, 1, MPI_INT, 0, comm);
+    if (failed) {
+        free(graph);
+        return NULL;
+    }
+    broadcast_graph(graph, comm);
+    return graph;
+}
+
+/* Have every rank give up on a graph that any rank could not read, as when
+ *  one rank cannot map a binary graph the others could.
+ * Parameters:
+ *          graph - the graph this rank read, or NULL if it could not
+ *          comm - the communicator the ranks share
+ * Return:
+ *          The graph, or NULL on every rank if any rank could not read it.
+ */
+Graph* agree_graph(Graph* graph, MPI_Comm comm) {
+    int failed = graph == NULL;
+    MPI_Allreduce(MPI_IN_PLACE, &failed, 1, MPI_INT, MPI_MAX, comm);
+    if (failed && graph != NULL) {
+        free_graph(graph);
+        graph = NULL;
+    }
+    return graph;
+}
+
+/* Broadcast a graph read on rank 0 to every other rank.
+ * Parameters:
+ *          graph - the graph read in on rank 0, to be filled in elsewhere
+ *          comm - the communicator the ranks share
+ */
+void broadcast_graph(Graph* graph, MPI_Comm comm) {
+    int rank;
+    MPI_Comm_rank(comm, &rank);
+
+    // Labels travel as one buffer of NUL-terminated strings
+    int header[3] = {0, 0, 0};
+    char* labels = NULL;
+    if (rank == 0) {
+        header[0] = graph->nodeCount;
+        header[1] = graph->edgeCount;
+        for (int i = 0; i < graph->nodeCount; i++) {
+            header[2] += strlen(graph->nodeLabels[i]) + 1;
+        }
+        labels = malloc(header[2] + 1);
+        char* label = labels;
+        for (int i = 0; i < graph->nodeCount; i++) {
+            strcpy(label, graph->nodeLabels[i]);
+            label += strlen(label) + 1;
+        }
+    }
+    MPI_Bcast(header, 3, MPI_INT, 0, comm);
+    if (rank != 0) {
+        graph->nodeCount = header[0];
+        graph->edgeCount = header[1];
+        labels = malloc(header[2] + 1);
+        graph->edgeFrom = malloc(graph->edgeCount * sizeof(int));
+        graph->edgeTo = malloc(graph->edgeCount * sizeof(int));
+        graph->edgeWeights = malloc(graph->edgeCount * sizeof(int));
+    }
+    MPI_Bcast(labels, header[2], MPI_CHAR, 0, comm);
+    MPI_Bcast(graph->edgeFrom, graph->edgeCount, MPI_INT, 0, comm);
+    MPI_Bcast(graph->edgeTo, graph->edgeCount, MPI_INT, 0, comm);
+    MPI_Bcast(graph->edgeWeights, graph->edgeCount, MPI_INT, 0, comm);
+
+    // Every rank keeps its labels in the one buffer, for free_graph
+    if (rank == 0) {
+        for (int i = 0; i < graph->nodeCount; i++) {
+            free(graph->nodeLabels[i]);
+        }
+    } else {
+        graph->nodeLabels = malloc(graph->nodeCount * sizeof(char*));
+    }
+    char* label = labels;
+    for (int i = 0; i < graph->nodeCount; i++) {
+        graph->nodeLabels[i] = label;
+        label += strlen(label) + 1;
+    }
+    if (graph->nodeCount == 0) free(labels);
+}
+
+/* Memory-map a file in the binary graph format and construct that graph.
+ *  The edge arrays and labels point straight into the mapping, so ranks on
+ *  the same node share the file's pages rather than each parsing a copy.
+ *  The header, label table and edge endpoints are checked before use.
+ * Parameters:
+ *          filename - the path and name of the file
+ * Return:
+ *          A fully constructed graph, or NULL if the file could not be mapped
+ *          or is not a valid binary graph.
+ */
+Graph* read_binary_file(char* filename) {
+    int fd = open(filename, O_RDONLY);
+    struct stat info;
+    if (fd == -1 || fstat(fd, &info) == -1) {
+        printf("File %s could not be opened.\n", filename);
+        if (fd != -1) close(fd);
+        return NULL;
+    }
+    // The header must be there before any of its fields are read
+    if ((size_t) info.st_size < sizeof(BinaryGraphHeader)) {
+        printf("File %s is not a valid binary graph.\n", filename);
+        close(fd);
+        return NULL;
+    }
+    // The mapping outlives the descriptor, and lasts as long as the graph
+    char* data = mmap(NULL, info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        printf("File %s could not be mapped.\n", filename);
+        return NULL;
+    }
+
+    BinaryGraphHeader* header = (BinaryGraphHeader*) data;
+    size_t edgeBytes = 3 * (size_t) header->edgeCount * sizeof(int);
+    int* edges = (int*) (data + sizeof(BinaryGraphHeader));
+    char* labels = data + sizeof(BinaryGraphHeader) + edgeBytes;
+    int valid = header->nodeCount >= 0 && header->edgeCount >= 0
+            && header->labelBytes >= 0 && (size_t) info.st_size
+            == sizeof(BinaryGraphHeader) + edgeBytes + header->labelBytes;
+    // The last label must end in a NUL, so no label runs past the mapping
+    if (valid && header->nodeCount > 0) {
+        valid = header->labelBytes > 0 
+                && labels[header->labelBytes - 1] == '\0';
+    }
+    // Every edge must join two of the graph's nodes, sources then targets
+    if (valid) {
+        int nodeCount = header->nodeCount;
+        size_t endpoints = 2 * (size_t) header->edgeCount;
+        #pragma omp parallel for reduction(&&:valid)
+        for (size_t e = 0; e < endpoints; e++) {
+            valid = valid && edges[e] >= 0 && edges[e] < nodeCount;
+        }
+    }
+    if (!valid) {
+        printf("File %s is not a valid binary graph.\n", filename);
+        munmap(data, info.st_size);
+        return NULL;
+    }
+
+    Graph* graph = malloc(sizeof(Graph));
+    graph->nodeCount = header->nodeCount;
+    graph->edgeCount = header->edgeCount;
+    graph->connections = NULL;
+    graph->directed = 0;
+    graph->storage = GRAPH_MAPPED;
+    graph->edgeFrom = edges;
+    graph->edgeTo = &edges[graph->edgeCount];
+    graph->edgeWeights = &edges[2 * (size_t) graph->edgeCount];
+
+    char* label = labels;
+    char* labelEnd = labels + header->labelBytes;
+    graph->nodeLabels = malloc(graph->nodeCount * sizeof(char*));
+    for (int i = 0; i < graph->nodeCount; i++) {
+        if (label >= labelEnd) {
+            printf("File %s is not a valid binary graph.\n", filename);
+            free_graph(graph);
+            return NULL;
+        }
+        graph->nodeLabels[i] = label;
+        label += strlen(label) + 1;
+    }
 
     return graph;
 }
 
+/* Read how many nodes and edges a graph has, without reading the graph.
+ * Parameters:
+ *          filename - the path and name of the file, text or binary
+ *          nodeCount - out parameter holding the number of nodes
+ *          edgeCount - out parameter holding the number of edges
+ * Return:
+ *          0 if the counts were read, 1 if the file could not be read.
+ */
+int read_graph_size(char* filename, int* nodeCount, int* edgeCount) {
+    FILE* file = fopen(filename, "r");
+    if (file == NULL) return 1;
+    BinaryGraphHeader header;
+    int read = 0;
+    if (fread(&header, sizeof(header), 1, file) == 1 && memcmp(header.magic,
+            BINARY_GRAPH_MAGIC, sizeof(header.magic)) == 0) {
+        *nodeCount = header.nodeCount;
+        *edgeCount = header.edgeCount;
+        read = 1;
+    } else {
+        // Text graphs start with their node and edge counts
+        rewind(file);
+        read = fscanf(file, "%i %i", nodeCount, edgeCount) == 2;
+    }
+    fclose(file);
+    return !read || *nodeCount < 0 || *edgeCount < 0;
+}
+
+/* Free a graph from read_graph or read_shared_graph.
+ *  Edges in a host's shared memory are left for their window to release.
+ * Parameters:
+ *          graph - the graph to be freed
+ */
+void free_graph(Graph* graph) {
+    if (graph->connections != NULL) free_matrix(graph->connections);
+    if (graph->storage == GRAPH_MAPPED) {
+        // The header starts the mapping, just before the edges
+        char* data = (char*) graph->edgeFrom - sizeof(BinaryGraphHeader);
+        BinaryGraphHeader* header = (BinaryGraphHeader*) data;
+        munmap(data, sizeof(BinaryGraphHeader) + 3 * (size_t) 
+                header->edgeCount * sizeof(int) + header->labelBytes);
+    } else if (graph->storage == GRAPH_HEAP) {
+        if (graph->nodeCount > 0) free(graph->nodeLabels[0]);
+        free(graph->edgeFrom);
+        free(graph->edgeTo);
+        free(graph->edgeWeights);
+    }
+    free(graph->nodeLabels);
+    free(graph);
+}
+
+/* Write a graph in the binary graph format.
+ * Parameters:
+ *          filename - the path and name of the file to write to
+ *          graph - the graph in question
+ */
+void write_binary_file(char* filename, Graph* graph) {
+    FILE* file = fopen(filename, "wb");
+    if (file == NULL) {
+        printf("File %s could not be opened.\n", filename);
+        exit(1);
+    }
+
+    BinaryGraphHeader header;
+    memcpy(header.magic, BINARY_GRAPH_MAGIC, sizeof(header.magic));
+    header.nodeCount = graph->nodeCount;
+    header.edgeCount = graph->edgeCount;
+    header.labelBytes = 0;
+    for (int i = 0; i < graph->nodeCount; i++) {
+        header.labelBytes += strlen(graph->nodeLabels[i]) + 1;
+    }
+
+    fwrite(&header, sizeof(header), 1, file);
+    fwrite(graph->edgeFrom, sizeof(int), graph->edgeCount, file);
+    fwrite(graph->edgeTo, sizeof(int), graph->edgeCount, file);
+    fwrite(graph->edgeWeights, sizeof(int), graph->edgeCount, file);
+    for (int i = 0; i < graph->nodeCount; i++) {
+        fwrite(graph->nodeLabels[i], 1, strlen(graph->nodeLabels[i]) + 1, 
+                file);
+    }
+    fclose(file);
+}
+
 /* Write a file containing centres.
  * Parameters:
  *          filename - the path and name of the file to write to
@@ -76,6 +465,104 @@ void write_file(char* filename, ListNode* head, Graph* graph) {
     fclose(file);
 }
 
+/* Write the best nodes by a score to a file, one per line as
+ *  "<index> <name> <score>", best first, after the number of nodes.
+ * Parameters:
+ *          filename - the file being written to
+ *          top - the nodes, best first
+ *          count - the number of nodes
+ *          scores - the score of every node
+ *          graph - the graph in question
+ */
+void write_top_file(char* filename, int* top, int count, long long* scores,
+        Graph* graph) {
+    FILE* file = fopen(filename, "w");
+    fprintf(file, "%i\n", count);
+    for (int i = 0; i < count; i++) {
+        fprintf(file, "%i %s ", top[i], graph->nodeLabels[top[i]]);
+        if (scores[top[i]] == LLONG_MAX) {
+            fprintf(file, "inf\n");
+        } else {
+            fprintf(file, "%lli\n", scores[top[i]]);
+        }
+    }
+    fclose(file);
+}
+
+/* Write every node's scores to a file, one per line as
+ *  "<index> <name> <total> <eccentricity> <closeness>", after the number of
+ *  nodes. Unreachable totals and eccentricities are written as "inf".
+ * Parameters:
+ *          filename - the file being written to
+ *          sums - the total shortest path length from each node
+ *          maxes - the longest shortest path length from each node
+ *          closeness - the closeness of each node
+ *          graph - the graph in question
+ */
+void write_score_file(char* filename, long long* sums, long long* maxes,
+        double* closeness, Graph* graph) {
+    FILE* file = fopen(filename, "w");
+    fprintf(file, "%i\n", graph->nodeCount);
+    for (int i = 0; i < graph->nodeCount; i++) {
+        fprintf(file, "%i %s ", i, graph->nodeLabels[i]);
+        if (sums[i] == LLONG_MAX) {
+            fprintf(file, "inf ");
+        } else {
+            fprintf(file, "%lli ", sums[i]);
+        }
+        if (maxes[i] == LLONG_MAX) {
+            fprintf(file, "inf ");
+        } else {
+            fprintf(file, "%lli ", maxes[i]);
+        }
+        fprintf(file, "%.17g\n", closeness[i]);
+    }
+    fclose(file);
+}
+
+/* Write every node's betweenness to a file, one per line as
+ *  "<index> <name> <betweenness>", after the number of nodes.
+ * Parameters:
+ *          filename - the file being written to
+ *          scores - the betweenness of each node
+ *          graph - the graph in question
+ */
+void write_betweenness_file(char* filename, double* scores, Graph* graph) {
+    FILE* file = fopen(filename, "w");
+    fprintf(file, "%i\n", graph->nodeCount);
+    for (int i = 0; i < graph->nodeCount; i++) {
+        fprintf(file, "%i %s %.17g\n", i, graph->nodeLabels[i], scores[i]);
+    }
+    fclose(file);
+}
+
+/* Write every node's scores to a file in the binary score format, so they
+ *  can be read a column at a time without parsing.
+ * Parameters:
+ *          filename - the file being written to
+ *          sums - the total shortest path length from each node
+ *          maxes - the longest shortest path length from each node
+ *          closeness - the closeness of each node
+ *          nodeCount - the number of nodes
+ */
+void write_binary_scores(char* filename, long long* sums, long long* maxes,
+        double* closeness, int nodeCount) {
+    FILE* file = fopen(filename, "wb");
+    if (file == NULL) {
+        printf("File %s could not be opened.\n", filename);
+        exit(1);
+    }
+    BinaryScoresHeader header;
+    memcpy(header.magic, BINARY_SCORES_MAGIC, sizeof(header.magic));
+    header.nodeCount = nodeCount;
+    header.reserved = 0;
+    fwrite(&header, sizeof(header), 1, file);
+    fwrite(sums, sizeof(long long), nodeCount, file);
+    fwrite(maxes, sizeof(long long), nodeCount, file);
+    fwrite(closeness, sizeof(double), nodeCount, file);
+    fclose(file);
+}
+
 /* Parse and process a line read from the input file.
  * Parameters:
  *          lineBuffer - the line in question
@@ -87,39 +574,126 @@ void process_line(char* lineBuffer, int line, int length, Graph* graph) {
     if (line == 1) { // Node count line
         graph->nodeCount = atoi(lineBuffer);
         graph->nodeLabels = malloc(graph->nodeCount * sizeof(char*));
-        // Use full matrix instead of half for convenience - RAM will not be the
-        // bottleneck
-        graph->connections = malloc(graph->nodeCount * sizeof(int*));
-        for (int i = 0; i < graph->nodeCount; i++) {
-            graph->connections[i] = malloc(graph->nodeCount * sizeof(int));
-            // Init to INT_MAX instead of 0 to represent no connection, since
-            // 0 is a valid weight
-            for (int j = 0; j < graph->nodeCount; j++) {
-                if (i == j) {
-                    graph->connections[i][j] = 0;
-                } else {
-                    graph->connections[i][j] = INT_MAX;
-                }
-            }
-        }
-
+        graph->connections = NULL;
+        graph->directed = 0;
     } else if (line == 2) { // Edge count line
         graph->edgeCount = atoi(lineBuffer);
+        graph->edgeFrom = malloc(graph->edgeCount * sizeof(int));
+        graph->edgeTo = malloc(graph->edgeCount * sizeof(int));
+        graph->edgeWeights = malloc(graph->edgeCount * sizeof(int));
     } else if (line <= 2 + graph->nodeCount) { // Node label line
         int node_id = line - 2 - 1;
         graph->nodeLabels[node_id] = malloc(sizeof(char) * length + 1);
         strcpy(graph->nodeLabels[node_id], lineBuffer);
     } else { // Edge line
-        int from = atoi(strtok(lineBuffer, " "));
-        int to = atoi(strtok(NULL, " "));
-        int weight = atoi(strtok(NULL, " "));
+        int edge_id = line - 2 - graph->nodeCount - 1;
+        if (edge_id >= graph->edgeCount) return;
+        graph->edgeFrom[edge_id] = atoi(strtok(lineBuffer, " "));
+        graph->edgeTo[edge_id] = atoi(strtok(NULL, " "));
+        graph->edgeWeights[edge_id] = atoi(strtok(NULL, " "));
+    }
+}
+
+/* Expand the edge list of a graph into its dense connections matrix.
+ * Parameters:
+ *          graph - the graph being initialised
+ */
+void build_connections(Graph* graph) {
+    graph->connections = build_connection_rows(graph, 0, graph->nodeCount - 1);
+}
+
+/* Expand the edge list of a graph into some rows of its dense connections
+ *  matrix, for solvers where each rank only holds its own rows.
+ * Parameters:
+ *          graph - the graph in question
+ *          start - the first row, inclusive
+ *          end - the last row, inclusive
+ * Return:
+ *          The rows, row i at index i - start, to be released with
+ *          free_matrix.
+ */
+dist_t** build_connection_rows(Graph* graph, int start, int end) {
+    dist_t** rows = alloc_matrix(end - start + 1, graph->nodeCount);
+    fill_connection_rows(graph, start, end, rows);
+    return rows;
+}
+
+/* Fill some rows of the dense connections matrix of a graph in place.
+ * Parameters:
+ *          graph - the graph in question
+ *          start - the first row, inclusive
+ *          end - the last row, inclusive
+ *          rows - the rows to fill, row i at index i - start
+ */
+void fill_connection_rows(Graph* graph, int start, int end, dist_t** rows) {
+    int nodeCount = graph->nodeCount;
+    for (int i = start; i <= end; i++) {
+        // Init to DIST_INF instead of 0 to represent no connection, since
+        // 0 is a valid weight
+        for (int j = 0; j < nodeCount; j++) {
+            if (i == j) {
+                rows[i - start][j] = 0;
+            } else {
+                rows[i - start][j] = DIST_INF;
+            }
+        }
+    }
+
+    for (int e = 0; e < graph->edgeCount; e++) {
+        int from = graph->edgeFrom[e];
+        int to = graph->edgeTo[e];
         // Always 0 distance from node to itself
-        if (from == to) return;
+        if (from == to) continue;
         // Store two-way connection for greater convenience at expense of 
         // approx doubling space required
-        graph->connections[from][to] = weight;
-        graph->connections[to][from] = weight;
+        if (start <= from && from <= end) {
+            rows[from - start][to] = graph->edgeWeights[e];
+        }
+        if (!graph->directed && start <= to && to <= end) {
+            rows[to - start][from] = graph->edgeWeights[e];
+        }
     }
 }
 
+/* Build the packed upper triangle of the connections matrix for some rows.
+ *  Since connections are two-way, only entries j >= i of row i are stored,
+ *  row i starting at offsets[i - start].
+ * Parameters:
+ *          graph - the graph in question
+ *          start - the first row, inclusive
+ *          end - the last row, inclusive
+ *          offsets - out parameter of end - start + 2 entries holding the
+ *                    start of each row, and the total length last
+ * Return:
+ *          The packed rows.
+ */
+dist_t* build_packed_connections(Graph* graph, int start, int end,
+        size_t* offsets) {
+    int nodeCount = graph->nodeCount;
+    offsets[0] = 0;
+    for (int i = start; i <= end; i++) {
+        offsets[i - start + 1] = offsets[i - start] + (nodeCount - i);
+    }
 
+    dist_t* packed = alloc_aligned(offsets[end - start + 1]);
+    for (int i = start; i <= end; i++) {
+        dist_t* row = &packed[offsets[i - start]];
+        // Always 0 distance from node to itself, DIST_INF for no connection
+        row[0] = 0;
+        for (int j = 1; j < nodeCount - i; j++) {
+            row[j] = DIST_INF;
+        }
+    }
+
+    // Later edges overwrite earlier ones, as in the full matrix
+    for (int e = 0; e < graph->edgeCount; e++) {
+        int from = graph->edgeFrom[e];
+        int to = graph->edgeTo[e];
+        if (from == to) continue;
+        int i = from < to ? from : to;
+        int j = from < to ? to : from;
+        if (i < start || i > end) continue;
+        packed[offsets[i - start] + (j - i)] = graph->edgeWeights[e];
+    }
+    return packed;
+}
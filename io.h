@@ -4,14 +4,133 @@
  * =============================================================================
  */
 
+// Text input files are read this many bytes at a time
+#define READ_BLOCK_SIZE (64 * 1024 * 1024)
+
+// Marks a file in the binary graph format
+#define BINARY_GRAPH_MAGIC "CGRAPHB1"
+
+/* Header of the binary graph format.
+ *  Followed by the edge sources, edge targets and edge weights as int arrays,
+ *  then every node label NUL-terminated. Integers are in the byte order of 
+ *  the machine that wrote the file.
+ */
+typedef struct {
+    char magic[8];
+    int nodeCount;
+    int edgeCount;
+    long long labelBytes;
+} BinaryGraphHeader;
+
+// Marks a file in the binary score format
+#define BINARY_SCORES_MAGIC "CSCORES1"
+
+/* Header of the binary score format.
+ *  Followed by columns of nodeCount entries each: the total distance from
+ *  every node as long longs, its eccentricity as long longs, then its
+ *  closeness as doubles, in the byte order of the machine that wrote the
+ *  file. Unreachable totals and eccentricities are LLONG_MAX.
+ */
+typedef struct {
+    char magic[8];
+    int nodeCount;
+    int reserved;
+} BinaryScoresHeader;
+
 /* Read an input file describing a graph and construct that graph.
+ *  Files in the binary graph format are detected and memory-mapped.
  * Parameters:
  *          filename - the path and name of the file
  * Return:
- *          A fully constructed graph.
+ *          A fully constructed graph, or NULL if the file could not be read.
  */
 Graph* read_file(char* filename);
 
+/* Parse an integer, skipping leading spaces and tabs, as atoi would.
+ * Parameters:
+ *          cursor - in/out parameter holding the position to parse from,
+ *                   left just after the integer
+ * Return:
+ *          The integer parsed, 0 if there was none.
+ */
+int parse_int(char** cursor);
+
+/* Parse the edge lines of an input file into a graph's edge arrays.
+ *  The text is split into one chunk per thread at line boundaries. Lines are
+ *  counted per chunk first so each thread knows the index of its first edge,
+ *  then every chunk is parsed in parallel.
+ * Parameters:
+ *          text - the edge lines, followed by a NUL
+ *          length - the number of characters in the edge lines
+ *          graph - the graph being read in, with its edge arrays allocated
+ */
+void parse_edges(char* text, size_t length, Graph* graph);
+
+/* Read a graph on rank 0 and broadcast it to every other rank.
+ *  Binary graphs are memory-mapped by every rank instead, since mapping
+ *  needs no parsing.
+ * Parameters:
+ *          filename - the path and name of the file
+ *          comm - the communicator the ranks share
+ * Return:
+ *          A fully constructed graph, or NULL on every rank if the file could
+ *          not be read.
+ */
+Graph* read_graph(char* filename, MPI_Comm comm);
+
+/* Have every rank give up on a graph that any rank could not read, as when
+ *  one rank cannot map a binary graph the others could.
+ * Parameters:
+ *          graph - the graph this rank read, or NULL if it could not
+ *          comm - the communicator the ranks share
+ * Return:
+ *          The graph, or NULL on every rank if any rank could not read it.
+ */
+Graph* agree_graph(Graph* graph, MPI_Comm comm);
+
+/* Broadcast a graph read on rank 0 to every other rank.
+ * Parameters:
+ *          graph - the graph read in on rank 0, to be filled in elsewhere
+ *          comm - the communicator the ranks share
+ */
+void broadcast_graph(Graph* graph, MPI_Comm comm);
+
+/* Memory-map a file in the binary graph format and construct that graph.
+ *  The edge arrays and labels point straight into the mapping, so ranks on
+ *  the same node share the file's pages rather than each parsing a copy.
+ *  The header, label table and edge endpoints are checked before use.
+ * Parameters:
+ *          filename - the path and name of the file
+ * Return:
+ *          A fully constructed graph, or NULL if the file could not be mapped
+ *          or is not a valid binary graph.
+ */
+Graph* read_binary_file(char* filename);
+
+/* Read how many nodes and edges a graph has, without reading the graph.
+ * Parameters:
+ *          filename - the path and name of the file, text or binary
+ *          nodeCount - out parameter holding the number of nodes
+ *          edgeCount - out parameter holding the number of edges
+ * Return:
+ *          0 if the counts were read, 1 if the file could not be read.
+ */
+int read_graph_size(char* filename, int* nodeCount, int* edgeCount);
+
+/* Free a graph from read_graph or read_shared_graph.
+ *  Edges in a host's shared memory are left for their window to release.
+ * Parameters:
+ *          graph - the graph to be freed
+ */
+void free_graph(Graph* graph);
+
+/* Write a graph in the binary graph format.
+ * Parameters:
+ *          filename - the path and name of the file to write to
+ *          graph - the graph in question
+ */
+void write_binary_file(char* filename, Graph* graph);
+
 /* Write a file containing centres.
  * Parameters:
  *          filename - the path and name of the file to write to
@@ -20,6 +139,52 @@ Graph* read_file(char* filename);
  */
 void write_file(char* filename, ListNode* head, Graph* graph);
 
+/* Write the best nodes by a score to a file, one per line as
+ *  "<index> <name> <score>", best first, after the number of nodes.
+ * Parameters:
+ *          filename - the file being written to
+ *          top - the nodes, best first
+ *          count - the number of nodes
+ *          scores - the score of every node
+ *          graph - the graph in question
+ */
+void write_top_file(char* filename, int* top, int count, long long* scores,
+        Graph* graph);
+
+/* Write every node's scores to a file, one per line as
+ *  "<index> <name> <total> <eccentricity> <closeness>", after the number of
+ *  nodes. Unreachable totals and eccentricities are written as "inf".
+ * Parameters:
+ *          filename - the file being written to
+ *          sums - the total shortest path length from each node
+ *          maxes - the longest shortest path length from each node
+ *          closeness - the closeness of each node
+ *          graph - the graph in question
+ */
+void write_score_file(char* filename, long long* sums, long long* maxes,
+        double* closeness, Graph* graph);
+
+/* Write every node's betweenness to a file, one per line as
+ *  "<index> <name> <betweenness>", after the number of nodes.
+ * Parameters:
+ *          filename - the file being written to
+ *          scores - the betweenness of each node
+ *          graph - the graph in question
+ */
+void write_betweenness_file(char* filename, double* scores, Graph* graph);
+
+/* Write every node's scores to a file in the binary score format, so they
+ *  can be read a column at a time without parsing.
+ * Parameters:
+ *          filename - the file being written to
+ *          sums - the total shortest path length from each node
+ *          maxes - the longest shortest path length from each node
+ *          closeness - the closeness of each node
+ *          nodeCount - the number of nodes
+ */
+void write_binary_scores(char* filename, long long* sums, long long* maxes,
+        double* closeness, int nodeCount);
+
 /* Parse and process a line read from the input file.
  * Parameters:
  *          lineBuffer - the line in question
@@ -28,3 +193,45 @@ void write_file(char* filename, ListNode* head, Graph* graph);
  *          graph - the graph being read in
  */
 void process_line(char* lineBuffer, int line, int length, Graph* graph);
+
+/* Expand the edge list of a graph into its dense connections matrix.
+ * Parameters:
+ *          graph - the graph being initialised
+ */
+void build_connections(Graph* graph);
+
+/* Expand the edge list of a graph into some rows of its dense connections
+ *  matrix, for solvers where each rank only holds its own rows.
+ * Parameters:
+ *          graph - the graph in question
+ *          start - the first row, inclusive
+ *          end - the last row, inclusive
+ * Return:
+ *          The rows, row i at index i - start, to be released with
+ *          free_matrix.
+ */
+dist_t** build_connection_rows(Graph* graph, int start, int end);
+
+/* Fill some rows of the dense connections matrix of a graph in place.
+ * Parameters:
+ *          graph - the graph in question
+ *          start - the first row, inclusive
+ *          end - the last row, inclusive
+ *          rows - the rows to fill, row i at index i - start
+ */
+void fill_connection_rows(Graph* graph, int start, int end, dist_t** rows);
+
+/* Build the packed upper triangle of the connections matrix for some rows.
+ *  Since connections are two-way, only entries j >= i of row i are stored,
+ *  row i starting at offsets[i - start].
+ * Parameters:
+ *          graph - the graph in question
+ *          start - the first row, inclusive
+ *          end - the last row, inclusive
+ *          offsets - out parameter of end - start + 2 entries holding the
+ *                    start of each row, and the total length last
+ * Return:
+ *          The packed rows.
+ */
+dist_t* build_packed_connections(Graph* graph, int start, int end,
+        size_t* offsets);
@@ -0,0 +1,168 @@
+/* =============================================================================
+ * johnson.c    Johnson's algorithm, reweighting graphs with negative edge
+ *              weights so the sparse engine's Dijkstra applies
+ * =============================================================================
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <omp.h>
+#include <mpi.h>
+#include "helper.h"
+#include "sparse.h"
+#include "instrument.h"
+#include "johnson.h"
+
+/* Find potentials that make every edge weight non-negative.
+ *  Bellman-Ford from a virtual source joined to every node by a zero weight
+ *  edge, so every potential starts at 0. Each round relaxes every node's
+ *  incoming edges from the previous round's potentials, nodes being
+ *  partitioned over ranks and threads, then shares the new potentials.
+ * Parameters:
+ *          graph - the graph in question
+ *          comm - the communicator the ranks share
+ * Return:
+ *          The potential of each node, on every rank, or NULL on every rank
+ *          if the graph has a negative cycle.
+ */
+dist_t* bellman_ford_potentials(Graph* graph, MPI_Comm comm) {
+    int rank, size;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &size);
+    int nodeCount = graph->nodeCount;
+
+    // Relaxing by target means each node is only written by its owner, so
+    // build the adjacency of the reversed graph
+    Graph reversed = *graph;
+    reversed.edgeFrom = graph->edgeTo;
+    reversed.edgeTo = graph->edgeFrom;
+    CSRGraph* incoming = build_csr(&reversed);
+
+    int* counts = malloc(size * sizeof(int));
+    int* displs = malloc(size * sizeof(int));
+    for (int r = 0; r < size; r++) {
+        int start, end;
+        set_partition(r, size, nodeCount, &start, &end);
+        displs[r] = start;
+        counts[r] = end - start + 1;
+    }
+    int start = displs[rank];
+    int end = start + counts[rank] - 1;
+
+    dist_t* potentials = calloc(nodeCount, sizeof(dist_t));
+    dist_t* next = calloc(nodeCount, sizeof(dist_t));
+    double com = 0;
+    for (int round = 0; ; round++) {
+        int changed = 0;
+        PHASE_START(PHASE_COMPUTE);
+        #pragma omp parallel for schedule(dynamic, 64) reduction(||:changed)
+        for (int v = start; v <= end; v++) {
+            dist_t best = potentials[v];
+            for (int e = incoming->rowStart[v]; e < incoming->rowStart[v + 1];
+                    e++) {
+                // Potentials are never DIST_INF, every node being one edge
+                // from the virtual source
+                dist_t candidate;
+                if (!checkedDistances) {
+                    candidate = potentials[incoming->neighbours[e]]
+                            + incoming->weights[e];
+                } else if (add_distances(potentials[incoming->neighbours[e]],
+                        incoming->weights[e], &candidate)) {
+                    // Potentials are never positive, so only a negative
+                    // weight can take one out of range, and then below it
+                    if (incoming->weights[e] < 0) mark_distance_overflow();
+                    continue;
+                }
+                if (candidate < best) best = candidate;
+            }
+            next[v] = best;
+            changed = changed || best < potentials[v];
+        }
+        PHASE_STOP(PHASE_COMPUTE);
+
+        PHASE_START(PHASE_EXCHANGE);
+        double _startTime = MPI_Wtime();
+        MPI_Allgatherv(&next[start], counts[rank], MPI_DIST, potentials,
+                counts, displs, MPI_DIST, comm);
+        MPI_Allreduce(MPI_IN_PLACE, &changed, 1, MPI_INT, MPI_LOR, comm);
+        com += MPI_Wtime() - _startTime;
+        PHASE_STOP(PHASE_EXCHANGE);
+        if (!changed) break;
+
+        // Shortest paths from the virtual source have at most |V| - 1 real
+        // edges, so one more improving round means a negative cycle
+        if (round >= nodeCount - 1) {
+            mark_negative_cycle();
+            free(potentials);
+            potentials = NULL;
+            break;
+        }
+    }
+    timings.com = com;
+
+    free(next);
+    free(counts);
+    free(displs);
+    free_csr(incoming);
+    return potentials;
+}
+
+/* Reweight an adjacency by node potentials.
+ *  The weight of each edge (u, v) becomes w + h(u) - h(v), which is
+ *  non-negative for potentials from bellman_ford_potentials.
+ * Parameters:
+ *          csr - the adjacency being reweighted
+ *          potentials - the potential of each node
+ */
+void reweight_csr(CSRGraph* csr, dist_t* potentials) {
+    #pragma omp parallel for schedule(dynamic, 64)
+    for (int u = 0; u < csr->nodeCount; u++) {
+        for (int e = csr->rowStart[u]; e < csr->rowStart[u + 1]; e++) {
+            dist_t shift = potentials[u] - potentials[csr->neighbours[e]];
+            if (!checkedDistances) {
+                csr->weights[e] += shift;
+            } else if (add_distances(csr->weights[e], shift,
+                    &csr->weights[e])) {
+                mark_distance_overflow();
+            }
+        }
+    }
+}
+
+/* Populate matrix of shortest paths between all pairs of nodes.
+ *  Use Johnson's algorithm, for graphs with negative edge weights but no
+ *  negative cycles: reweight with Bellman-Ford potentials, run Dijkstra from
+ *  every source, then undo the reweighting, for O(|V||E|log|V|) time.
+ * Parameters:
+ *          graph - the graph in question
+ *          dynamic - whether ranks claim sources as they go rather than
+ *                    taking an equal share each
+ *          comm - the communicator the ranks share
+ *          sums - if not NULL, out parameter on rank 0 holding the total of
+ *                 each row, gathered in place of the matrix
+ *          maxes - if not NULL, out parameter on rank 0 holding the maximum
+ *                  of each row, gathered in place of the matrix
+ * Return:
+ *          On rank 0, a matrix containing the length of the shortest paths
+ *          between all nodes, or NULL if row summaries were gathered instead.
+ *          NULL on every other rank.
+ *          NULL on every rank if the graph has a negative cycle.
+ */
+dist_t** johnson_all_pair_shortest_path(Graph* graph, int dynamic,
+        MPI_Comm comm, long long* sums, long long* maxes) {
+    dist_t* potentials = bellman_ford_potentials(graph, comm);
+    if (potentials == NULL) return NULL;
+
+    PHASE_START(PHASE_MATRIX_INIT);
+    CSRGraph* csr = build_csr(graph);
+    reweight_csr(csr, potentials);
+    PHASE_STOP(PHASE_MATRIX_INIT);
+
+    dist_t** dist = dynamic
+            ? dynamic_csr_all_pair_shortest_path(csr, potentials, comm, sums,
+                    maxes)
+            : csr_all_pair_shortest_path(csr, potentials, comm, sums, maxes);
+    free_csr(csr);
+    free(potentials);
+    return dist;
+}
@@ -0,0 +1,50 @@
+/* =============================================================================
+ * johnson.h    Johnson's algorithm, reweighting graphs with negative edge
+ *              weights so the sparse engine's Dijkstra applies
+ * =============================================================================
+ */
+
+/* Find potentials that make every edge weight non-negative.
+ *  Bellman-Ford from a virtual source joined to every node by a zero weight
+ *  edge, so every potential starts at 0. Each round relaxes every node's
+ *  incoming edges from the previous round's potentials, nodes being
+ *  partitioned over ranks and threads, then shares the new potentials.
+ * Parameters:
+ *          graph - the graph in question
+ *          comm - the communicator the ranks share
+ * Return:
+ *          The potential of each node, on every rank, or NULL on every rank
+ *          if the graph has a negative cycle.
+ */
+dist_t* bellman_ford_potentials(Graph* graph, MPI_Comm comm);
+
+/* Reweight an adjacency by node potentials.
+ *  The weight of each edge (u, v) becomes w + h(u) - h(v), which is
+ *  non-negative for potentials from bellman_ford_potentials.
+ * Parameters:
+ *          csr - the adjacency being reweighted
+ *          potentials - the potential of each node
+ */
+void reweight_csr(CSRGraph* csr, dist_t* potentials);
+
+/* Populate matrix of shortest paths between all pairs of nodes.
+ *  Use Johnson's algorithm, for graphs with negative edge weights but no
+ *  negative cycles: reweight with Bellman-Ford potentials, run Dijkstra from
+ *  every source, then undo the reweighting, for O(|V||E|log|V|) time.
+ * Parameters:
+ *          graph - the graph in question
+ *          dynamic - whether ranks claim sources as they go rather than
+ *                    taking an equal share each
+ *          comm - the communicator the ranks share
+ *          sums - if not NULL, out parameter on rank 0 holding the total of
+ *                 each row, gathered in place of the matrix
+ *          maxes - if not NULL, out parameter on rank 0 holding the maximum
+ *                  of each row, gathered in place of the matrix
+ * Return:
+ *          On rank 0, a matrix containing the length of the shortest paths
+ *          between all nodes, or NULL if row summaries were gathered instead.
+ *          NULL on every other rank.
+ *          NULL on every rank if the graph has a negative cycle.
+ */
+dist_t** johnson_all_pair_shortest_path(Graph* graph, int dynamic,
+        MPI_Comm comm, long long* sums, long long* maxes);
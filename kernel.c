@@ -0,0 +1,214 @@
+/* =============================================================================
+ * kernel.c     Min-plus row kernels shared by the Floyd-Warshall solvers, with
+ *              SIMD versions selected at startup
+ * =============================================================================
+ */
+#include <limits.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+#include <mpi.h>
+#include "helper.h"
+#include "kernel.h"
+
+void (*min_plus)(dist_t* row, dist_t* kRow, dist_t distIK, int count) = 
+        min_plus_checked;
+
+/* Relax a row through an intermediate node, for any edge weights.
+ *  Branches around DIST_INF entries, so it is safe with negative distances.
+ * Parameters:
+ *          row - the row being relaxed
+ *          kRow - the row of the intermediate node
+ *          distIK - the distance from the row's node to the intermediate node
+ *          count - the number of entries to relax
+ */
+void min_plus_checked(dist_t* row, dist_t* kRow, dist_t distIK, int count) {
+    for (int j = 0; j < count; j++) {
+        // If path through intermediate node exists and is shorter than
+        // direct path or if direct path doesn't exist, use path
+        // through intermediate node
+        if (kRow[j] != DIST_INF && row[j] > distIK + kRow[j]) {
+            row[j] = distIK + kRow[j];
+        }
+    }
+}
+
+/* Relax a row through an intermediate node, for any edge weights, when
+ *  paths may be too long for dist_t.
+ *  As min_plus_checked, but sums that do not fit are never stored. Those
+ *  above the range are left out, as no path that fits is longer, and those
+ *  below it are marked with mark_distance_overflow.
+ * Parameters:
+ *          row - the row being relaxed
+ *          kRow - the row of the intermediate node
+ *          distIK - the distance from the row's node to the intermediate node
+ *          count - the number of entries to relax
+ */
+void min_plus_overflow(dist_t* row, dist_t* kRow, dist_t distIK, int count) {
+    for (int j = 0; j < count; j++) {
+        if (kRow[j] == DIST_INF) continue;
+        dist_t through;
+        if (add_distances(distIK, kRow[j], &through)) {
+            if (distIK < 0 && kRow[j] < 0) mark_distance_overflow();
+            continue;
+        }
+        if (through < row[j]) row[j] = through;
+    }
+}
+
+/* Relax a row through an intermediate node, for non-negative distances.
+ *  DIST_INF is used as infinity, so a saturating add replaces the branches:
+ *  the sum of two non-negative distances fits in a dist_sum_t, and clamping
+ *  it to DIST_INF leaves every path through a missing edge at infinity.
+ * Parameters:
+ *          row - the row being relaxed
+ *          kRow - the row of the intermediate node
+ *          distIK - the distance from the row's node to the intermediate node
+ *          count - the number of entries to relax
+ */
+void min_plus_scalar(dist_t* row, dist_t* kRow, dist_t distIK, int count) {
+    for (int j = 0; j < count; j++) {
+        dist_sum_t through = (dist_sum_t) distIK + (dist_sum_t) kRow[j];
+        through = through < DIST_INF ? through : DIST_INF;
+        row[j] = row[j] < (dist_t) through ? row[j] : (dist_t) through;
+    }
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+/* Relax a row through an intermediate node, for non-negative distances.
+ *  As min_plus_scalar, 32 bytes of entries at a time with AVX2.
+ * Parameters:
+ *          row - the row being relaxed
+ *          kRow - the row of the intermediate node
+ *          distIK - the distance from the row's node to the intermediate node
+ *          count - the number of entries to relax
+ */
+__attribute__((target("avx2")))
+void min_plus_avx2(dist_t* row, dist_t* kRow, dist_t distIK, int count) {
+    int lanes = 32 / sizeof(dist_t);
+    int j = 0;
+#if DIST_BITS == 16
+    // Unsigned saturation stops at DIST_INF by itself
+    __m256i ik = _mm256_set1_epi16(distIK);
+    for (; j + lanes <= count; j += lanes) {
+        __m256i through = _mm256_adds_epu16(ik,
+                _mm256_loadu_si256((__m256i*) &kRow[j]));
+        __m256i current = _mm256_loadu_si256((__m256i*) &row[j]);
+        _mm256_storeu_si256((__m256i*) &row[j],
+                _mm256_min_epu16(current, through));
+    }
+#elif DIST_BITS == 64
+    // There is no 64-bit min before AVX-512, so compare and blend, a sum past
+    // DIST_INF having wrapped negative
+    __m256i ik = _mm256_set1_epi64x(distIK);
+    __m256i infinity = _mm256_set1_epi64x(DIST_INF);
+    __m256i zero = _mm256_setzero_si256();
+    for (; j + lanes <= count; j += lanes) {
+        __m256i through = _mm256_add_epi64(ik,
+                _mm256_loadu_si256((__m256i*) &kRow[j]));
+        through = _mm256_blendv_epi8(through, infinity,
+                _mm256_cmpgt_epi64(zero, through));
+        __m256i current = _mm256_loadu_si256((__m256i*) &row[j]);
+        _mm256_storeu_si256((__m256i*) &row[j], _mm256_blendv_epi8(current,
+                through, _mm256_cmpgt_epi64(current, through)));
+    }
+#else
+    __m256i ik = _mm256_set1_epi32(distIK);
+    __m256i infinity = _mm256_set1_epi32(DIST_INF);
+    for (; j + lanes <= count; j += lanes) {
+        __m256i through = _mm256_add_epi32(ik,
+                _mm256_loadu_si256((__m256i*) &kRow[j]));
+        through = _mm256_min_epu32(through, infinity);
+        __m256i current = _mm256_loadu_si256((__m256i*) &row[j]);
+        _mm256_storeu_si256((__m256i*) &row[j],
+                _mm256_min_epi32(current, through));
+    }
+#endif
+    min_plus_scalar(&row[j], &kRow[j], distIK, count - j);
+}
+
+/* Relax a row through an intermediate node, for non-negative distances.
+ *  As min_plus_scalar, 64 bytes of entries at a time with AVX-512.
+ * Parameters:
+ *          row - the row being relaxed
+ *          kRow - the row of the intermediate node
+ *          distIK - the distance from the row's node to the intermediate node
+ *          count - the number of entries to relax
+ */
+#if DIST_BITS == 16
+__attribute__((target("avx512bw")))
+#else
+__attribute__((target("avx512f")))
+#endif
+void min_plus_avx512(dist_t* row, dist_t* kRow, dist_t distIK, int count) {
+    int lanes = 64 / sizeof(dist_t);
+    int j = 0;
+#if DIST_BITS == 16
+    __m512i ik = _mm512_set1_epi16(distIK);
+    for (; j + lanes <= count; j += lanes) {
+        __m512i through = _mm512_adds_epu16(ik,
+                _mm512_loadu_si512(&kRow[j]));
+        __m512i current = _mm512_loadu_si512(&row[j]);
+        _mm512_storeu_si512(&row[j], _mm512_min_epu16(current, through));
+    }
+#elif DIST_BITS == 64
+    __m512i ik = _mm512_set1_epi64(distIK);
+    __m512i infinity = _mm512_set1_epi64(DIST_INF);
+    for (; j + lanes <= count; j += lanes) {
+        __m512i through = _mm512_add_epi64(ik,
+                _mm512_loadu_si512(&kRow[j]));
+        through = _mm512_min_epu64(through, infinity);
+        __m512i current = _mm512_loadu_si512(&row[j]);
+        _mm512_storeu_si512(&row[j], _mm512_min_epi64(current, through));
+    }
+#else
+    __m512i ik = _mm512_set1_epi32(distIK);
+    __m512i infinity = _mm512_set1_epi32(DIST_INF);
+    for (; j + lanes <= count; j += lanes) {
+        __m512i through = _mm512_add_epi32(ik,
+                _mm512_loadu_si512(&kRow[j]));
+        through = _mm512_min_epu32(through, infinity);
+        __m512i current = _mm512_loadu_si512(&row[j]);
+        _mm512_storeu_si512(&row[j], _mm512_min_epi32(current, through));
+    }
+#endif
+    min_plus_scalar(&row[j], &kRow[j], distIK, count - j);
+}
+#else
+void min_plus_avx2(dist_t* row, dist_t* kRow, dist_t distIK, int count) {
+    min_plus_scalar(row, kRow, distIK, count);
+}
+
+void min_plus_avx512(dist_t* row, dist_t* kRow, dist_t distIK, int count) {
+    min_plus_scalar(row, kRow, distIK, count);
+}
+#endif
+
+/* Choose the min-plus kernel for this graph and CPU.
+ * Parameters:
+ *          negativeWeights - whether any edge weight is negative, which rules
+ *                            out the saturating kernels
+ */
+void select_min_plus_kernel(int negativeWeights) {
+    if (negativeWeights) {
+        min_plus = checkedDistances ? min_plus_overflow : min_plus_checked;
+        return;
+    }
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_cpu_init();
+    // 16-bit lanes need the byte and word extension of AVX-512
+#if DIST_BITS == 16
+    if (__builtin_cpu_supports("avx512bw")) {
+#else
+    if (__builtin_cpu_supports("avx512f")) {
+#endif
+        min_plus = min_plus_avx512;
+        return;
+    }
+    if (__builtin_cpu_supports("avx2")) {
+        min_plus = min_plus_avx2;
+        return;
+    }
+#endif
+    min_plus = min_plus_scalar;
+}
@@ -0,0 +1,86 @@
+/* =============================================================================
+ * kernel.h     Min-plus row kernels shared by the Floyd-Warshall solvers, with
+ *              SIMD versions selected at startup
+ * =============================================================================
+ */
+
+// Wide enough to add two non-negative distances without wrapping
+#if DIST_BITS == 64
+typedef unsigned long long dist_sum_t;
+#else
+typedef unsigned int dist_sum_t;
+#endif
+
+/* Relax a row through an intermediate node.
+ *  That is, row[j] = min(row[j], distIK + kRow[j]) for each j. Set by
+ *  select_min_plus_kernel.
+ * Parameters:
+ *          row - the row being relaxed
+ *          kRow - the row of the intermediate node
+ *          distIK - the distance from the row's node to the intermediate node,
+ *                   not DIST_INF
+ *          count - the number of entries to relax
+ */
+extern void (*min_plus)(dist_t* row, dist_t* kRow, dist_t distIK, int count);
+
+/* Relax a row through an intermediate node, for any edge weights.
+ *  Branches around DIST_INF entries, so it is safe with negative distances.
+ * Parameters:
+ *          row - the row being relaxed
+ *          kRow - the row of the intermediate node
+ *          distIK - the distance from the row's node to the intermediate node
+ *          count - the number of entries to relax
+ */
+void min_plus_checked(dist_t* row, dist_t* kRow, dist_t distIK, int count);
+
+/* Relax a row through an intermediate node, for any edge weights, when
+ *  paths may be too long for dist_t.
+ *  As min_plus_checked, but sums that do not fit are never stored. Those
+ *  above the range are left out, as no path that fits is longer, and those
+ *  below it are marked with mark_distance_overflow.
+ * Parameters:
+ *          row - the row being relaxed
+ *          kRow - the row of the intermediate node
+ *          distIK - the distance from the row's node to the intermediate node
+ *          count - the number of entries to relax
+ */
+void min_plus_overflow(dist_t* row, dist_t* kRow, dist_t distIK, int count);
+
+/* Relax a row through an intermediate node, for non-negative distances.
+ *  DIST_INF is used as infinity, so a saturating add replaces the branches:
+ *  the sum of two non-negative distances fits in a dist_sum_t, and clamping
+ *  it to DIST_INF leaves every path through a missing edge at infinity.
+ * Parameters:
+ *          row - the row being relaxed
+ *          kRow - the row of the intermediate node
+ *          distIK - the distance from the row's node to the intermediate node
+ *          count - the number of entries to relax
+ */
+void min_plus_scalar(dist_t* row, dist_t* kRow, dist_t distIK, int count);
+
+/* Relax a row through an intermediate node, for non-negative distances.
+ *  As min_plus_scalar, 32 bytes of entries at a time with AVX2.
+ * Parameters:
+ *          row - the row being relaxed
+ *          kRow - the row of the intermediate node
+ *          distIK - the distance from the row's node to the intermediate node
+ *          count - the number of entries to relax
+ */
+void min_plus_avx2(dist_t* row, dist_t* kRow, dist_t distIK, int count);
+
+/* Relax a row through an intermediate node, for non-negative distances.
+ *  As min_plus_scalar, 64 bytes of entries at a time with AVX-512.
+ * Parameters:
+ *          row - the row being relaxed
+ *          kRow - the row of the intermediate node
+ *          distIK - the distance from the row's node to the intermediate node
+ *          count - the number of entries to relax
+ */
+void min_plus_avx512(dist_t* row, dist_t* kRow, dist_t distIK, int count);
+
+/* Choose the min-plus kernel for this graph and CPU.
+ * Parameters:
+ *          negativeWeights - whether any edge weight is negative, which rules
+ *                            out the saturating kernels
+ */
+void select_min_plus_kernel(int negativeWeights);
@@ -6,225 +6,1709 @@
 #include <string.h>
 #include <stdlib.h>
 #include <limits.h>
+#include <stdint.h>
+#include <malloc.h>
 #include <omp.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <sys/resource.h>
 #include <mpi.h>
 #include "helper.h"
 #include "io.h"
+#include "blocked.h"
+#include "sparse.h"
+#include "kernel.h"
+#include "symmetric.h"
+#include "johnson.h"
+#include "bfs.h"
+#include "betweenness.h"
+#include "components.h"
+#include "approximate.h"
+#include "eccentricity.h"
+#include "incremental.h"
+#include "outofcore.h"
+#include "balance.h"
+#include "shared.h"
+#include "checkpoint.h"
+#include "instrument.h"
 
-int rank, size;
-MPI_Comm comm = MPI_COMM_WORLD;
+// Tile width giving three int tiles well inside a typical L2 cache
+#define DEFAULT_BLOCK_SIZE 64
+
+/* Options from the command line that apply to every graph solved.
+ */
+typedef struct {
+    char* algorithm;
+    int blockSize;
+    int stream;
+    int directed;
+    char* checkpointDir;
+    int checkpointEvery;
+    double checkpointSeconds;
+    int resume;
+    char* outOfCoreDir;
+    int dynamic;
+    int nodeShared;
+    int showTimings;
+    char* reportFile;
+    int samples;
+    double error;
+    int minMaxOnly;
+    char* updateFile;
+    int top;
+    int scores;
+    int betweenness;
+    int betweennessSamples;
+    int batch;
+} Options;
+
+/* Relax one row of the distance matrix through an intermediate node.
+ *  A negative cycle through the row's node shows up on the diagonal, so it
+ *  is checked once the whole row is relaxed rather than for every entry.
+ * Parameters:
+ *          row - the row being relaxed
+ *          kRow - the row of the intermediate node
+ *          i - the index of the row being relaxed
+ *          k - the index of the intermediate node
+ *          nodeCount - the length of each row
+ */
+void relax_row(dist_t* row, dist_t* kRow, int i, int k, int nodeCount) {
+    // Extract loop invariant access
+    dist_t distIK = row[k];
+    // No path through intermediate node, so nothing to relax
+    if (distIK == DIST_INF) return;
+    // Skipping the lower half was causing problems, and would make 
+    // dividing the workload for parallelisation harder, so I got
+    // rid of it for now. This means approx doubling the runtime.
+    min_plus(row, kRow, distIK, nodeCount);
+    if (row[i] < 0) mark_negative_cycle();
+}
 
 /* Populate matrix of shortest paths between all pairs of nodes.
  *  Use Floyd-Warshall algorithm for O(|V|^3) time with simple implementation.
  * Parameters:
  *          graph - the graph in question
+ *          comm - the communicator the ranks share
+ *          sums - if not NULL, out parameter on rank 0 holding the total of
+ *                 each row, gathered in place of the matrix
+ *          maxes - if not NULL, out parameter on rank 0 holding the maximum
+ *                  of each row, gathered in place of the matrix
+ *          checkpoint - if not NULL, where this rank's rows are periodically
+ *                       saved, and resumed from if requested
+ *          dynamic - whether rows move between ranks in proportion to the
+ *                    throughput each is measured at, every BALANCE_INTERVAL
+ *                    iterations
  * Return:
- *          A matrix containing the length of the shortest paths
- *          between all nodes.
+ *          On rank 0, a matrix containing the length of the shortest paths
+ *          between all nodes, or NULL if row summaries were gathered instead.
+ *          NULL on every other rank.
  */
-int** all_pair_shortest_path(Graph* graph) {
-    // Partition by rows since C is row-major.
-    int start, end;
-    set_partition(rank, size, graph->nodeCount, &start, &end);
+dist_t** all_pair_shortest_path(Graph* graph, MPI_Comm comm,
+        long long* sums, long long* maxes, Checkpoint* checkpoint,
+        int dynamic) {
+    int rank, size;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &size);
+    // Partition by rows since C is row-major. Ranks start with equal shares,
+    // which only change when balancing dynamically.
+    int* bounds = malloc((size + 1) * sizeof(int));
+    int* newBounds = malloc((size + 1) * sizeof(int));
+    for (int r = 0; r < size; r++) {
+        int rankEnd;
+        set_partition(r, size, graph->nodeCount, &bounds[r], &rankEnd);
+    }
+    bounds[size] = graph->nodeCount;
+    int start = bounds[rank];
+    int end = bounds[rank + 1] - 1;
 
-    // Use full matrix instead of half for simpler access
-    // RAM use isn't the bottleneck in any case
-    int** dist = malloc(graph->nodeCount * sizeof(int*));
-    for (int i = 0; i < graph->nodeCount; i++) {
-        dist[i] = malloc(graph->nodeCount * sizeof(int));
-        for (int j = 0; j < graph->nodeCount; j++) {
-            dist[i][j] = graph->connections[i][j];
-        }
+    // Each rank only holds its own rows, and the k rows as they are shared,
+    // so the matrix is spread over the ranks rather than copied to each
+    PHASE_START(PHASE_MATRIX_INIT);
+    dist_t** ownRows = build_connection_rows(graph, start, end);
+    dist_t** dist = calloc(graph->nodeCount, sizeof(dist_t*));
+    for (int i = start; i <= end; i++) {
+        dist[i] = ownRows[i - start];
+    }
+    PHASE_STOP(PHASE_MATRIX_INIT);
+    // Rows relaxed through every k before the checkpoint's pick up from there
+    int startK = 0;
+    if (checkpoint != NULL && checkpoint->resume) {
+        PHASE_START(PHASE_CHECKPOINT);
+        startK = checkpoint_load(checkpoint, dist, comm);
+        PHASE_STOP(PHASE_CHECKPOINT);
     }
 
     double startTime = MPI_Wtime();
     double com = 0;
-    // Loop over each intermediate node
-    for (int k = 0; k < graph->nodeCount; k++) {
-        double _startTime = MPI_Wtime();
-        if (size > 1) {
-            // Synchronize k-th row and column, since we'll be querying it.
-            MPI_Bcast(dist[k], graph->nodeCount, MPI_INT, 
-                    get_partition(k, size, graph->nodeCount), comm);
-            for (int i = 0; i < size; i++) {
-                int otherStart, otherEnd;
-                set_partition(i, size, graph->nodeCount, &otherStart, &otherEnd);
-                // Create single buffer containing i-th node's piece of the 
-                // column, for single broadcast as opposed to many 
-                int* kCol = malloc((otherEnd - otherStart + 1) * sizeof(int));
-                for (int j = otherStart, c=0; j <= otherEnd; j++, c++) {
-                    kCol[c] = dist[j][k];
+    // Each rank only reads column k within its own rows, so only row k needs
+    // sharing. It is double-buffered so that row k+1 can be broadcast while
+    // iteration k is computing.
+    dist_t** kRows = NULL;
+    MPI_Request request = MPI_REQUEST_NULL;
+    if (size > 1 && startK < graph->nodeCount) {
+        kRows = alloc_matrix(2, graph->nodeCount);
+        int owner = bound_owner(bounds, size, startK);
+        if (rank == owner) {
+            memcpy(kRows[startK % 2], dist[startK], 
+                    graph->nodeCount * sizeof(dist_t));
+        }
+        MPI_Ibcast(kRows[startK % 2], graph->nodeCount, MPI_DIST, owner, comm,
+                &request);
+    }
+
+    // One parallel region spans every k, with the rows of this rank's
+    // partition shared between threads. MPI is funneled through the master
+    // thread while the others wait at the barrier.
+    dist_t* kRow = NULL;
+    int nextDone = -1;
+    // Time spent relaxing rows since the last rebalance, measuring this
+    // rank's throughput
+    double busy = 0;
+    double relaxStart = 0;
+    #pragma omp parallel
+    {
+        // Loop over each intermediate node
+        for (int k = startK; k < graph->nodeCount; k++) {
+            #pragma omp master
+            {
+                // Iteration k-1 ends at the barrier closing its loop, so its
+                // compute time includes waiting on the slowest thread
+                PHASE_STOP(PHASE_COMPUTE);
+                if (k > startK) busy += MPI_Wtime() - relaxStart;
+                // Every row is relaxed through k-1 here, the row pre-relaxed
+                // for k included, so the snapshot is consistent
+                if (checkpoint != NULL && checkpoint_due(checkpoint, k, comm)) {
+                    PHASE_START(PHASE_CHECKPOINT);
+                    checkpoint_save(checkpoint, dist, k);
+                    PHASE_STOP(PHASE_CHECKPOINT);
                 }
-                MPI_Bcast(kCol, otherEnd - otherStart + 1, MPI_INT, i, comm);
-                for (int j = otherStart, c=0; j <= otherEnd; j++, c++) {
-                    dist[j][k] = kCol[c];
+                PHASE_START(PHASE_EXCHANGE);
+                kRow = dist[k];
+                nextDone = -1;
+                if (size > 1) {
+                    double _startTime = MPI_Wtime();
+                    MPI_Wait(&request, MPI_STATUS_IGNORE);
+                    kRow = kRows[k % 2];
+                    // Rows can move now, as every row is relaxed through
+                    // k-1 and none yet through k
+                    if (dynamic && k > startK
+                            && (k - startK) % BALANCE_INTERVAL == 0) {
+                        if (rebalance_bounds(busy, bounds, newBounds,
+                                graph->nodeCount, comm)) {
+                            migrate_rows(dist, &ownRows, bounds, newBounds,
+                                    graph->nodeCount, comm);
+                            start = bounds[rank];
+                            end = bounds[rank + 1] - 1;
+                        }
+                        busy = 0;
+                    }
+                    if (k + 1 < graph->nodeCount) {
+                        // Finish row k+1 first so it is in flight during 
+                        // iteration k
+                        int nextOwner = bound_owner(bounds, size, k + 1);
+                        dist_t* nextRow = kRows[(k + 1) % 2];
+                        if (rank == nextOwner) {
+                            relax_row(dist[k + 1], kRow, k + 1, k, 
+                                    graph->nodeCount);
+                            memcpy(nextRow, dist[k + 1], 
+                                    graph->nodeCount * sizeof(dist_t));
+                            nextDone = k + 1;
+                        }
+                        MPI_Ibcast(nextRow, graph->nodeCount, MPI_DIST, 
+                                nextOwner, comm, &request);
+                    }
+                    com += MPI_Wtime() - _startTime;
                 }
-                free(kCol);
+                PHASE_STOP(PHASE_EXCHANGE);
+                PHASE_START(PHASE_COMPUTE);
+                relaxStart = MPI_Wtime();
             }
-        }
-        com += MPI_Wtime() - _startTime;
+            #pragma omp barrier
 
-        // Loop over each pair of nodes
-        for (int i = start; i <= end; i++) {
-            // Extract loop invariant access
-            int distIK = dist[i][k];
-            // Skipping the lower half was causing problems, and would make 
-            // dividing the workload for parallelisation harder, so I got
-            // rid of it for now. This means approx doubling the runtime.
-            #pragma omp parallel for
-            for (int j = 0; j < graph->nodeCount; j++) {
-                // If path through intermediate node exists and is shorter than 
-                // direct path or if direct path doesn't exist, use path 
-                // through intermediate node
-                // Check if path exists and short-circuit otherwise
-                if (distIK != INT_MAX && dist[k][j] != INT_MAX 
-                        && dist[i][j] > distIK + dist[k][j]) {
-                    if (i == j && distIK + dist[k][j] < 0) {
-                        printf("Negative cycle detected, min path undefined\n");
-                        exit(1); 
-                    }
-                    dist[i][j] = distIK + dist[k][j];
+            // Loop over each pair of nodes, the implicit barrier at the end 
+            // keeping every thread on the same k
+            #pragma omp for schedule(static)
+            for (int i = start; i <= end; i++) {
+                if (i == nextDone) continue;
+                relax_row(dist[i], kRow, i, k, graph->nodeCount);
+                if (size > 1 && omp_get_thread_num() == 0) {
+                    // Give the MPI progress engine a chance to move the 
+                    // broadcast
+                    int flag;
+                    MPI_Test(&request, &flag, MPI_STATUS_IGNORE);
                 }
             }
         }
     }
+    PHASE_STOP(PHASE_COMPUTE);
+    if (kRows != NULL) free_matrix(kRows);
+    if (checkpoint != NULL) checkpoint_finish(checkpoint);
+    timings.com = com;
 
+    PHASE_START(PHASE_GATHER);
     startTime = MPI_Wtime();
+    if (sums != NULL) {
+        // Rows are final, so reduce them where they are and only gather
+        // their totals and maxima
+        long long* localSums = malloc((end - start + 1) * sizeof(long long));
+        long long* localMaxes = malloc((end - start + 1) * sizeof(long long));
+        #pragma omp parallel for
+        for (int i = start; i <= end; i++) {
+            summarise_row(dist[i], graph->nodeCount, &localSums[i - start],
+                    &localMaxes[i - start]);
+        }
+        gather_bounded_summaries(localSums, localMaxes, sums, maxes, bounds,
+                comm);
+        free(localSums);
+        free(localMaxes);
+        free_matrix(ownRows);
+        free(dist);
+        free(bounds);
+        free(newBounds);
+        timings.gather = MPI_Wtime() - startTime;
+        PHASE_STOP(PHASE_GATHER);
+        return NULL;
+    }
+
     // Collect on rank 0 only since we only need to process once.
+    free(bounds);
+    free(newBounds);
+    dist_t** result = NULL;
     if (size == 1) {
-        printf("%f,", com);
-        return dist;
-    }
-    if (rank == 0) {
-        for (int i = end+1; i < graph->nodeCount; i++) {
-            MPI_Recv(dist[i], graph->nodeCount, MPI_INT, MPI_ANY_SOURCE, i, 
-                    comm, NULL);
+        // A single rank's own rows are already the whole matrix
+        result = ownRows;
+    } else if (rank == 0) {
+        // Rows may have moved, so rank 0's own are not necessarily first
+        result = alloc_matrix(graph->nodeCount, graph->nodeCount);
+        for (int i = 0; i < graph->nodeCount; i++) {
+            if (start <= i && i <= end) {
+                memcpy(result[i], dist[i], graph->nodeCount * sizeof(dist_t));
+            } else {
+                MPI_Recv(result[i], graph->nodeCount, MPI_DIST,
+                        MPI_ANY_SOURCE, i, comm, MPI_STATUS_IGNORE);
+            }
         }
-        printf("%f,", com);
+        free_matrix(ownRows);
     } else {
         for (int i = start; i <= end; i++) {
-            MPI_Send(dist[i], graph->nodeCount, MPI_INT, 0, i, comm);
+            MPI_Send(dist[i], graph->nodeCount, MPI_DIST, 0, i, comm);
         }
+        free_matrix(ownRows);
     }
+    free(dist);
+    timings.gather = MPI_Wtime() - startTime;
+    PHASE_STOP(PHASE_GATHER);
 
-    return dist;
+    return result;
+}
+
+/* Populate matrix of shortest paths between all pairs of nodes, with the
+ *  rows of each host in memory shared by its ranks.
+ *  Use Floyd-Warshall as all_pair_shortest_path does, but with rows split
+ *  between hosts, then between the ranks of each host. Only the first rank
+ *  of each host takes part in sharing row k, into a buffer the rest of its
+ *  host reads, and the ranks of a host keep in step with barriers.
+ * Parameters:
+ *          graph - the graph in question
+ *          comm - the communicator the ranks share
+ *          hostComm - the ranks on this rank's host
+ *          leaderComm - the first rank of every host, MPI_COMM_NULL elsewhere
+ *          sums - if not NULL, out parameter on rank 0 holding the total of
+ *                 each row, gathered in place of the matrix
+ *          maxes - if not NULL, out parameter on rank 0 holding the maximum
+ *                  of each row, gathered in place of the matrix
+ * Return:
+ *          On rank 0, a matrix containing the length of the shortest paths
+ *          between all nodes, or NULL if row summaries were gathered instead.
+ *          NULL on every other rank.
+ */
+dist_t** host_all_pair_shortest_path(Graph* graph, MPI_Comm comm,
+        MPI_Comm hostComm, MPI_Comm leaderComm, long long* sums,
+        long long* maxes) {
+    int nodeCount = graph->nodeCount;
+    int rank;
+    MPI_Comm_rank(comm, &rank);
+    int hostRank, hostSize;
+    MPI_Comm_rank(hostComm, &hostRank);
+    MPI_Comm_size(hostComm, &hostSize);
+    // This host's rows, the number of hosts and this host's index
+    int hostInfo[4];
+    if (leaderComm != MPI_COMM_NULL) {
+        MPI_Comm_size(leaderComm, &hostInfo[2]);
+        MPI_Comm_rank(leaderComm, &hostInfo[3]);
+        set_partition(hostInfo[3], hostInfo[2], nodeCount, &hostInfo[0],
+                &hostInfo[1]);
+    }
+    MPI_Bcast(hostInfo, 4, MPI_INT, 0, hostComm);
+    int hostStart = hostInfo[0];
+    int hostEnd = hostInfo[1];
+    int hostCount = hostInfo[2];
+    int hostIndex = hostInfo[3];
+    int start, end;
+    set_partition(hostRank, hostSize, hostEnd - hostStart + 1, &start, &end);
+    start += hostStart;
+    end += hostStart;
+
+    PHASE_START(PHASE_MATRIX_INIT);
+    // The host's rows, then a buffer for row k when another host holds it
+    size_t stride = matrix_stride(nodeCount);
+    MPI_Win window;
+    dist_t* hostRows = alloc_host_shared((hostEnd - hostStart + 2) * stride
+            * sizeof(dist_t), hostComm, &window);
+    dist_t* kBuffer = &hostRows[(hostEnd - hostStart + 1) * stride];
+    dist_t** dist = calloc(nodeCount, sizeof(dist_t*));
+    for (int i = hostStart; i <= hostEnd; i++) {
+        dist[i] = &hostRows[(i - hostStart) * stride];
+    }
+    fill_connection_rows(graph, start, end, &dist[start]);
+    host_sync(window, hostComm);
+    PHASE_STOP(PHASE_MATRIX_INIT);
+
+    double com = 0;
+    dist_t* kRow = NULL;
+    #pragma omp parallel
+    {
+        for (int k = 0; k < nodeCount; k++) {
+            #pragma omp master
+            {
+                PHASE_STOP(PHASE_COMPUTE);
+                PHASE_START(PHASE_EXCHANGE);
+                double _startTime = MPI_Wtime();
+                // The host is done with k-1, so row k is final and nobody
+                // still reads the buffer
+                host_sync(window, hostComm);
+                int owner = get_partition(k, hostCount, nodeCount);
+                kRow = owner == hostIndex ? dist[k] : kBuffer;
+                if (hostCount > 1) {
+                    if (leaderComm != MPI_COMM_NULL) {
+                        MPI_Bcast(kRow, nodeCount, MPI_DIST, owner,
+                                leaderComm);
+                    }
+                    host_sync(window, hostComm);
+                }
+                com += MPI_Wtime() - _startTime;
+                PHASE_STOP(PHASE_EXCHANGE);
+                PHASE_START(PHASE_COMPUTE);
+            }
+            #pragma omp barrier
+
+            #pragma omp for schedule(static)
+            for (int i = start; i <= end; i++) {
+                relax_row(dist[i], kRow, i, k, nodeCount);
+            }
+        }
+    }
+    PHASE_STOP(PHASE_COMPUTE);
+    host_sync(window, hostComm);
+    timings.com = com;
+
+    PHASE_START(PHASE_GATHER);
+    double startTime = MPI_Wtime();
+    dist_t** result = NULL;
+    if (sums != NULL) {
+        // Rows are split by host first, so their summaries are reduced
+        // rather than gathered in order of rank
+        long long* partialSums = calloc(nodeCount, sizeof(long long));
+        long long* partialMaxes = calloc(nodeCount, sizeof(long long));
+        #pragma omp parallel for
+        for (int i = start; i <= end; i++) {
+            summarise_row(dist[i], nodeCount, &partialSums[i],
+                    &partialMaxes[i]);
+        }
+        reduce_partial_summaries(partialSums, partialMaxes, sums, maxes,
+                nodeCount, comm);
+        free(partialSums);
+        free(partialMaxes);
+    } else if (rank == 0) {
+        // Collect on rank 0 only, whose host's rows are already to hand
+        result = alloc_matrix(nodeCount, nodeCount);
+        for (int i = 0; i < nodeCount; i++) {
+            if (hostStart <= i && i <= hostEnd) {
+                memcpy(result[i], dist[i], nodeCount * sizeof(dist_t));
+            } else {
+                MPI_Recv(result[i], nodeCount, MPI_DIST, MPI_ANY_SOURCE, i,
+                        comm, MPI_STATUS_IGNORE);
+            }
+        }
+    } else if (leaderComm != MPI_COMM_NULL) {
+        for (int i = hostStart; i <= hostEnd; i++) {
+            MPI_Send(dist[i], nodeCount, MPI_DIST, 0, i, comm);
+        }
+    }
+    free(dist);
+    free_host_shared(window);
+    timings.gather = MPI_Wtime() - startTime;
+    PHASE_STOP(PHASE_GATHER);
+
+    return result;
 }
 
 /* Find the centre of the graph defined by closeness.
  *  That is, find the node(s) such that the sum of shortest paths to every other
  *  node is minimised.
  * Parameters:
+ *          sums - the total shortest path length from each node
  *          graph - the graph in question
  * Return:
- *          The id of the centre node.
+ *          The id of the centre node, or NULL if the graph is disconnected.
  */
-ListNode* min_total_centres(int** dist, Graph* graph) {
-    int champ = INT_MAX;
-    ListNode* centres = malloc(sizeof(ListNode));
-    centres->next = NULL;
-    // Iterate backwards so that list is in appearance order
-    for (int i = graph->nodeCount - 1; i >= 0; i--) {
-        int sum = 0;
-        // Sum over row of pairwise distance matrix to get total distance
-        for (int j = 0; j < graph->nodeCount; j++) {
-            if (dist[i][j] == INT_MAX) {
-                printf("Disconnected subgraph detected, solution undefined\n");
-                exit(1); 
-            }
-            sum += dist[i][j];
-        } 
-        if (sum < champ) {
-            champ = sum;
-            centres->value = i;
-            centres->length = 1;
-            // Clear linked list
-            if (centres->next != NULL) {
-                free_list(centres->next);
-                centres->next = NULL;
-            }
-        } else if (sum == champ) {
-            // Append at head of linked list
-            ListNode* next = malloc(sizeof(ListNode));
-            next->value = i;
-            next->next = centres;
-            next->length = centres->length + 1;
-            centres = next;
+ListNode* min_total_centres(long long* sums, Graph* graph) {
+    for (int i = 0; i < graph->nodeCount; i++) {
+        if (sums[i] == LLONG_MAX) {
+            printf("Disconnected subgraph detected, solution undefined\n");
+            return NULL;
         }
     }
-    return centres; 
+    return min_centres(sums, graph->nodeCount);
 }
 
 /* Find the centre of the graph defined by minimum maximum distance.
  *  That is, find the node(s) such that the longest distance to any other node 
  *  (along the shortest path) is minimised.
  * Parameters:
+ *          maxes - the longest shortest path length from each node
  *          graph - the graph in question
  * Return:
  *          The id of the centre node.
  */
-ListNode* min_max_centres(int** dist, Graph* graph) {
-    int champ = INT_MAX;
-    ListNode* centres = malloc(sizeof(ListNode));
-    centres->next = NULL;
-    // Iterate backwards so that list is in appearance order
-    for (int i = graph->nodeCount - 1; i >= 0; i--) {
-        // Take max of row of pairwise distance matrix to get largest distance
-        int maxDistance = max_val(dist[i], graph->nodeCount);
-        if (maxDistance < champ) {
-            champ = maxDistance;
-            centres->value = i;
-            centres->length = 1;
-            // Clear linked list
-            if (centres->next != NULL) {
-                free_list(centres->next);
-                centres->next = NULL;
+ListNode* min_max_centres(long long* maxes, Graph* graph) {
+    return min_centres(maxes, graph->nodeCount);
+}
+
+/* Find the closeness of every node, the number of other nodes it reaches
+ *  over its total distance to them. Only nodes of its own component count.
+ * Parameters:
+ *          sums - the total shortest path length from each node
+ *          graph - the graph in question
+ *          components - the components of the graph, or NULL if connected
+ * Return:
+ *          The closeness of each node, 0 for nodes that reach no other or
+ *          fail to reach some.
+ */
+double* closeness_scores(long long* sums, Graph* graph,
+        Components* components) {
+    double* closeness = malloc(graph->nodeCount * sizeof(double));
+    #pragma omp parallel for
+    for (int i = 0; i < graph->nodeCount; i++) {
+        int c = components != NULL ? components->labels[i] : 0;
+        int others = components != NULL ? components->start[c + 1] 
+                - components->start[c] - 1 : graph->nodeCount - 1;
+        closeness[i] = sums[i] == LLONG_MAX || others == 0 ? 0 
+                : others / (double) sums[i];
+    }
+    return closeness;
+}
+
+/* Write the best nodes by total and by maximum distance, and every node's
+ *  scores, to files named after the graph file.
+ * Parameters:
+ *          filename - the path and name of the graph file
+ *          sums - the total shortest path length from each node
+ *          maxes - the longest shortest path length from each node
+ *          graph - the graph in question
+ *          components - the components of the graph, or NULL if connected
+ *          top - how many of the best nodes to write by each score, 0 for
+ *                none
+ *          scores - whether to write every node's scores, as text and in the
+ *                   binary score format
+ */
+void write_node_scores(char* filename, long long* sums, long long* maxes,
+        Graph* graph, Components* components, int top, int scores) {
+    char* outFilename = malloc((strlen(filename) + 20) * sizeof(char));
+    if (top > 0) {
+        int* best = malloc(top * sizeof(int));
+        int count = top_ids(sums, graph->nodeCount, top, best);
+        sprintf(outFilename, "%s-top_total", filename);
+        write_top_file(outFilename, best, count, sums, graph);
+        count = top_ids(maxes, graph->nodeCount, top, best);
+        sprintf(outFilename, "%s-top_max", filename);
+        write_top_file(outFilename, best, count, maxes, graph);
+        free(best);
+    }
+    if (scores) {
+        double* closeness = closeness_scores(sums, graph, components);
+        sprintf(outFilename, "%s-scores", filename);
+        write_score_file(outFilename, sums, maxes, closeness, graph);
+        sprintf(outFilename, "%s-scores.bin", filename);
+        write_binary_scores(outFilename, sums, maxes, closeness,
+                graph->nodeCount);
+        free(closeness);
+    }
+    free(outFilename);
+}
+
+/* Check whether a path was too long for dist_t, once every row is summarised.
+ *  Paths that do not fit are left out as they are found, so one that was
+ *  needed shows as a node its row cannot reach, though a search over the
+ *  edges does. Rows that truly cannot reach every node of their component
+ *  are left for the centres to report.
+ * Parameters:
+ *          sums - the total shortest path length from each node
+ *          graph - the graph in question
+ *          components - the components of the graph, or NULL if connected
+ * Return:
+ *          1 if a path was too long, 0 otherwise.
+ */
+int unreached_paths(long long* sums, Graph* graph, Components* components) {
+    CSRGraph* csr = NULL;
+    int overflow = 0;
+    // In a directed graph one row may truly miss nodes while another lost
+    // a path, so every unfinished row is searched
+    for (int i = 0; i < graph->nodeCount && !overflow; i++) {
+        if (sums[i] != LLONG_MAX) continue;
+        int c = components != NULL ? components->labels[i] : 0;
+        int expected = components != NULL ? components->start[c + 1]
+                - components->start[c] : graph->nodeCount;
+        if (csr == NULL) csr = build_csr(graph);
+        overflow = reachable_count(csr, i) == expected;
+    }
+    if (csr != NULL) free_csr(csr);
+    return overflow;
+}
+
+/* Find the centres of each component of a graph.
+ * Parameters:
+ *          scores - the total or maximum shortest path length from each node
+ *          components - the components of the graph
+ *          total - whether the scores are totals, which must all be finite
+ * Return:
+ *          The centres of each component, numbered as in the whole graph, or
+ *          NULL if a total is not finite.
+ */
+ListNode** min_component_centres(long long* scores, Components* components,
+        int total) {
+    ListNode** centres = malloc(components->count * sizeof(ListNode*));
+    long long* componentScores = malloc(components->start[components->count] 
+            * sizeof(long long));
+    for (int c = 0; c < components->count; c++) {
+        int* nodes = &components->nodes[components->start[c]];
+        int nodeCount = components->start[c + 1] - components->start[c];
+        for (int i = 0; i < nodeCount; i++) {
+            componentScores[i] = scores[nodes[i]];
+            // Only possible within a directed component
+            if (total && componentScores[i] == LLONG_MAX) {
+                printf("Disconnected subgraph detected, solution undefined\n");
+                for (int done = 0; done < c; done++) {
+                    free_list(centres[done]);
+                }
+                free(centres);
+                free(componentScores);
+                return NULL;
             }
-        } else if (maxDistance == champ) {
-            // Append at head of linked list
-            ListNode* next = malloc(sizeof(ListNode));
-            next->value = i;
-            next->next = centres;
-            next->length = centres->length + 1;
-            centres = next;
+        }
+        centres[c] = min_centres(componentScores, nodeCount);
+        for (ListNode* node = centres[c]; node != NULL; node = node->next) {
+            node->value = nodes[node->value];
         }
     }
-    return centres; 
+    free(componentScores);
+    return centres;
 }
 
-int main(int argc, char** argv) {
-    MPI_Init(&argc, &argv);
-    MPI_Comm_size(comm, &size);
+/* Populate matrix of shortest paths between all pairs of nodes with the
+ *  chosen algorithm. Floyd shares each host's rows between its ranks when
+ *  hostComm is set.
+ * Parameters:
+ *          graph - the graph in question
+ *          algorithm - the name of the algorithm
+ *          blockSize - the tile width for the blocked algorithm
+ *          checkpoint - if not NULL, where floyd checkpoints its progress
+ *          storeDir - if not NULL, where blocked keeps its tiles, on disk
+ *                     rather than in memory, which needs sums and maxes as
+ *                     bfs does
+ *          dynamic - whether floyd, dijkstra and johnson balance work by
+ *                    how fast each rank gets through it
+ *          comm - the communicator the ranks share
+ *          hostComm - the ranks on this rank's host, or MPI_COMM_NULL when
+ *                     not sharing memory between them
+ *          leaderComm - the first rank of every host, MPI_COMM_NULL elsewhere
+ *          sums - if not NULL, out parameter on rank 0 holding the total of
+ *                 each row, gathered in place of the matrix
+ *          maxes - if not NULL, out parameter on rank 0 holding the maximum
+ *                  of each row, gathered in place of the matrix
+ * Return:
+ *          On rank 0, a matrix containing the length of the shortest paths
+ *          between all nodes, to be released with free_matrix, or NULL if
+ *          row summaries were gathered instead. NULL on every other rank.
+ */
+dist_t** solve(Graph* graph, char* algorithm, int blockSize,
+        Checkpoint* checkpoint, char* storeDir, int dynamic, MPI_Comm comm,
+        MPI_Comm hostComm, MPI_Comm leaderComm, long long* sums,
+        long long* maxes) {
+    if (strcmp(algorithm, "dijkstra") == 0) {
+        return sparse_all_pair_shortest_path(graph, dynamic, comm, sums,
+                maxes);
+    } else if (strcmp(algorithm, "johnson") == 0) {
+        return johnson_all_pair_shortest_path(graph, dynamic, comm, sums,
+                maxes);
+    } else if (strcmp(algorithm, "bfs") == 0) {
+        bfs_all_pair_summaries(graph, comm, sums, maxes);
+        return NULL;
+    } else if (strcmp(algorithm, "symmetric") == 0) {
+        return symmetric_all_pair_shortest_path(graph, comm, sums, maxes);
+    } else if (strcmp(algorithm, "blocked") == 0 && storeDir != NULL) {
+        out_of_core_all_pair_shortest_path(graph, blockSize, storeDir, comm,
+                sums, maxes);
+        return NULL;
+    } else if (strcmp(algorithm, "blocked") == 0) {
+        return blocked_all_pair_shortest_path(graph, blockSize, comm, sums,
+                maxes);
+    } else if (hostComm != MPI_COMM_NULL) {
+        return host_all_pair_shortest_path(graph, comm, hostComm, leaderComm,
+                sums, maxes);
+    }
+    return all_pair_shortest_path(graph, comm, sums, maxes, checkpoint,
+            dynamic);
+}
+
+/* Find the total and maximum shortest path length from every node, one
+ *  component at a time.
+ *  Paths never leave a component, so each is solved on its own: large
+ *  components in turn across every rank with the chosen algorithm, and small
+ *  ones whole on a single thread, shared out between ranks and threads.
+ * Parameters:
+ *          graph - the graph in question
+ *          components - the components of the graph
+ *          algorithm - the name of the algorithm for large components
+ *          blockSize - the tile width for the blocked algorithm
+ *          storeDir - if not NULL, where blocked keeps the tiles of large
+ *                     components, on disk rather than in memory
+ *          dynamic - whether large components balance work by how fast
+ *                    each rank gets through it
+ *          comm - the communicator the ranks share
+ *          hostComm - the ranks on this rank's host, or MPI_COMM_NULL when
+ *                     not sharing memory between them
+ *          leaderComm - the first rank of every host, MPI_COMM_NULL elsewhere
+ *          sums - out parameter on rank 0 holding the total of each row
+ *          maxes - out parameter on rank 0 holding the maximum of each row
+ */
+void solve_components(Graph* graph, Components* components, char* algorithm,
+        int blockSize, char* storeDir, int dynamic, MPI_Comm comm,
+        MPI_Comm hostComm, MPI_Comm leaderComm, long long* sums,
+        long long* maxes) {
+    int rank, size;
     MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &size);
+    int* owners = malloc(components->count * sizeof(int));
+    assign_components(components, size, owners);
+    long long* partialSums = calloc(graph->nodeCount, sizeof(long long));
+    long long* partialMaxes = calloc(graph->nodeCount, sizeof(long long));
 
-    Graph* graph = read_file(argv[1]);
+    double com = 0;
+    double gather = 0;
+    for (int c = 0; c < components->count; c++) {
+        if (owners[c] != -1) continue;
+        Graph* subgraph = component_subgraph(graph, components, c);
+        long long* componentSums = malloc(subgraph->nodeCount 
+                * sizeof(long long));
+        long long* componentMaxes = malloc(subgraph->nodeCount
+                * sizeof(long long));
+        solve(subgraph, algorithm, blockSize, NULL, storeDir, dynamic, comm,
+                hostComm, leaderComm, componentSums, componentMaxes);
+        com += timings.com;
+        gather += timings.gather;
+        if (rank == 0) {
+            int* nodes = &components->nodes[components->start[c]];
+            for (int i = 0; i < subgraph->nodeCount; i++) {
+                partialSums[nodes[i]] = componentSums[i];
+                partialMaxes[nodes[i]] = componentMaxes[i];
+            }
+        }
+        free(componentSums);
+        free(componentMaxes);
+        free_subgraph(subgraph);
+    }
 
+    PHASE_START(PHASE_COMPUTE);
+    #pragma omp parallel for schedule(dynamic, 1)
+    for (int c = 0; c < components->count; c++) {
+        if (owners[c] != rank) continue;
+        Graph* subgraph = component_subgraph(graph, components, c);
+        solve_component(subgraph, &components->nodes[components->start[c]],
+                partialSums, partialMaxes);
+        free_subgraph(subgraph);
+    }
+    PHASE_STOP(PHASE_COMPUTE);
+
+    // Every row was reduced by exactly one rank, the rest contributing zeros
+    PHASE_START(PHASE_GATHER);
     double startTime = MPI_Wtime();
+    reduce_partial_summaries(partialSums, partialMaxes, sums, maxes,
+            graph->nodeCount, comm);
+    timings.gather = gather + MPI_Wtime() - startTime;
+    timings.com = com;
+    PHASE_STOP(PHASE_GATHER);
 
-    int** shortestPathsMatrix = all_pair_shortest_path(graph);
+    free(partialSums);
+    free(partialMaxes);
+    free(owners);
+}
 
+/* Print the phase times of the solve and the peak memory use, on rank 0.
+ *  Each is the worst over all ranks, so that stragglers show.
+ *  Printed as timings,load,compute,com,gather,peak-rss-kb.
+ * Parameters:
+ *          comm - the communicator the ranks share
+ */
+void print_timings(MPI_Comm comm) {
+    int rank;
+    MPI_Comm_rank(comm, &rank);
+    double local[4] = {timings.load, timings.compute, timings.com,
+            timings.gather};
+    double worst[4];
+    MPI_Reduce(local, worst, 4, MPI_DOUBLE, MPI_MAX, 0, comm);
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    long localRss = usage.ru_maxrss;
+    long peakRss;
+    MPI_Reduce(&localRss, &peakRss, 1, MPI_LONG, MPI_MAX, 0, comm);
     if (rank == 0) {
-        printf("%i\n", (int) (MPI_Wtime() - startTime));
+        printf("timings,%f,%f,%f,%f,%li\n", worst[0], worst[1], worst[2],
+                worst[3], peakRss);
+    }
+}
+
+/* Free a graph from read_graph or read_shared_graph, and its shared memory.
+ * Parameters:
+ *          graph - the graph to be freed
+ *          graphWindow - the window of its shared memory, or MPI_WIN_NULL
+ */
+void release_graph(Graph* graph, MPI_Win graphWindow) {
+    free_graph(graph);
+    if (graphWindow != MPI_WIN_NULL) free_host_shared(graphWindow);
+}
+
+/* Solve one graph and write its centres, on the ranks of comm.
+ * Parameters:
+ *          filename - the path and name of the graph file
+ *          options - the options from the command line
+ *          comm - the communicator of the ranks solving the graph
+ *          hostComm - the ranks of comm on this rank's host, or MPI_COMM_NULL
+ *                     when not sharing memory between them
+ *          leaderComm - the first rank of comm on every host, MPI_COMM_NULL
+ *                       elsewhere
+ * Return:
+ *          0 if the centres were written, 1 if the graph could not be solved.
+ */
+int solve_graph(char* filename, Options* options, MPI_Comm comm,
+        MPI_Comm hostComm, MPI_Comm leaderComm) {
+    int rank, size;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &size);
+    // Options a graph can change are copied, so the next starts afresh
+    char* algorithm = options->algorithm;
+    int blockSize = options->blockSize;
+    int stream = options->stream;
+    int directed = options->directed;
+    char* checkpointDir = options->checkpointDir;
+    int checkpointEvery = options->checkpointEvery;
+    double checkpointSeconds = options->checkpointSeconds;
+    int resume = options->resume;
+    char* outOfCoreDir = options->outOfCoreDir;
+    int dynamic = options->dynamic;
+    int showTimings = options->showTimings;
+    char* reportFile = options->reportFile;
+    int samples = options->samples;
+    double error = options->error;
+    int minMaxOnly = options->minMaxOnly;
+    char* updateFile = options->updateFile;
+    int top = options->top;
+    int scores = options->scores;
+    int betweenness = options->betweenness;
+    int betweennessSamples = options->betweennessSamples;
+    memset(&timings, 0, sizeof(timings));
+
+    double loadStart = MPI_Wtime();
+    PHASE_START(PHASE_PARSE);
+    MPI_Win graphWindow = MPI_WIN_NULL;
+    Graph* graph = NULL;
+    if (hostComm != MPI_COMM_NULL) {
+        graph = read_shared_graph(filename, comm, hostComm, leaderComm,
+                &graphWindow);
+    } else {
+        graph = read_graph(filename, comm);
+    }
+    PHASE_STOP(PHASE_PARSE);
+    if (graph == NULL) return 1;
+    graph->directed = directed;
+    int bitsNeeded = distance_bits_needed(graph);
+    if (!weights_fit_distances(graph)) {
+        if (rank == 0) printf("Edge weights do not fit %i-bit distances, "
+                "rebuild with make DIST_BITS=%i.\n", DIST_BITS,
+                bitsNeeded != 0 ? bitsNeeded : 64);
+        release_graph(graph, graphWindow);
+        return 1;
+    }
+    // Graphs whose paths could be too long for the build's distances are
+    // solved with checked sums, failing only if a shortest path does not fit
+    checkedDistances = bitsNeeded == 0 || bitsNeeded > DIST_BITS;
+    distanceOverflow = 0;
+    negativeCycle = 0;
+    // Updates keep every row resident, writing the centres after each event
+    if (updateFile != NULL) {
+        char* minTotalFilename = malloc((strlen(filename) + 20) 
+                * sizeof(char));
+        sprintf(minTotalFilename, "%s-min_total", filename);
+        char* minMaxFilename = malloc((strlen(filename) + 20) * sizeof(char));
+        sprintf(minMaxFilename, "%s-min_max", filename);
+        run_updates(graph, updateFile, minTotalFilename, minMaxFilename, comm);
+        if (reportFile != NULL) {
+            INSTRUMENT_COLLECT(comm);
+            if (rank == 0) INSTRUMENT_REPORT(reportFile);
+        }
+        free(minTotalFilename);
+        free(minMaxFilename);
+        release_graph(graph, graphWindow);
+        return 0;
+    }
+    if (betweenness && !has_positive_weights(graph)) {
+        if (rank == 0) printf("Betweenness needs every edge weight to be "
+                "positive.\n");
+        release_graph(graph, graphWindow);
+        return 1;
+    }
+    if (error > 0) samples = sample_count(graph->nodeCount, error);
+    // Sampling every node costs more than solving exactly
+    if (samples >= graph->nodeCount) samples = 0;
+    // Whether shortest paths between every pair of nodes are found
+    int allPairs = samples == 0 && !minMaxOnly;
+
+    // Disconnected graphs are solved a component at a time. Checkpoints are
+    // of a single solve, so checkpointed runs take the graph whole, as do
+    // runs that only search from some nodes, whose bounds span the graph.
+    Components* components = NULL;
+    if (checkpointDir == NULL && allPairs) {
+        PHASE_START(PHASE_COMPONENTS);
+        components = find_components(graph);
+        if (components->count == 1) {
+            free_components(components);
+            components = NULL;
+        }
+        PHASE_STOP(PHASE_COMPONENTS);
+    }
+    if (strcmp(algorithm, "auto") == 0) {
+        if (allPairs && !dynamic && uniform_weight(graph) >= 0) {
+            // Every path is a number of hops, so searches run in bulk
+            algorithm = "bfs";
+        } else if (prefer_sparse(graph)) {
+            algorithm = "dijkstra";
+        } else if (directed) {
+            // Two-way negative edges are negative cycles already, so only
+            // directed graphs have anything for Johnson's reweighting to fix
+            algorithm = is_sparse(graph) ? "johnson" : "floyd";
+        } else if (dynamic) {
+            // The half-matrix solver splits its triangle statically
+            algorithm = "floyd";
+        } else {
+            // Connections are two-way, so the half-matrix solver applies
+            algorithm = "symmetric";
+        }
+    }
+    if (allPairs && strcmp(algorithm, "bfs") == 0) {
+        if (uniform_weight(graph) < 0) {
+            if (rank == 0) printf("Breadth-first search needs every edge to "
+                    "have the same non-negative weight.\n");
+            if (components != NULL) free_components(components);
+            release_graph(graph, graphWindow);
+            return 1;
+        }
+        // Searches only ever keep row summaries
+        stream = 1;
+    }
+    if (allPairs && strcmp(algorithm, "dijkstra") == 0
+            && has_negative_weights(graph)) {
+        if (rank == 0) printf("Dijkstra needs non-negative edge weights, "
+                "use johnson for directed graphs with negative weights.\n");
+        if (components != NULL) free_components(components);
+        release_graph(graph, graphWindow);
+        return 1;
+    }
+    // Small components are always solved with Floyd-Warshall
+    if (components != NULL || (allPairs
+            && strcmp(algorithm, "dijkstra") != 0
+            && strcmp(algorithm, "johnson") != 0
+            && strcmp(algorithm, "bfs") != 0)) {
+        select_min_plus_kernel(has_negative_weights(graph));
+    }
+    timings.load = MPI_Wtime() - loadStart;
+
+    double startTime = MPI_Wtime();
+
+    // Centres only need the total and maximum of each row, which streaming
+    // solvers reduce before gathering
+    long long* rowSums = malloc(graph->nodeCount * sizeof(long long));
+    long long* rowMaxes = malloc(graph->nodeCount * sizeof(long long));
+    long long* streamSums = stream ? rowSums : NULL;
+    long long* streamMaxes = stream ? rowMaxes : NULL;
+
+    dist_t** shortestPathsMatrix = NULL;
+    ListNode* approximateTotalCentres = NULL;
+    ListNode* approximateMaxCentres = NULL;
+    ListNode* boundedMaxCentres = NULL;
+    int failed = 0;
+    if (minMaxOnly) {
+        stream = 1;
+        failed = bounded_min_max_centres(graph, comm, &boundedMaxCentres);
+    } else if (samples > 0) {
+        // Only the candidates are ever searched from exactly
+        stream = 1;
+        failed = approximate_centres(graph, samples, comm,
+                &approximateTotalCentres, &approximateMaxCentres);
+    } else if (components != NULL) {
+        // Components are only ever reduced to row summaries
+        stream = 1;
+        solve_components(graph, components, algorithm, blockSize,
+                outOfCoreDir, dynamic, comm, hostComm, leaderComm, rowSums,
+                rowMaxes);
+    } else {
+        Checkpoint* checkpoint = NULL;
+        if (checkpointDir != NULL) {
+            int start, end;
+            set_partition(rank, size, graph->nodeCount, &start, &end);
+            checkpoint = checkpoint_init(checkpointDir, checkpointEvery,
+                    checkpointSeconds, resume, graph->nodeCount, start, end,
+                    comm);
+        }
+        shortestPathsMatrix = solve(graph, algorithm, blockSize, checkpoint,
+                outOfCoreDir, dynamic, comm, hostComm, leaderComm, streamSums,
+                streamMaxes);
+    }
+    // Any rank may have found a negative cycle, on any thread
+    MPI_Allreduce(MPI_IN_PLACE, &negativeCycle, 1, MPI_INT, MPI_MAX, comm);
+    if (negativeCycle) {
+        if (rank == 0) printf("Negative cycle detected, min path undefined\n");
+        failed = 1;
+    }
+    if (failed) {
+        if (shortestPathsMatrix != NULL) free_matrix(shortestPathsMatrix);
+        free(rowSums);
+        free(rowMaxes);
+        if (components != NULL) free_components(components);
+        release_graph(graph, graphWindow);
+        return 1;
     }
 
+    double solveTime = MPI_Wtime() - startTime;
+    timings.compute = solveTime - timings.com - timings.gather;
+    if (rank == 0 && options->batch) {
+        // Groups of a batch print at once, so each line names its graph
+        printf("%s,%f,%i\n", filename, timings.com, (int) solveTime);
+        fflush(stdout);
+    } else if (rank == 0) {
+        printf("%f,", timings.com);
+        printf("%i\n", (int) solveTime);
+    }
+    if (showTimings) print_timings(comm);
+
+    // Betweenness comes from searches of its own, after the solve is timed
+    double* betweennessScores = NULL;
+    if (betweenness) {
+        betweennessScores = malloc(graph->nodeCount * sizeof(double));
+        betweenness_centrality(graph, betweennessSamples, comm,
+                betweennessScores);
+    }
+
+    if (rank == 0 && !stream) {
+        PHASE_START(PHASE_CENTRES);
+        #pragma omp parallel for
+        for (int i = 0; i < graph->nodeCount; i++) {
+            summarise_row(shortestPathsMatrix[i], graph->nodeCount, 
+                    &rowSums[i], &rowMaxes[i]);
+        }
+        free_matrix(shortestPathsMatrix);
+        PHASE_STOP(PHASE_CENTRES);
+    }
+    if (checkedDistances) {
+        if (rank == 0 && allPairs && !distanceOverflow) {
+            distanceOverflow = unreached_paths(rowSums, graph, components);
+        }
+        MPI_Allreduce(MPI_IN_PLACE, &distanceOverflow, 1, MPI_INT, MPI_MAX,
+                comm);
+        if (distanceOverflow) {
+            if (rank == 0) report_distance_overflow(graph);
+            free(betweennessScores);
+            free_list(boundedMaxCentres);
+            free_list(approximateTotalCentres);
+            free_list(approximateMaxCentres);
+            free(rowSums);
+            free(rowMaxes);
+            if (components != NULL) free_components(components);
+            release_graph(graph, graphWindow);
+            return 1;
+        }
+    }
+    if (reportFile != NULL) INSTRUMENT_COLLECT(comm);
+
     // Only calculate centres on rank 0, since only it has full distance matrix
     if (rank != 0) {
-        MPI_Finalize();
+        free(betweennessScores);
+        free(rowSums);
+        free(rowMaxes);
+        if (components != NULL) free_components(components);
+        release_graph(graph, graphWindow);
         return 0;
     }
     
-    // Find centres by minimum total distance
-    ListNode* minTotalCentres = min_total_centres(shortestPathsMatrix, graph);
-    char* minTotalFilename = malloc((strlen(argv[1]) + 20) * sizeof(char));
-    sprintf(minTotalFilename, "%s-min_total", argv[1]);
-    write_file(minTotalFilename, minTotalCentres, graph);
-    
-    // Find centres by minimum maximum distance
-    ListNode* minMaxCentres = min_max_centres(shortestPathsMatrix, graph);
-    char* minMaxFilename = malloc((strlen(argv[1]) + 20) * sizeof(char));
-    sprintf(minMaxFilename, "%s-min_max", argv[1]);
-    write_file(minMaxFilename, minMaxCentres, graph);
+    PHASE_START(PHASE_CENTRES);
 
-    MPI_Finalize();
-    return 0;
+    char* minTotalFilename = malloc((strlen(filename) + 20) * sizeof(char));
+    sprintf(minTotalFilename, "%s-min_total", filename);
+    char* minMaxFilename = malloc((strlen(filename) + 20) * sizeof(char));
+    sprintf(minMaxFilename, "%s-min_max", filename);
+    if (minMaxOnly) {
+        PHASE_STOP(PHASE_CENTRES);
+
+        // Totals are never found, so there is no min_total file
+        PHASE_START(PHASE_WRITE);
+        write_file(minMaxFilename, boundedMaxCentres, graph);
+        PHASE_STOP(PHASE_WRITE);
+    } else if (samples > 0) {
+        PHASE_STOP(PHASE_CENTRES);
+
+        PHASE_START(PHASE_WRITE);
+        write_file(minTotalFilename, approximateTotalCentres, graph);
+        write_file(minMaxFilename, approximateMaxCentres, graph);
+        PHASE_STOP(PHASE_WRITE);
+    } else if (components != NULL) {
+        // Centres are only defined within each component
+        ListNode** minTotalCentres = min_component_centres(rowSums, 
+                components, 1);
+        ListNode** minMaxCentres = min_component_centres(rowMaxes, 
+                components, 0);
+        PHASE_STOP(PHASE_CENTRES);
+
+        // Without centres by total, nothing about the graph is written
+        failed = minTotalCentres == NULL;
+        if (!failed) {
+            PHASE_START(PHASE_WRITE);
+            write_component_file(minTotalFilename, minTotalCentres,
+                    components, graph);
+            write_component_file(minMaxFilename, minMaxCentres, components,
+                    graph);
+            PHASE_STOP(PHASE_WRITE);
+        }
+        for (int c = 0; c < components->count; c++) {
+            if (!failed) free_list(minTotalCentres[c]);
+            free_list(minMaxCentres[c]);
+        }
+        free(minTotalCentres);
+        free(minMaxCentres);
+    } else {
+        // Find centres by minimum total distance
+        ListNode* minTotalCentres = min_total_centres(rowSums, graph);
+        // Find centres by minimum maximum distance
+        ListNode* minMaxCentres = min_max_centres(rowMaxes, graph);
+        PHASE_STOP(PHASE_CENTRES);
+
+        // Without centres by total, nothing about the graph is written
+        failed = minTotalCentres == NULL;
+        if (!failed) {
+            PHASE_START(PHASE_WRITE);
+            write_file(minTotalFilename, minTotalCentres, graph);
+            write_file(minMaxFilename, minMaxCentres, graph);
+            PHASE_STOP(PHASE_WRITE);
+        }
+        free_list(minTotalCentres);
+        free_list(minMaxCentres);
+    }
+    if (!failed && allPairs && (top > 0 || scores)) {
+        PHASE_START(PHASE_WRITE);
+        write_node_scores(filename, rowSums, rowMaxes, graph, components, top,
+                scores);
+        PHASE_STOP(PHASE_WRITE);
+    }
+    if (!failed && betweenness) {
+        PHASE_START(PHASE_CENTRES);
+        ListNode* maxBetweennessCentres = max_betweenness_centres(
+                betweennessScores, graph->nodeCount);
+        PHASE_STOP(PHASE_CENTRES);
+
+        PHASE_START(PHASE_WRITE);
+        char* outFilename = malloc((strlen(filename) + 20) * sizeof(char));
+        sprintf(outFilename, "%s-betweenness", filename);
+        write_betweenness_file(outFilename, betweennessScores, graph);
+        sprintf(outFilename, "%s-max_betweenness", filename);
+        write_file(outFilename, maxBetweennessCentres, graph);
+        PHASE_STOP(PHASE_WRITE);
+        free(outFilename);
+        free_list(maxBetweennessCentres);
+    }
+
+    if (reportFile != NULL) INSTRUMENT_REPORT(reportFile);
+    free(betweennessScores);
+    free_list(boundedMaxCentres);
+    free_list(approximateTotalCentres);
+    free_list(approximateMaxCentres);
+    free(minTotalFilename);
+    free(minMaxFilename);
+    free(rowSums);
+    free(rowMaxes);
+    if (components != NULL) free_components(components);
+    release_graph(graph, graphWindow);
+    return failed;
 }
 
+/* Plan which ranks solve each graph of a batch, and when.
+ *  Graphs are taken largest first. Each round, a graph gets a group of
+ *  consecutive ranks in proportion to its share of the cost still to solve,
+ *  while enough ranks are free, and ranks left over join the first group.
+ *  The rest then queue on whichever group would finish first, as long as
+ *  that is no later than the round's slowest group, and wait for the next
+ *  round otherwise. A graph's time is estimated as its cost over its ranks.
+ * Parameters:
+ *          costs - the estimated cost of each graph, negative to skip it
+ *          order - the graphs by decreasing cost
+ *          jobCount - the number of graphs
+ *          worldSize - the number of ranks in the job
+ *          jobRound - out parameter holding the round each graph is solved in
+ *          jobGroup - out parameter holding the group solving each graph
+ *          rankGroups - out parameter holding the group of every rank in
+ *                       every round, worldSize entries per round, at least
+ *                       jobCount rounds
+ * Return:
+ *          The number of rounds.
+ */
+int plan_batch(double* costs, int* order, int jobCount, int worldSize,
+        int* jobRound, int* jobGroup, int* rankGroups) {
+    double* finish = malloc(worldSize * sizeof(double));
+    int* width = malloc(worldSize * sizeof(int));
+    int left = 0;
+    for (int j = 0; j < jobCount; j++) {
+        jobRound[j] = -1;
+        if (costs[j] >= 0) left++;
+    }
+
+    int rounds = 0;
+    while (left > 0) {
+        double remaining = 0;
+        for (int j = 0; j < jobCount; j++) {
+            if (costs[j] >= 0 && jobRound[j] == -1) remaining += costs[j];
+        }
+        int* groupOf = &rankGroups[rounds * worldSize];
+        int groups = 0;
+        int spare = worldSize;
+        for (int o = 0; o < jobCount; o++) {
+            int j = order[o];
+            if (costs[j] < 0 || jobRound[j] != -1) continue;
+            int wanted = remaining > 0 ? (int) (worldSize * costs[j] 
+                    / remaining + 0.5) : 1;
+            if (wanted < 1) wanted = 1;
+            if (wanted > spare) continue;
+            width[groups] = wanted;
+            jobRound[j] = rounds;
+            jobGroup[j] = groups++;
+            spare -= wanted;
+            left--;
+        }
+        width[0] += spare;
+
+        int next = 0;
+        double makespan = 0;
+        for (int g = 0; g < groups; g++) {
+            for (int r = 0; r < width[g]; r++) {
+                groupOf[next++] = g;
+            }
+            finish[g] = 0;
+        }
+        for (int j = 0; j < jobCount; j++) {
+            if (jobRound[j] != rounds) continue;
+            finish[jobGroup[j]] = costs[j] / width[jobGroup[j]];
+            if (finish[jobGroup[j]] > makespan) makespan = finish[jobGroup[j]];
+        }
+
+        for (int o = 0; o < jobCount; o++) {
+            int j = order[o];
+            if (costs[j] < 0 || jobRound[j] != -1) continue;
+            int first = 0;
+            for (int g = 1; g < groups; g++) {
+                if (finish[g] + costs[j] / width[g] < finish[first] 
+                        + costs[j] / width[first]) {
+                    first = g;
+                }
+            }
+            if (finish[first] + costs[j] / width[first] > makespan) continue;
+            finish[first] += costs[j] / width[first];
+            jobRound[j] = rounds;
+            jobGroup[j] = first;
+            left--;
+        }
+        rounds++;
+    }
+    free(finish);
+    free(width);
+    return rounds;
+}
+
+/* Solve every graph listed in a manifest, one path per line, in one job.
+ *  The ranks are split into groups by plan_batch, each solving its graphs
+ *  in turn on a communicator of its own, so small graphs do not pay for
+ *  communication across every rank. A graph's cost is taken as
+ *  |V| (|V| + |E|), between the work of Floyd-Warshall and of Dijkstra.
+ * Parameters:
+ *          manifest - the path and name of the file listing the graphs
+ *          options - the options from the command line, for every graph
+ * Return:
+ *          0 if every graph was solved, 1 otherwise.
+ */
+int run_batch(char* manifest, Options* options) {
+    int worldRank, worldSize;
+    MPI_Comm_rank(MPI_COMM_WORLD, &worldRank);
+    MPI_Comm_size(MPI_COMM_WORLD, &worldSize);
+    FILE* file = fopen(manifest, "r");
+    if (file == NULL) {
+        if (worldRank == 0) printf("File %s could not be opened.\n", 
+                manifest);
+        return 1;
+    }
+    int jobCount = 0;
+    int capacity = 16;
+    char** filenames = malloc(capacity * sizeof(char*));
+    char line[4096];
+    while (fgets(line, sizeof(line), file) != NULL) {
+        line[strcspn(line, "\r\n")] = '\0';
+        // Blank lines and comments list no graph
+        if (line[0] == '\0' || line[0] == '#') continue;
+        if (jobCount == capacity) {
+            capacity *= 2;
+            filenames = realloc(filenames, capacity * sizeof(char*));
+        }
+        filenames[jobCount++] = strdup(line);
+    }
+    fclose(file);
+
+    double* costs = malloc(jobCount * sizeof(double));
+    if (worldRank == 0) {
+        for (int j = 0; j < jobCount; j++) {
+            int nodeCount, edgeCount;
+            if (read_graph_size(filenames[j], &nodeCount, &edgeCount) != 0) {
+                printf("Graph %s could not be read, skipping.\n", 
+                        filenames[j]);
+                costs[j] = -1;
+                continue;
+            }
+            costs[j] = (double) nodeCount * ((double) nodeCount + edgeCount);
+        }
+    }
+    MPI_Bcast(costs, jobCount, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+    int status = 0;
+    int* order = malloc(jobCount * sizeof(int));
+    for (int j = 0; j < jobCount; j++) {
+        if (costs[j] < 0) status = 1;
+        // Insert by decreasing cost, keeping ties in manifest order
+        int o = j;
+        while (o > 0 && costs[order[o - 1]] < costs[j]) {
+            order[o] = order[o - 1];
+            o--;
+        }
+        order[o] = j;
+    }
+
+    // Every rank plans the same batch from the same costs
+    int* jobRound = malloc(jobCount * sizeof(int));
+    int* jobGroup = malloc(jobCount * sizeof(int));
+    int* rankGroups = malloc((size_t) jobCount * worldSize * sizeof(int));
+    int rounds = plan_batch(costs, order, jobCount, worldSize, jobRound,
+            jobGroup, rankGroups);
+
+    // Freed matrices stay in the heap for the next graph to reuse, rather
+    // than being returned to the kernel and faulted in again
+    mallopt(M_MMAP_MAX, 0);
+    mallopt(M_TRIM_THRESHOLD, -1);
+
+    for (int r = 0; r < rounds; r++) {
+        int group = rankGroups[r * worldSize + worldRank];
+        MPI_Comm groupComm;
+        MPI_Comm_split(MPI_COMM_WORLD, group, worldRank, &groupComm);
+        int groupRank;
+        MPI_Comm_rank(groupComm, &groupRank);
+        MPI_Comm hostComm = MPI_COMM_NULL;
+        MPI_Comm leaderComm = MPI_COMM_NULL;
+        if (options->nodeShared) split_host_comms(groupComm, &hostComm, 
+                &leaderComm);
+        for (int o = 0; o < jobCount; o++) {
+            int j = order[o];
+            if (costs[j] < 0 || jobRound[j] != r || jobGroup[j] != group) {
+                continue;
+            }
+            if (solve_graph(filenames[j], options, groupComm, hostComm,
+                    leaderComm) != 0) {
+                if (groupRank == 0) printf("Graph %s was skipped.\n", 
+                        filenames[j]);
+                status = 1;
+            }
+        }
+        if (options->nodeShared) free_host_comms(&hostComm, &leaderComm);
+        MPI_Comm_free(&groupComm);
+    }
+
+    // Any rank may have seen a graph fail, so all must agree on the status
+    MPI_Allreduce(MPI_IN_PLACE, &status, 1, MPI_INT, MPI_MAX, 
+            MPI_COMM_WORLD);
+    for (int j = 0; j < jobCount; j++) {
+        free(filenames[j]);
+    }
+    free(filenames);
+    free(costs);
+    free(order);
+    free(jobRound);
+    free(jobGroup);
+    free(rankGroups);
+    return status;
+}
+
+/* Print command line usage.
+ * Parameters:
+ *          program - the name the solver was invoked with
+ */
+void print_usage(char* program) {
+    printf("Usage: %s [-a auto|floyd|blocked|symmetric|dijkstra|johnson|bfs] "
+            "[-b block-size] [-s] [-d] [-C checkpoint-dir [-i iterations] "
+            "[-T seconds] [-r]] [-o store-dir] [-D] [-N] "
+            "[-k samples | -e error | -m] "
+            "[-u update-file] [-K count] [-S] [-w | -W samples] "
+            "[-t] "
+            "[-R report-file [-H]] graph-file | -B manifest\n",
+            program);
+    printf("  -a, --algorithm           shortest path algorithm (default auto, "
+            "which uses bfs when every edge has the same weight, dijkstra on "
+            "sparse graphs, johnson on sparse directed "
+            "graphs with negative weights, and symmetric, or floyd if "
+            "directed, otherwise)\n");
+    printf("  -b, --block-size          tile width for the blocked algorithm "
+            "(default %i)\n", DEFAULT_BLOCK_SIZE);
+    printf("  -s, --stream              stream row totals and maxima to rank 0 "
+            "instead of the full distance matrix\n");
+    printf("  -d, --directed            treat each edge as one-way, from its "
+            "first node to its second\n");
+    printf("  -C, --checkpoint-dir      periodically checkpoint floyd progress "
+            "to this directory\n");
+    printf("  -i, --checkpoint-every    checkpoint every this many "
+            "iterations\n");
+    printf("  -T, --checkpoint-seconds  checkpoint after this many seconds "
+            "(default %i if -i is not given)\n", DEFAULT_CHECKPOINT_SECONDS);
+    printf("  -r, --resume              continue from the latest checkpoint in "
+            "the checkpoint directory\n");
+    printf("  -o, --out-of-core         keep blocked tiles in files in this "
+            "directory, streaming them through memory, for graphs larger than "
+            "RAM\n");
+    printf("  -D, --dynamic             balance work between ranks by the "
+            "throughput each is measured at, for floyd, dijkstra and "
+            "johnson\n");
+    printf("  -N, --node-shared         share the graph and floyd's rows "
+            "between the ranks on each host, exchanging rows only between "
+            "hosts\n");
+    printf("  -k, --samples             approximate the centres from this many "
+            "sampled pivots, verifying as many candidates exactly\n");
+    printf("  -e, --error               approximate the centres to this "
+            "fraction of the diameter, 0 being exact (default 0)\n");
+    printf("  -m, --min-max             find only the minimum maximum distance "
+            "centres, searching from as few nodes as their bounds allow\n");
+    printf("  -u, --updates             after solving, apply insert, decrease "
+            "and delete edge events from this file, or - for standard input, "
+            "writing the centres again after each\n");
+    printf("  -K, --top                 also write this many of the best "
+            "nodes by total and by maximum distance, with their scores\n");
+    printf("  -S, --scores              also write every node's total "
+            "distance, eccentricity and closeness, as text and binary\n");
+    printf("  -w, --betweenness         also find every node's betweenness "
+            "and the nodes with the highest\n");
+    printf("  -W, --betweenness-samples estimate betweenness from this many "
+            "sampled sources\n");
+    printf("  -B, --batch               solve every graph listed in this "
+            "file, one per line, on groups of ranks sized to each\n");
+    printf("  -t, --timings             print the slowest rank's load, "
+            "compute, communication and gather seconds and the largest peak "
+            "RSS in KB\n");
+    printf("  -R, --report              write per-phase times over ranks to "
+            "this JSON file, in builds from make instrument\n");
+    printf("  -H, --histogram           add per-rank histograms of phase call "
+            "times, such as each k, to the report\n");
+}
+
+int main(int argc, char** argv) {
+    // Threads never call MPI themselves, the master thread does it for them
+    int threadSupport;
+    MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &threadSupport);
+    int rank;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    if (threadSupport < MPI_THREAD_FUNNELED) {
+        if (rank == 0) printf("The MPI library does not support calls from "
+                "the master thread of an OpenMP region.\n");
+        MPI_Finalize();
+        return 1;
+    }
+
+    char* algorithm = "auto";
+    int blockSize = DEFAULT_BLOCK_SIZE;
+    int stream = 0;
+    int directed = 0;
+    char* checkpointDir = NULL;
+    int checkpointEvery = 0;
+    double checkpointSeconds = 0;
+    int resume = 0;
+    char* outOfCoreDir = NULL;
+    int dynamic = 0;
+    int nodeShared = 0;
+    int showTimings = 0;
+    char* reportFile = NULL;
+    int histogram = 0;
+    int samples = 0;
+    double error = 0;
+    int minMaxOnly = 0;
+    char* updateFile = NULL;
+    int top = 0;
+    int scores = 0;
+    int betweenness = 0;
+    int betweennessSamples = 0;
+    char* batchFile = NULL;
+    struct option longOptions[] = {
+        {"algorithm", required_argument, NULL, 'a'},
+        {"block-size", required_argument, NULL, 'b'},
+        {"stream", no_argument, NULL, 's'},
+        {"directed", no_argument, NULL, 'd'},
+        {"checkpoint-dir", required_argument, NULL, 'C'},
+        {"checkpoint-every", required_argument, NULL, 'i'},
+        {"checkpoint-seconds", required_argument, NULL, 'T'},
+        {"resume", no_argument, NULL, 'r'},
+        {"out-of-core", required_argument, NULL, 'o'},
+        {"dynamic", no_argument, NULL, 'D'},
+        {"node-shared", no_argument, NULL, 'N'},
+        {"samples", required_argument, NULL, 'k'},
+        {"error", required_argument, NULL, 'e'},
+        {"min-max", no_argument, NULL, 'm'},
+        {"updates", required_argument, NULL, 'u'},
+        {"top", required_argument, NULL, 'K'},
+        {"scores", no_argument, NULL, 'S'},
+        {"betweenness", no_argument, NULL, 'w'},
+        {"betweenness-samples", required_argument, NULL, 'W'},
+        {"batch", required_argument, NULL, 'B'},
+        {"timings", no_argument, NULL, 't'},
+        {"report", required_argument, NULL, 'R'},
+        {"histogram", no_argument, NULL, 'H'},
+        {NULL, 0, NULL, 0}
+    };
+    int opt;
+    while ((opt = getopt_long(argc, argv,
+            "a:b:sdC:i:T:ro:DNk:e:mu:K:SwW:B:tR:H", longOptions, NULL)) != -1) {
+        switch (opt) {
+            case 'a':
+                algorithm = optarg;
+                break;
+            case 'b':
+                blockSize = atoi(optarg);
+                break;
+            case 's':
+                stream = 1;
+                break;
+            case 'd':
+                directed = 1;
+                break;
+            case 'C':
+                checkpointDir = optarg;
+                break;
+            case 'i':
+                checkpointEvery = atoi(optarg);
+                break;
+            case 'T':
+                checkpointSeconds = atof(optarg);
+                break;
+            case 'r':
+                resume = 1;
+                break;
+            case 'o':
+                outOfCoreDir = optarg;
+                break;
+            case 'D':
+                dynamic = 1;
+                break;
+            case 'N':
+                nodeShared = 1;
+                break;
+            case 'k':
+                samples = atoi(optarg);
+                break;
+            case 'e':
+                error = atof(optarg);
+                break;
+            case 'm':
+                minMaxOnly = 1;
+                break;
+            case 'u':
+                updateFile = optarg;
+                break;
+            case 'K':
+                top = atoi(optarg);
+                break;
+            case 'S':
+                scores = 1;
+                break;
+            case 'w':
+                betweenness = 1;
+                break;
+            case 'W':
+                betweenness = 1;
+                betweennessSamples = atoi(optarg);
+                break;
+            case 'B':
+                batchFile = optarg;
+                break;
+            case 't':
+                showTimings = 1;
+                break;
+            case 'R':
+                reportFile = optarg;
+                break;
+            case 'H':
+                histogram = 1;
+                break;
+            default:
+                if (rank == 0) print_usage(argv[0]);
+                MPI_Finalize();
+                return 1;
+        }
+    }
+    if ((batchFile == NULL ? optind >= argc : optind < argc) || blockSize < 1
+            || (strcmp(algorithm, "auto") != 0
+            && strcmp(algorithm, "floyd") != 0 
+            && strcmp(algorithm, "blocked") != 0
+            && strcmp(algorithm, "symmetric") != 0
+            && strcmp(algorithm, "dijkstra") != 0
+            && strcmp(algorithm, "johnson") != 0
+            && strcmp(algorithm, "bfs") != 0)
+            || checkpointEvery < 0 || checkpointSeconds < 0
+            || (resume && checkpointDir == NULL)
+            || samples < 0 || error < 0 || (samples > 0 && error > 0)
+            || (minMaxOnly && (samples > 0 || error > 0))
+            || top < 0 || betweennessSamples < 0
+            || (histogram && reportFile == NULL)) {
+        if (rank == 0) print_usage(argv[0]);
+        MPI_Finalize();
+        return 1;
+    }
+    if (updateFile != NULL && (checkpointDir != NULL || samples > 0
+            || error > 0 || minMaxOnly || (strcmp(algorithm, "auto") != 0
+            && strcmp(algorithm, "dijkstra") != 0))) {
+        if (rank == 0) printf("Updates are only applied to dijkstra solves.\n");
+        MPI_Finalize();
+        return 1;
+    }
+    if (outOfCoreDir != NULL && (checkpointDir != NULL || samples > 0
+            || error > 0 || minMaxOnly || updateFile != NULL)) {
+        if (rank == 0) printf("Only all pairs solves run out of core.\n");
+        MPI_Finalize();
+        return 1;
+    }
+    if (outOfCoreDir != NULL && strcmp(algorithm, "auto") == 0) {
+        algorithm = "blocked";
+    }
+    if (outOfCoreDir != NULL && strcmp(algorithm, "blocked") != 0) {
+        if (rank == 0) printf("Out-of-core solves are only supported by "
+                "blocked.\n");
+        MPI_Finalize();
+        return 1;
+    }
+    // The whole matrix is never in memory, so only its summaries are gathered
+    if (outOfCoreDir != NULL) stream = 1;
+    if (checkpointDir != NULL && (samples > 0 || error > 0 || minMaxOnly)) {
+        if (rank == 0) printf("Only all pairs solves are checkpointed.\n");
+        MPI_Finalize();
+        return 1;
+    }
+    if (checkpointDir != NULL && strcmp(algorithm, "auto") == 0) {
+        algorithm = "floyd";
+    }
+    if (checkpointDir != NULL && strcmp(algorithm, "floyd") != 0) {
+        if (rank == 0) printf("Checkpointing is only supported by floyd.\n");
+        MPI_Finalize();
+        return 1;
+    }
+    if (checkpointDir != NULL && checkpointEvery == 0 
+            && checkpointSeconds == 0) {
+        checkpointSeconds = DEFAULT_CHECKPOINT_SECONDS;
+    }
+    if (dynamic && (samples > 0 || error > 0 || minMaxOnly
+            || updateFile != NULL)) {
+        if (rank == 0) printf("Only all pairs solves are balanced "
+                "dynamically.\n");
+        MPI_Finalize();
+        return 1;
+    }
+    if (dynamic && checkpointDir != NULL) {
+        if (rank == 0) printf("Checkpointed solves are balanced "
+                "statically.\n");
+        MPI_Finalize();
+        return 1;
+    }
+    if (dynamic && strcmp(algorithm, "auto") != 0
+            && strcmp(algorithm, "floyd") != 0
+            && strcmp(algorithm, "dijkstra") != 0
+            && strcmp(algorithm, "johnson") != 0) {
+        if (rank == 0) printf("Dynamic balancing is only supported by floyd, "
+                "dijkstra and johnson.\n");
+        MPI_Finalize();
+        return 1;
+    }
+    if (nodeShared && strcmp(algorithm, "auto") == 0) algorithm = "floyd";
+    if (nodeShared && (strcmp(algorithm, "floyd") != 0 || dynamic
+            || checkpointDir != NULL || samples > 0 || error > 0
+            || minMaxOnly || updateFile != NULL)) {
+        if (rank == 0) printf("Node-shared memory is only supported by "
+                "floyd all pairs solves.\n");
+        MPI_Finalize();
+        return 1;
+    }
+    if ((top > 0 || scores) && (samples > 0 || error > 0 || minMaxOnly
+            || updateFile != NULL)) {
+        if (rank == 0) printf("Scores are only written by all pairs "
+                "solves.\n");
+        MPI_Finalize();
+        return 1;
+    }
+    if (betweenness && updateFile != NULL) {
+        if (rank == 0) printf("Betweenness is not kept up to date with "
+                "updates.\n");
+        MPI_Finalize();
+        return 1;
+    }
+    if (batchFile != NULL && (checkpointDir != NULL || updateFile != NULL
+            || reportFile != NULL)) {
+        if (rank == 0) printf("Checkpoints, updates and reports are only for "
+                "single graphs.\n");
+        MPI_Finalize();
+        return 1;
+    }
+    // Groups finish at different times, so only row summaries are gathered
+    if (batchFile != NULL) stream = 1;
+    if (directed && strcmp(algorithm, "symmetric") == 0) {
+        if (rank == 0) printf("Directed graphs have no symmetric solver.\n");
+        MPI_Finalize();
+        return 1;
+    }
+#ifndef INSTRUMENT
+    if (reportFile != NULL || histogram) {
+        if (rank == 0) printf("Reports need a build from make instrument.\n");
+        MPI_Finalize();
+        return 1;
+    }
+#endif
+    INSTRUMENT_INIT(histogram);
+    Options options = {algorithm, blockSize, stream, directed, checkpointDir,
+            checkpointEvery, checkpointSeconds, resume, outOfCoreDir, dynamic,
+            nodeShared, showTimings, reportFile, samples, error, minMaxOnly,
+            updateFile, top, scores, betweenness, betweennessSamples,
+            batchFile != NULL};
+    int status;
+    if (batchFile != NULL) {
+        status = run_batch(batchFile, &options);
+    } else {
+        MPI_Comm hostComm = MPI_COMM_NULL;
+        MPI_Comm leaderComm = MPI_COMM_NULL;
+        if (nodeShared) split_host_comms(MPI_COMM_WORLD, &hostComm, 
+                &leaderComm);
+        status = solve_graph(argv[optind], &options, MPI_COMM_WORLD, hostComm,
+                leaderComm);
+        if (nodeShared) free_host_comms(&hostComm, &leaderComm);
+    }
+    MPI_Finalize();
+    return status;
+}
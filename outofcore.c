@@ -0,0 +1,360 @@
+/* =============================================================================
+ * outofcore.c  Blocked Floyd-Warshall with each rank's tiles kept in a file
+ *              and streamed through memory, for matrices larger than RAM
+ * =============================================================================
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <omp.h>
+#include <mpi.h>
+#include "helper.h"
+#include "blocked.h"
+#include "instrument.h"
+#include "outofcore.h"
+
+/* Read tiles from a tile store, exiting if they cannot be read.
+ * Parameters:
+ *          fd - the tile store
+ *          tiles - out parameter holding the tiles read
+ *          count - the number of distances to read
+ *          offset - the position in the store to read from, in bytes
+ */
+void read_tiles(int fd, dist_t* tiles, size_t count, off_t offset) {
+    char* buffer = (char*) tiles;
+    size_t remaining = count * sizeof(dist_t);
+    while (remaining > 0) {
+        ssize_t got = pread(fd, buffer, remaining, offset);
+        if (got <= 0) {
+            printf("Tile store could not be read.\n");
+            exit(1);
+        }
+        buffer += got;
+        offset += got;
+        remaining -= got;
+    }
+}
+
+/* Write tiles to a tile store, exiting if they cannot be written.
+ * Parameters:
+ *          fd - the tile store
+ *          tiles - the tiles to write
+ *          count - the number of distances to write
+ *          offset - the position in the store to write to, in bytes
+ */
+void write_tiles(int fd, dist_t* tiles, size_t count, off_t offset) {
+    char* buffer = (char*) tiles;
+    size_t remaining = count * sizeof(dist_t);
+    while (remaining > 0) {
+        ssize_t put = pwrite(fd, buffer, remaining, offset);
+        if (put <= 0) {
+            printf("Tile store could not be written.\n");
+            exit(1);
+        }
+        buffer += put;
+        offset += put;
+        remaining -= put;
+    }
+}
+
+/* Create this rank's tile store.
+ *  The file is unlinked as soon as it is open, so it never outlives the
+ *  solve, even one that is killed.
+ * Parameters:
+ *          directory - the directory to keep the store in, created if it
+ *                      does not exist
+ *          comm - the communicator the ranks share
+ * Return:
+ *          The file descriptor of the store.
+ */
+int open_tile_store(char* directory, MPI_Comm comm) {
+    int rank;
+    MPI_Comm_rank(comm, &rank);
+    if (rank == 0 && mkdir(directory, 0755) != 0 && errno != EEXIST) {
+        printf("Tile store directory %s could not be created.\n", directory);
+        exit(1);
+    }
+    MPI_Barrier(comm);
+
+    char path[4096];
+    snprintf(path, sizeof(path), "%s/rank%i.tiles", directory, rank);
+    int fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0600);
+    if (fd == -1) {
+        printf("Tile store %s could not be created.\n", path);
+        exit(1);
+    }
+    unlink(path);
+    return fd;
+}
+
+/* Write a rank's tiles before any relaxation to its tile store.
+ *  Entries are bucketed by local block row in edge order, so each row is
+ *  built in memory once and later edges still overwrite earlier ones.
+ * Parameters:
+ *          graph - the graph in question
+ *          fd - the tile store
+ *          buffer - space for one row of tiles
+ *          gridRow - the rank's row in the process grid
+ *          gridCol - the rank's column in the process grid
+ *          gridRows - the number of rows in the process grid
+ *          gridCols - the number of columns in the process grid
+ *          localRows - the number of block rows the rank owns
+ *          localCols - the number of block columns the rank owns
+ *          blockSize - the width of each square tile
+ */
+void write_initial_tiles(Graph* graph, int fd, dist_t* buffer, int gridRow,
+        int gridCol, int gridRows, int gridCols, int localRows, int localCols,
+        int blockSize) {
+    size_t rowLength = (size_t) localCols * blockSize * blockSize;
+    int directions = graph->directed ? 1 : 2;
+
+    // Count the owned entries of each block row, then fill them in edge order
+    int* rowStart = calloc(localRows + 1, sizeof(int));
+    for (int e = 0; e < graph->edgeCount; e++) {
+        if (graph->edgeFrom[e] == graph->edgeTo[e]) continue;
+        for (int d = 0; d < directions; d++) {
+            int i = d == 0 ? graph->edgeFrom[e] : graph->edgeTo[e];
+            int j = d == 0 ? graph->edgeTo[e] : graph->edgeFrom[e];
+            long long offset = owned_tile_offset(i, j, gridRow, gridCol,
+                    gridRows, gridCols, localCols, blockSize);
+            if (offset != -1) rowStart[offset / rowLength + 1]++;
+        }
+    }
+    for (int lbi = 0; lbi < localRows; lbi++) {
+        rowStart[lbi + 1] += rowStart[lbi];
+    }
+    long long* entryOffsets = malloc((rowStart[localRows] + 1)
+            * sizeof(long long));
+    int* entryWeights = malloc((rowStart[localRows] + 1) * sizeof(int));
+    int* fill = malloc((localRows + 1) * sizeof(int));
+    memcpy(fill, rowStart, (localRows + 1) * sizeof(int));
+    for (int e = 0; e < graph->edgeCount; e++) {
+        if (graph->edgeFrom[e] == graph->edgeTo[e]) continue;
+        for (int d = 0; d < directions; d++) {
+            int i = d == 0 ? graph->edgeFrom[e] : graph->edgeTo[e];
+            int j = d == 0 ? graph->edgeTo[e] : graph->edgeFrom[e];
+            long long offset = owned_tile_offset(i, j, gridRow, gridCol,
+                    gridRows, gridCols, localCols, blockSize);
+            if (offset == -1) continue;
+            int lbi = offset / rowLength;
+            entryOffsets[fill[lbi]] = offset - lbi * rowLength;
+            entryWeights[fill[lbi]] = graph->edgeWeights[e];
+            fill[lbi]++;
+        }
+    }
+
+    for (int lbi = 0; lbi < localRows; lbi++) {
+        init_tile_row(buffer, lbi, gridRow, gridCol, gridRows, gridCols,
+                localCols, blockSize);
+        for (int n = rowStart[lbi]; n < rowStart[lbi + 1]; n++) {
+            buffer[entryOffsets[n]] = entryWeights[n];
+        }
+        write_tiles(fd, buffer, rowLength, lbi * rowLength * sizeof(dist_t));
+    }
+    free(rowStart);
+    free(entryOffsets);
+    free(entryWeights);
+    free(fill);
+}
+
+/* Find the total and maximum shortest path length from every node.
+ *  Use blocked Floyd-Warshall over a 2D block-cyclic grid of ranks, as
+ *  blocked_all_pair_shortest_path does, but with each rank's tiles in a file.
+ *  Only the diagonal tile, the row and column panels and one row of tiles
+ *  are in memory at once. Rows of tiles are streamed through in order each
+ *  block-step, the kernel reading the next ahead while one is relaxed.
+ * Parameters:
+ *          graph - the graph in question
+ *          blockSize - the width of each square tile
+ *          directory - the directory to keep each rank's tiles in
+ *          comm - the communicator the ranks share
+ *          sums - out parameter on rank 0 holding the total of each row
+ *          maxes - out parameter on rank 0 holding the maximum of each row
+ */
+void out_of_core_all_pair_shortest_path(Graph* graph, int blockSize,
+        char* directory, MPI_Comm comm, long long* sums, long long* maxes) {
+    int rank, size;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &size);
+
+    // The same grid and communicators as the in-memory blocked solver
+    int dims[2] = {0, 0};
+    MPI_Dims_create(size, 2, dims);
+    int gridRows = dims[0];
+    int gridCols = dims[1];
+    int gridRow = rank / gridCols;
+    int gridCol = rank % gridCols;
+    MPI_Comm rowComm, colComm;
+    MPI_Comm_split(comm, gridRow, gridCol, &rowComm);
+    MPI_Comm_split(comm, gridCol, gridRow, &colComm);
+
+    int nodeCount = graph->nodeCount;
+    int blockCount = (nodeCount + blockSize - 1) / blockSize;
+    int localRows = local_block_count(gridRow, gridRows, blockCount);
+    int localCols = local_block_count(gridCol, gridCols, blockCount);
+    size_t tileArea = (size_t) blockSize * blockSize;
+    size_t rowLength = localCols * tileArea;
+    off_t rowBytes = rowLength * sizeof(dist_t);
+
+    PHASE_START(PHASE_MATRIX_INIT);
+    int fd = open_tile_store(directory, comm);
+    dist_t* buffer = alloc_aligned(rowLength > 0 ? rowLength : 1);
+    write_initial_tiles(graph, fd, buffer, gridRow, gridCol, gridRows,
+            gridCols, localRows, localCols, blockSize);
+    dist_t* diag = alloc_aligned(tileArea);
+    dist_t* rowPanel = alloc_aligned(rowLength > 0 ? rowLength : 1);
+    dist_t* colPanel = alloc_aligned(localRows * tileArea > 0
+            ? localRows * tileArea : 1);
+    PHASE_STOP(PHASE_MATRIX_INIT);
+
+    double com = 0;
+    // Loop over each block of intermediate nodes
+    for (int kb = 0; kb < blockCount; kb++) {
+        int ownerRow = kb % gridRows;
+        int ownerCol = kb % gridCols;
+        int localK = kb / gridRows;
+        int localKCol = kb / gridCols;
+
+        // Close the diagonal tile on its own
+        PHASE_START(PHASE_COMPUTE);
+        if (gridRow == ownerRow && gridCol == ownerCol) {
+            off_t offset = (localK * localCols + localKCol) * tileArea
+                    * sizeof(dist_t);
+            read_tiles(fd, diag, tileArea, offset);
+            fw_tile(diag, diag, diag, blockSize);
+            for (int t = 0; t < blockSize; t++) {
+                if (diag[t * blockSize + t] < 0) mark_negative_cycle();
+            }
+            write_tiles(fd, diag, tileArea, offset);
+        }
+        PHASE_STOP(PHASE_COMPUTE);
+
+        PHASE_START(PHASE_EXCHANGE);
+        double _startTime = MPI_Wtime();
+        if (gridRow == ownerRow) {
+            MPI_Bcast(diag, tileArea, MPI_DIST, ownerCol, rowComm);
+        }
+        if (gridCol == ownerCol) {
+            MPI_Bcast(diag, tileArea, MPI_DIST, ownerRow, colComm);
+        }
+        com += MPI_Wtime() - _startTime;
+        PHASE_STOP(PHASE_EXCHANGE);
+
+        // Relax the row and column panels through the diagonal tile, writing
+        // them back before the rest of the tiles are streamed
+        PHASE_START(PHASE_COMPUTE);
+        if (gridRow == ownerRow) {
+            read_tiles(fd, rowPanel, rowLength, localK * rowBytes);
+            #pragma omp parallel for
+            for (int lbj = 0; lbj < localCols; lbj++) {
+                if (lbj * gridCols + gridCol == kb) continue;
+                dist_t* tile = &rowPanel[lbj * tileArea];
+                fw_tile(tile, diag, tile, blockSize);
+            }
+            write_tiles(fd, rowPanel, rowLength, localK * rowBytes);
+        }
+        if (gridCol == ownerCol) {
+            for (int lbi = 0; lbi < localRows; lbi++) {
+                read_tiles(fd, &colPanel[lbi * tileArea], tileArea,
+                        (lbi * localCols + localKCol) * tileArea
+                        * sizeof(dist_t));
+            }
+            #pragma omp parallel for
+            for (int lbi = 0; lbi < localRows; lbi++) {
+                if (lbi * gridRows + gridRow == kb) continue;
+                dist_t* tile = &colPanel[lbi * tileArea];
+                fw_tile(tile, tile, diag, blockSize);
+            }
+            for (int lbi = 0; lbi < localRows; lbi++) {
+                write_tiles(fd, &colPanel[lbi * tileArea], tileArea,
+                        (lbi * localCols + localKCol) * tileArea
+                        * sizeof(dist_t));
+            }
+        }
+        PHASE_STOP(PHASE_COMPUTE);
+
+        PHASE_START(PHASE_EXCHANGE);
+        _startTime = MPI_Wtime();
+        MPI_Bcast(rowPanel, rowLength, MPI_DIST, ownerRow, colComm);
+        MPI_Bcast(colPanel, localRows * tileArea, MPI_DIST, ownerCol, rowComm);
+        com += MPI_Wtime() - _startTime;
+        PHASE_STOP(PHASE_EXCHANGE);
+
+        // Stream every other row of tiles through memory in file order
+        PHASE_START(PHASE_COMPUTE);
+        for (int lbi = 0; lbi < localRows; lbi++) {
+            if (lbi * gridRows + gridRow == kb) continue;
+            int next = lbi + 1;
+            if (next * gridRows + gridRow == kb) next++;
+            if (next < localRows) {
+                // Have the kernel read the next row while this one is relaxed
+                posix_fadvise(fd, next * rowBytes, rowBytes,
+                        POSIX_FADV_WILLNEED);
+            }
+            read_tiles(fd, buffer, rowLength, lbi * rowBytes);
+            #pragma omp parallel for schedule(dynamic)
+            for (int lbj = 0; lbj < localCols; lbj++) {
+                if (lbj * gridCols + gridCol == kb) continue;
+                fw_tile(&buffer[lbj * tileArea], &colPanel[lbi * tileArea],
+                        &rowPanel[lbj * tileArea], blockSize);
+            }
+            write_tiles(fd, buffer, rowLength, lbi * rowBytes);
+        }
+        PHASE_STOP(PHASE_COMPUTE);
+    }
+
+    free(diag);
+    free(rowPanel);
+    free(colPanel);
+    MPI_Comm_free(&rowComm);
+    MPI_Comm_free(&colComm);
+    timings.com = com;
+
+    // Ranks only hold pieces of each row, so reduce the pieces a row of tiles
+    // at a time then combine them across ranks
+    PHASE_START(PHASE_GATHER);
+    double startTime = MPI_Wtime();
+    long long* partialSums = calloc(nodeCount, sizeof(long long));
+    long long* partialMaxes = calloc(nodeCount, sizeof(long long));
+    for (int lbi = 0; lbi < localRows; lbi++) {
+        if (lbi + 1 < localRows) {
+            posix_fadvise(fd, (lbi + 1) * rowBytes, rowBytes,
+                    POSIX_FADV_WILLNEED);
+        }
+        read_tiles(fd, buffer, rowLength, lbi * rowBytes);
+        int rowOffset = (lbi * gridRows + gridRow) * blockSize;
+        #pragma omp parallel for
+        for (int ti = 0; ti < blockSize; ti++) {
+            int i = rowOffset + ti;
+            if (i >= nodeCount) continue;
+            for (int lbj = 0; lbj < localCols; lbj++) {
+                dist_t* tile = &buffer[lbj * tileArea];
+                int colOffset = (lbj * gridCols + gridCol) * blockSize;
+                for (int tj = 0; tj < blockSize
+                        && colOffset + tj < nodeCount; tj++) {
+                    dist_t value = tile[ti * blockSize + tj];
+                    if (value == DIST_INF) {
+                        partialMaxes[i] = LLONG_MAX;
+                        continue;
+                    }
+                    partialSums[i] += value;
+                    if (value > partialMaxes[i]) partialMaxes[i] = value;
+                }
+            }
+        }
+    }
+    reduce_partial_summaries(partialSums, partialMaxes, sums, maxes,
+            nodeCount, comm);
+    timings.gather = MPI_Wtime() - startTime;
+    PHASE_STOP(PHASE_GATHER);
+
+    free(partialSums);
+    free(partialMaxes);
+    free(buffer);
+    close(fd);
+}
@@ -0,0 +1,71 @@
+/* =============================================================================
+ * outofcore.h  Blocked Floyd-Warshall with each rank's tiles kept in a file
+ *              and streamed through memory, for matrices larger than RAM
+ * =============================================================================
+ */
+
+/* Read tiles from a tile store, exiting if they cannot be read.
+ * Parameters:
+ *          fd - the tile store
+ *          tiles - out parameter holding the tiles read
+ *          count - the number of distances to read
+ *          offset - the position in the store to read from, in bytes
+ */
+void read_tiles(int fd, dist_t* tiles, size_t count, off_t offset);
+
+/* Write tiles to a tile store, exiting if they cannot be written.
+ * Parameters:
+ *          fd - the tile store
+ *          tiles - the tiles to write
+ *          count - the number of distances to write
+ *          offset - the position in the store to write to, in bytes
+ */
+void write_tiles(int fd, dist_t* tiles, size_t count, off_t offset);
+
+/* Create this rank's tile store.
+ *  The file is unlinked as soon as it is open, so it never outlives the
+ *  solve, even one that is killed.
+ * Parameters:
+ *          directory - the directory to keep the store in, created if it
+ *                      does not exist
+ *          comm - the communicator the ranks share
+ * Return:
+ *          The file descriptor of the store.
+ */
+int open_tile_store(char* directory, MPI_Comm comm);
+
+/* Write a rank's tiles before any relaxation to its tile store.
+ *  Entries are bucketed by local block row in edge order, so each row is
+ *  built in memory once and later edges still overwrite earlier ones.
+ * Parameters:
+ *          graph - the graph in question
+ *          fd - the tile store
+ *          buffer - space for one row of tiles
+ *          gridRow - the rank's row in the process grid
+ *          gridCol - the rank's column in the process grid
+ *          gridRows - the number of rows in the process grid
+ *          gridCols - the number of columns in the process grid
+ *          localRows - the number of block rows the rank owns
+ *          localCols - the number of block columns the rank owns
+ *          blockSize - the width of each square tile
+ */
+void write_initial_tiles(Graph* graph, int fd, dist_t* buffer, int gridRow,
+        int gridCol, int gridRows, int gridCols, int localRows, int localCols,
+        int blockSize);
+
+/* Find the total and maximum shortest path length from every node.
+ *  Use blocked Floyd-Warshall over a 2D block-cyclic grid of ranks, as
+ *  blocked_all_pair_shortest_path does, but with each rank's tiles in a file.
+ *  Only the diagonal tile, the row and column panels and one row of tiles
+ *  are in memory at once. Rows of tiles are streamed through in order each
+ *  block-step, the kernel reading the next ahead while one is relaxed.
+ * Parameters:
+ *          graph - the graph in question
+ *          blockSize - the width of each square tile
+ *          directory - the directory to keep each rank's tiles in
+ *          comm - the communicator the ranks share
+ *          sums - out parameter on rank 0 holding the total of each row
+ *          maxes - out parameter on rank 0 holding the maximum of each row
+ */
+void out_of_core_all_pair_shortest_path(Graph* graph, int blockSize,
+        char* directory, MPI_Comm comm, long long* sums, long long* maxes);
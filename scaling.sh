@@ -0,0 +1,29 @@
+#!/bin/bash
+#SBATCH --time=1:0:00
+#SBATCH --job-name=centrality-scaling
+#SBATCH --nodes=2
+#SBATCH --ntasks=2
+#SBATCH --ntasks-per-node=1
+#SBATCH --cpus-per-task=8
+#SBATCH --partition=cosc
+#SBATCH --mem 4000
+
+# Report solver time across OMP_NUM_THREADS values, up to the cores per task.
+# Results are printed as CSV rather than kept, so submit this on the cluster
+# being measured.
+# Usage: scaling.sh [graph-file] [solver options...]
+
+GRAPH=${1:-test/complete_5000.graph}
+shift
+CORES=${SLURM_CPUS_PER_TASK:-$(nproc)}
+
+#module load openmpi-x86_64
+echo "threads,com,seconds"
+for THREADS in 1 2 4 8 16 32; do
+    if [ $THREADS -gt $CORES ]; then
+        break
+    fi
+    export OMP_NUM_THREADS=$THREADS
+    echo -n "$THREADS,"
+    mpirun -n 2 ./centrality-solver "$@" $GRAPH
+done
@@ -0,0 +1,195 @@
+/* =============================================================================
+ * shared.c     Memory shared between the ranks on each host through MPI-3
+ *              shared windows, so a host holds one copy of read-only data
+ * =============================================================================
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <mpi.h>
+#include "helper.h"
+#include "io.h"
+#include "shared.h"
+
+/* Split ranks by the host they run on.
+ * Parameters:
+ *          comm - the communicator the ranks share
+ *          hostComm - out parameter holding the ranks on this rank's host
+ *          leaderComm - out parameter holding the first rank of every host,
+ *                       in order of rank, or MPI_COMM_NULL on other ranks
+ */
+void split_host_comms(MPI_Comm comm, MPI_Comm* hostComm,
+        MPI_Comm* leaderComm) {
+    int rank, hostRank;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_split_type(comm, MPI_COMM_TYPE_SHARED, rank, MPI_INFO_NULL,
+            hostComm);
+    MPI_Comm_rank(*hostComm, &hostRank);
+    // Rank 0 is first on its host, so it leads it and is leader 0
+    MPI_Comm_split(comm, hostRank == 0 ? 0 : MPI_UNDEFINED, rank, leaderComm);
+}
+
+/* Free the communicators from split_host_comms.
+ * Parameters:
+ *          hostComm - the ranks on this rank's host, MPI_COMM_NULL once freed
+ *          leaderComm - the first rank of every host, MPI_COMM_NULL once freed
+ */
+void free_host_comms(MPI_Comm* hostComm, MPI_Comm* leaderComm) {
+    MPI_Comm_free(hostComm);
+    if (*leaderComm != MPI_COMM_NULL) MPI_Comm_free(leaderComm);
+}
+
+/* Allocate memory shared by every rank on a host.
+ *  It is all allocated by the host's first rank, and every rank gets its
+ *  own address for it, aligned to MATRIX_ALIGNMENT bytes.
+ * Parameters:
+ *          bytes - the size of the memory
+ *          hostComm - the ranks on the host
+ *          window - out parameter holding the window of the memory, locked
+ *                   for host_sync until released with free_host_shared
+ * Return:
+ *          This rank's address for the memory.
+ */
+void* alloc_host_shared(size_t bytes, MPI_Comm hostComm, MPI_Win* window) {
+    int hostRank;
+    MPI_Comm_rank(hostComm, &hostRank);
+    char* base;
+    // Each rank maps the memory at a page boundary of its own, so rounding
+    // every address up the same way finds the same aligned start
+    MPI_Win_allocate_shared(hostRank == 0 ? bytes + MATRIX_ALIGNMENT : 0, 1,
+            MPI_INFO_NULL, hostComm, &base, window);
+    MPI_Aint size;
+    int unit;
+    MPI_Win_shared_query(*window, 0, &size, &unit, &base);
+    MPI_Win_lock_all(MPI_MODE_NOCHECK, *window);
+    uintptr_t address = (uintptr_t) base;
+    return base + (MATRIX_ALIGNMENT - address % MATRIX_ALIGNMENT)
+            % MATRIX_ALIGNMENT;
+}
+
+/* Wait for every rank on a host, making their writes to shared memory
+ *  visible to each other.
+ * Parameters:
+ *          window - the window of the shared memory
+ *          hostComm - the ranks on the host
+ */
+void host_sync(MPI_Win window, MPI_Comm hostComm) {
+    MPI_Win_sync(window);
+    MPI_Barrier(hostComm);
+    MPI_Win_sync(window);
+}
+
+/* Release memory from alloc_host_shared, on every rank on the host.
+ * Parameters:
+ *          window - the window of the memory
+ */
+void free_host_shared(MPI_Win window) {
+    MPI_Win_unlock_all(window);
+    MPI_Win_free(&window);
+}
+
+/* Read a graph on rank 0 and share it with every other rank, one copy per
+ *  host. The first rank on each host receives the edges and labels into
+ *  memory shared with the rest of its host. Binary graphs are memory-mapped
+ *  as by read_graph, which already shares their pages.
+ * Parameters:
+ *          filename - the path and name of the file
+ *          comm - the communicator the ranks share
+ *          hostComm - the ranks on this rank's host
+ *          leaderComm - the first rank of every host, MPI_COMM_NULL elsewhere
+ *          window - out parameter holding the window of the shared graph,
+ *                   or MPI_WIN_NULL if the graph is memory-mapped
+ * Return:
+ *          A fully constructed graph, whose edges must not be changed, or
+ *          NULL on every rank if the file could not be read.
+ */
+Graph* read_shared_graph(char* filename, MPI_Comm comm, MPI_Comm hostComm,
+        MPI_Comm leaderComm, MPI_Win* window) {
+    int rank;
+    MPI_Comm_rank(comm, &rank);
+
+    int binary = 0;
+    if (rank == 0) {
+        FILE* file = fopen(filename, "r");
+        char magic[sizeof(BINARY_GRAPH_MAGIC) - 1];
+        binary = file != NULL
+                && fread(magic, 1, sizeof(magic), file) == sizeof(magic)
+                && memcmp(magic, BINARY_GRAPH_MAGIC, sizeof(magic)) == 0;
+        if (file != NULL) fclose(file);
+    }
+    MPI_Bcast(&binary, 1, MPI_INT, 0, comm);
+    if (binary) {
+        *window = MPI_WIN_NULL;
+        return agree_graph(read_binary_file(filename), comm);
+    }
+
+    Graph* graph = NULL;
+    int header[3] = {0, 0, 0};
+    if (rank == 0) graph = read_file(filename);
+    int failed = rank == 0 && graph == NULL;
+    MPI_Bcast(&failed, 1, MPI_INT, 0, comm);
+    if (failed) {
+        *window = MPI_WIN_NULL;
+        return NULL;
+    }
+    if (rank == 0) {
+        header[0] = graph->nodeCount;
+        header[1] = graph->edgeCount;
+        for (int i = 0; i < graph->nodeCount; i++) {
+            header[2] += strlen(graph->nodeLabels[i]) + 1;
+        }
+    } else {
+        graph = malloc(sizeof(Graph));
+        graph->connections = NULL;
+        graph->directed = 0;
+    }
+    graph->storage = GRAPH_SHARED;
+    MPI_Bcast(header, 3, MPI_INT, 0, comm);
+    graph->nodeCount = header[0];
+    graph->edgeCount = header[1];
+
+    // Edge sources, targets and weights, then the labels NUL-terminated, as
+    // in the binary format
+    size_t edgeBytes = (size_t) graph->edgeCount * sizeof(int);
+    char* data = alloc_host_shared(3 * edgeBytes + header[2], hostComm,
+            window);
+    int* edgeFrom = (int*) data;
+    int* edgeTo = (int*) (data + edgeBytes);
+    int* edgeWeights = (int*) (data + 2 * edgeBytes);
+    char* labels = data + 3 * edgeBytes;
+    if (rank == 0) {
+        memcpy(edgeFrom, graph->edgeFrom, edgeBytes);
+        memcpy(edgeTo, graph->edgeTo, edgeBytes);
+        memcpy(edgeWeights, graph->edgeWeights, edgeBytes);
+        char* label = labels;
+        for (int i = 0; i < graph->nodeCount; i++) {
+            strcpy(label, graph->nodeLabels[i]);
+            label += strlen(label) + 1;
+            free(graph->nodeLabels[i]);
+        }
+        free(graph->nodeLabels);
+        free(graph->edgeFrom);
+        free(graph->edgeTo);
+        free(graph->edgeWeights);
+    }
+    // Only hosts exchange the graph, the rest of each host reading its copy
+    if (leaderComm != MPI_COMM_NULL) {
+        MPI_Bcast(edgeFrom, graph->edgeCount, MPI_INT, 0, leaderComm);
+        MPI_Bcast(edgeTo, graph->edgeCount, MPI_INT, 0, leaderComm);
+        MPI_Bcast(edgeWeights, graph->edgeCount, MPI_INT, 0, leaderComm);
+        MPI_Bcast(labels, header[2], MPI_CHAR, 0, leaderComm);
+    }
+    host_sync(*window, hostComm);
+
+    graph->edgeFrom = edgeFrom;
+    graph->edgeTo = edgeTo;
+    graph->edgeWeights = edgeWeights;
+    graph->nodeLabels = malloc(graph->nodeCount * sizeof(char*));
+    char* label = labels;
+    for (int i = 0; i < graph->nodeCount; i++) {
+        graph->nodeLabels[i] = label;
+        label += strlen(label) + 1;
+    }
+    return graph;
+}
@@ -0,0 +1,67 @@
+/* =============================================================================
+ * shared.h     Memory shared between the ranks on each host through MPI-3
+ *              shared windows, so a host holds one copy of read-only data
+ * =============================================================================
+ */
+
+/* Split ranks by the host they run on.
+ * Parameters:
+ *          comm - the communicator the ranks share
+ *          hostComm - out parameter holding the ranks on this rank's host
+ *          leaderComm - out parameter holding the first rank of every host,
+ *                       in order of rank, or MPI_COMM_NULL on other ranks
+ */
+void split_host_comms(MPI_Comm comm, MPI_Comm* hostComm,
+        MPI_Comm* leaderComm);
+
+/* Free the communicators from split_host_comms.
+ * Parameters:
+ *          hostComm - the ranks on this rank's host, MPI_COMM_NULL once freed
+ *          leaderComm - the first rank of every host, MPI_COMM_NULL once freed
+ */
+void free_host_comms(MPI_Comm* hostComm, MPI_Comm* leaderComm);
+
+/* Allocate memory shared by every rank on a host.
+ *  It is all allocated by the host's first rank, and every rank gets its
+ *  own address for it, aligned to MATRIX_ALIGNMENT bytes.
+ * Parameters:
+ *          bytes - the size of the memory
+ *          hostComm - the ranks on the host
+ *          window - out parameter holding the window of the memory, locked
+ *                   for host_sync until released with free_host_shared
+ * Return:
+ *          This rank's address for the memory.
+ */
+void* alloc_host_shared(size_t bytes, MPI_Comm hostComm, MPI_Win* window);
+
+/* Wait for every rank on a host, making their writes to shared memory
+ *  visible to each other.
+ * Parameters:
+ *          window - the window of the shared memory
+ *          hostComm - the ranks on the host
+ */
+void host_sync(MPI_Win window, MPI_Comm hostComm);
+
+/* Release memory from alloc_host_shared, on every rank on the host.
+ * Parameters:
+ *          window - the window of the memory
+ */
+void free_host_shared(MPI_Win window);
+
+/* Read a graph on rank 0 and share it with every other rank, one copy per
+ *  host. The first rank on each host receives the edges and labels into
+ *  memory shared with the rest of its host. Binary graphs are memory-mapped
+ *  as by read_graph, which already shares their pages.
+ * Parameters:
+ *          filename - the path and name of the file
+ *          comm - the communicator the ranks share
+ *          hostComm - the ranks on this rank's host
+ *          leaderComm - the first rank of every host, MPI_COMM_NULL elsewhere
+ *          window - out parameter holding the window of the shared graph,
+ *                   or MPI_WIN_NULL if the graph is memory-mapped
+ * Return:
+ *          A fully constructed graph, whose edges must not be changed, or
+ *          NULL on every rank if the file could not be read.
+ */
+Graph* read_shared_graph(char* filename, MPI_Comm comm, MPI_Comm hostComm,
+        MPI_Comm leaderComm, MPI_Win* window);
@@ -0,0 +1,564 @@
+/* =============================================================================
+ * sparse.c     Sparse-graph engine, running Dijkstra from every source over a
+ *              compressed sparse row adjacency
+ * =============================================================================
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <limits.h>
+#include <omp.h>
+#include <mpi.h>
+#include "helper.h"
+#include "instrument.h"
+#include "balance.h"
+#include "sparse.h"
+
+/* Order adjacency entries by neighbour, then by position in the input.
+ * Parameters:
+ *          a - the first adjacency entry
+ *          b - the second adjacency entry
+ * Return:
+ *          Negative, zero or positive as a sorts before, with or after b.
+ */
+int compare_adjacency(const void* a, const void* b) {
+    const AdjacencyEntry* entryA = a;
+    const AdjacencyEntry* entryB = b;
+    if (entryA->to != entryB->to) return entryA->to < entryB->to ? -1 : 1;
+    return (entryA->order > entryB->order) - (entryA->order < entryB->order);
+}
+
+/* Build the compressed sparse row adjacency of a graph.
+ *  Edges are stored in both directions unless the graph is directed,
+ *  self-loops are dropped, and where an edge is given more than once the last
+ *  weight wins, as in the dense matrix.
+ * Parameters:
+ *          graph - the graph in question
+ * Return:
+ *          The adjacency of the graph.
+ */
+CSRGraph* build_csr(Graph* graph) {
+    int nodeCount = graph->nodeCount;
+    CSRGraph* csr = malloc(sizeof(CSRGraph));
+    csr->nodeCount = nodeCount;
+    csr->rowStart = calloc(nodeCount + 1, sizeof(int));
+
+    // Count degrees, then prefix sum into row offsets
+    for (int e = 0; e < graph->edgeCount; e++) {
+        if (graph->edgeFrom[e] == graph->edgeTo[e]) continue;
+        csr->rowStart[graph->edgeFrom[e] + 1]++;
+        if (!graph->directed) csr->rowStart[graph->edgeTo[e] + 1]++;
+    }
+    for (int i = 0; i < nodeCount; i++) {
+        csr->rowStart[i + 1] += csr->rowStart[i];
+    }
+
+    AdjacencyEntry* entries = malloc((csr->rowStart[nodeCount] + 1)
+            * sizeof(AdjacencyEntry));
+    int* fill = malloc(nodeCount * sizeof(int));
+    for (int i = 0; i < nodeCount; i++) {
+        fill[i] = csr->rowStart[i];
+    }
+    for (int e = 0; e < graph->edgeCount; e++) {
+        int from = graph->edgeFrom[e];
+        int to = graph->edgeTo[e];
+        if (from == to) continue;
+        entries[fill[from]++] = (AdjacencyEntry) {to, graph->edgeWeights[e], e};
+        if (!graph->directed) {
+            entries[fill[to]++] = (AdjacencyEntry) {from, graph->edgeWeights[e],
+                    e};
+        }
+    }
+
+    // Sort each row so repeated edges are adjacent, then keep only the last
+    #pragma omp parallel for schedule(dynamic, 64)
+    for (int i = 0; i < nodeCount; i++) {
+        qsort(&entries[csr->rowStart[i]], csr->rowStart[i + 1]
+                - csr->rowStart[i], sizeof(AdjacencyEntry), compare_adjacency);
+    }
+    csr->neighbours = malloc((csr->rowStart[nodeCount] + 1) * sizeof(int));
+    csr->weights = malloc((csr->rowStart[nodeCount] + 1) * sizeof(dist_t));
+    int count = 0;
+    int rowBegin = 0;
+    for (int i = 0; i < nodeCount; i++) {
+        int rowEnd = csr->rowStart[i + 1];
+        csr->rowStart[i] = count;
+        for (int e = rowBegin; e < rowEnd; e++) {
+            if (e + 1 < rowEnd && entries[e + 1].to == entries[e].to) continue;
+            csr->neighbours[count] = entries[e].to;
+            csr->weights[count] = entries[e].weight;
+            count++;
+        }
+        rowBegin = rowEnd;
+    }
+    csr->rowStart[nodeCount] = count;
+
+    free(fill);
+    free(entries);
+    return csr;
+}
+
+/* Free a compressed sparse row adjacency.
+ * Parameters:
+ *          csr - the adjacency to be freed
+ */
+void free_csr(CSRGraph* csr) {
+    free(csr->rowStart);
+    free(csr->neighbours);
+    free(csr->weights);
+    free(csr);
+}
+
+/* Restore the heap property by moving an entry towards the root.
+ * Parameters:
+ *          heap - the heap of node ids
+ *          heapPos - the position of each node in the heap
+ *          dist - the key of each node
+ *          index - the position of the entry being moved
+ */
+void heap_sift_up(int* heap, int* heapPos, dist_t* dist, int index) {
+    int node = heap[index];
+    while (index > 0) {
+        int parent = (index - 1) / 2;
+        if (dist[heap[parent]] <= dist[node]) break;
+        heap[index] = heap[parent];
+        heapPos[heap[index]] = index;
+        index = parent;
+    }
+    heap[index] = node;
+    heapPos[node] = index;
+}
+
+/* Restore the heap property by moving an entry away from the root.
+ * Parameters:
+ *          heap - the heap of node ids
+ *          heapPos - the position of each node in the heap
+ *          dist - the key of each node
+ *          heapSize - the number of entries in the heap
+ *          index - the position of the entry being moved
+ */
+void heap_sift_down(int* heap, int* heapPos, dist_t* dist, int heapSize,
+        int index) {
+    int node = heap[index];
+    while (2 * index + 1 < heapSize) {
+        int child = 2 * index + 1;
+        if (child + 1 < heapSize && dist[heap[child + 1]] < dist[heap[child]]) {
+            child++;
+        }
+        if (dist[node] <= dist[heap[child]]) break;
+        heap[index] = heap[child];
+        heapPos[heap[index]] = index;
+        index = child;
+    }
+    heap[index] = node;
+    heapPos[node] = index;
+}
+
+/* Find the shortest paths from one node to every other node.
+ *  Use Dijkstra's algorithm with an indexed binary heap, which requires
+ *  non-negative edge weights. With checkedDistances, nodes only reached by
+ *  paths too long for dist_t are marked with mark_distance_overflow.
+ * Parameters:
+ *          csr - the adjacency of the graph
+ *          source - the node the paths start from
+ *          dist - out parameter holding the length of each shortest path,
+ *                 DIST_INF where there is none
+ *          heap - workspace for the heap, one entry per node
+ *          heapPos - workspace for heap positions, one entry per node
+ */
+void dijkstra(CSRGraph* csr, int source, dist_t* dist, int* heap,
+        int* heapPos) {
+    // Heap position -1 marks an unseen node, -2 a settled one, and -3 one
+    // reached only by paths too long to hold
+    for (int i = 0; i < csr->nodeCount; i++) {
+        dist[i] = DIST_INF;
+        heapPos[i] = -1;
+    }
+    dist[source] = 0;
+    heap[0] = source;
+    heapPos[source] = 0;
+    int heapSize = 1;
+
+    while (heapSize > 0) {
+        int u = heap[0];
+        heapPos[u] = -2;
+        heapSize--;
+        if (heapSize > 0) {
+            heap[0] = heap[heapSize];
+            heapPos[heap[0]] = 0;
+            heap_sift_down(heap, heapPos, dist, heapSize, 0);
+        }
+
+        for (int e = csr->rowStart[u]; e < csr->rowStart[u + 1]; e++) {
+            int v = csr->neighbours[e];
+            if (heapPos[v] == -2) continue;
+            dist_t candidate;
+            if (!checkedDistances) {
+                candidate = dist[u] + csr->weights[e];
+            } else if (add_distances(dist[u], csr->weights[e], &candidate)) {
+                // Paths too long to hold are left out, which only loses a
+                // shortest path if the node is reached no other way
+                if (heapPos[v] == -1) heapPos[v] = -3;
+                continue;
+            }
+            if (candidate < dist[v]) {
+                dist[v] = candidate;
+                if (heapPos[v] < 0) {
+                    heap[heapSize] = v;
+                    heapPos[v] = heapSize;
+                    heapSize++;
+                }
+                heap_sift_up(heap, heapPos, dist, heapPos[v]);
+            }
+        }
+    }
+    if (!checkedDistances) return;
+    for (int i = 0; i < csr->nodeCount; i++) {
+        if (heapPos[i] == -3) mark_distance_overflow();
+    }
+}
+
+/* Count the nodes a search from one node reaches, ignoring weights.
+ * Parameters:
+ *          csr - the adjacency of the graph
+ *          source - the node the search starts from
+ * Return:
+ *          The number of nodes reached, the source included.
+ */
+int reachable_count(CSRGraph* csr, int source) {
+    char* seen = calloc(csr->nodeCount, sizeof(char));
+    int* queue = malloc(csr->nodeCount * sizeof(int));
+    int head = 0;
+    int tail = 0;
+    queue[tail++] = source;
+    seen[source] = 1;
+    while (head < tail) {
+        int u = queue[head++];
+        for (int e = csr->rowStart[u]; e < csr->rowStart[u + 1]; e++) {
+            int v = csr->neighbours[e];
+            if (seen[v]) continue;
+            seen[v] = 1;
+            queue[tail++] = v;
+        }
+    }
+    free(seen);
+    free(queue);
+    return tail;
+}
+
+/* Check whether a graph has few enough edges for per-source searches.
+ * Parameters:
+ *          graph - the graph in question
+ * Return:
+ *          1 if the graph has under |V|^2 / SPARSE_DENSITY_RATIO edges, 0
+ *          otherwise.
+ */
+int is_sparse(Graph* graph) {
+    double nodeCount = graph->nodeCount;
+    return graph->edgeCount * (double) SPARSE_DENSITY_RATIO 
+            < nodeCount * nodeCount;
+}
+
+/* Decide whether a graph should be solved with the sparse engine.
+ * Parameters:
+ *          graph - the graph in question
+ * Return:
+ *          1 if the graph is sparse with non-negative weights, 0 otherwise.
+ */
+int prefer_sparse(Graph* graph) {
+    return !has_negative_weights(graph) && is_sparse(graph);
+}
+
+/* Populate matrix of shortest paths between all pairs of nodes.
+ *  Use Dijkstra from every source, with sources partitioned over ranks and
+ *  shared dynamically between threads, for O(|V||E|log|V|) time.
+ * Parameters:
+ *          graph - the graph in question
+ *          dynamic - whether ranks claim sources as they go rather than
+ *                    taking an equal share each
+ *          comm - the communicator the ranks share
+ *          sums - if not NULL, out parameter on rank 0 holding the total of
+ *                 each row, gathered in place of the matrix
+ *          maxes - if not NULL, out parameter on rank 0 holding the maximum
+ *                  of each row, gathered in place of the matrix
+ * Return:
+ *          On rank 0, a matrix containing the length of the shortest paths
+ *          between all nodes, or NULL if row summaries were gathered instead.
+ *          NULL on every other rank.
+ */
+dist_t** sparse_all_pair_shortest_path(Graph* graph, int dynamic,
+        MPI_Comm comm, long long* sums, long long* maxes) {
+    PHASE_START(PHASE_MATRIX_INIT);
+    CSRGraph* csr = build_csr(graph);
+    PHASE_STOP(PHASE_MATRIX_INIT);
+    // Sources are independent, so the only communication is the gather
+    timings.com = 0;
+    dist_t** dist = dynamic
+            ? dynamic_csr_all_pair_shortest_path(csr, NULL, comm, sums, maxes)
+            : csr_all_pair_shortest_path(csr, NULL, comm, sums, maxes);
+    free_csr(csr);
+    return dist;
+}
+
+/* Populate matrix of shortest paths between all pairs of nodes of an
+ *  adjacency.
+ *  Use Dijkstra from every source, with sources partitioned over ranks and
+ *  shared dynamically between threads, for O(|V||E|log|V|) time.
+ * Parameters:
+ *          csr - the adjacency of the graph, with non-negative weights
+ *          potentials - if not NULL, the potentials the weights were
+ *                       reweighted by, which are undone in each row
+ *          comm - the communicator the ranks share
+ *          sums - if not NULL, out parameter on rank 0 holding the total of
+ *                 each row, gathered in place of the matrix
+ *          maxes - if not NULL, out parameter on rank 0 holding the maximum
+ *                  of each row, gathered in place of the matrix
+ * Return:
+ *          On rank 0, a matrix containing the length of the shortest paths
+ *          between all nodes, or NULL if row summaries were gathered instead.
+ *          NULL on every other rank.
+ */
+dist_t** csr_all_pair_shortest_path(CSRGraph* csr, dist_t* potentials,
+        MPI_Comm comm, long long* sums, long long* maxes) {
+    int rank, size;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &size);
+    int nodeCount = csr->nodeCount;
+
+    PHASE_START(PHASE_MATRIX_INIT);
+    int start, end;
+    set_partition(rank, size, nodeCount, &start, &end);
+
+    // Rows are independent, so only rank 0 needs space for all of them, and
+    // when streaming each row is reduced as soon as its search finishes
+    dist_t** dist = NULL;
+    dist_t** ownRows = NULL;
+    long long* localSums = NULL;
+    long long* localMaxes = NULL;
+    if (sums != NULL) {
+        localSums = malloc((end - start + 1) * sizeof(long long));
+        localMaxes = malloc((end - start + 1) * sizeof(long long));
+    } else if (rank == 0) {
+        dist = alloc_matrix(nodeCount, nodeCount);
+    } else {
+        ownRows = alloc_matrix(end - start + 1, nodeCount);
+        dist = calloc(nodeCount, sizeof(dist_t*));
+        for (int i = start; i <= end; i++) {
+            dist[i] = ownRows[i - start];
+        }
+    }
+    PHASE_STOP(PHASE_MATRIX_INIT);
+
+    // Each search is a whole row, so compute is timed over all of them
+    PHASE_START(PHASE_COMPUTE);
+    #pragma omp parallel
+    {
+        int* heap = malloc(nodeCount * sizeof(int));
+        int* heapPos = malloc(nodeCount * sizeof(int));
+        dist_t* row = sums != NULL ? malloc(nodeCount * sizeof(dist_t)) : NULL;
+        // Search cost varies by source, so hand them out dynamically
+        #pragma omp for schedule(dynamic, 4)
+        for (int i = start; i <= end; i++) {
+            dist_t* target = sums != NULL ? row : dist[i];
+            dijkstra(csr, i, target, heap, heapPos);
+            if (potentials != NULL) {
+                // d(i, j) = d'(i, j) - h(i) + h(j) under reweighting by h
+                for (int j = 0; j < nodeCount; j++) {
+                    if (target[j] == DIST_INF) continue;
+                    if (!checkedDistances) {
+                        target[j] += potentials[j] - potentials[i];
+                    } else if (add_distances(target[j], potentials[j]
+                            - potentials[i], &target[j])) {
+                        mark_distance_overflow();
+                    }
+                }
+            }
+            if (sums != NULL) {
+                summarise_row(row, nodeCount, &localSums[i - start],
+                        &localMaxes[i - start]);
+            }
+        }
+        free(heap);
+        free(heapPos);
+        free(row);
+    }
+    PHASE_STOP(PHASE_COMPUTE);
+
+    PHASE_START(PHASE_GATHER);
+    double startTime = MPI_Wtime();
+    if (sums != NULL) {
+        gather_row_summaries(localSums, localMaxes, sums, maxes,
+                nodeCount, comm);
+        timings.gather = MPI_Wtime() - startTime;
+        PHASE_STOP(PHASE_GATHER);
+        free(localSums);
+        free(localMaxes);
+        return NULL;
+    }
+
+    // Collect on rank 0 only since we only need to process once.
+    if (rank == 0) {
+        for (int i = end+1; i < nodeCount; i++) {
+            MPI_Recv(dist[i], nodeCount, MPI_DIST, MPI_ANY_SOURCE, i, 
+                    comm, MPI_STATUS_IGNORE);
+        }
+    } else {
+        for (int i = start; i <= end; i++) {
+            MPI_Send(dist[i], nodeCount, MPI_DIST, 0, i, comm);
+        }
+        free_matrix(ownRows);
+        free(dist);
+        dist = NULL;
+    }
+    timings.gather = MPI_Wtime() - startTime;
+    PHASE_STOP(PHASE_GATHER);
+
+    return dist;
+}
+
+/* Populate matrix of shortest paths between all pairs of nodes of an
+ *  adjacency, with sources handed out on demand.
+ *  As csr_all_pair_shortest_path, but rather than an equal share each, ranks
+ *  claim chunks of sources from a shared counter until none are left, so
+ *  faster ranks search more. Chunks shrink as sources run out, so the ranks
+ *  finish close together.
+ * Parameters:
+ *          csr - the adjacency of the graph, with non-negative weights
+ *          potentials - if not NULL, the potentials the weights were
+ *                       reweighted by, which are undone in each row
+ *          comm - the communicator the ranks share
+ *          sums - if not NULL, out parameter on rank 0 holding the total of
+ *                 each row, gathered in place of the matrix
+ *          maxes - if not NULL, out parameter on rank 0 holding the maximum
+ *                  of each row, gathered in place of the matrix
+ * Return:
+ *          On rank 0, a matrix containing the length of the shortest paths
+ *          between all nodes, or NULL if row summaries were gathered instead.
+ *          NULL on every other rank.
+ */
+dist_t** dynamic_csr_all_pair_shortest_path(CSRGraph* csr,
+        dist_t* potentials, MPI_Comm comm, long long* sums, long long* maxes) {
+    int rank, size;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &size);
+    int nodeCount = csr->nodeCount;
+
+    PHASE_START(PHASE_MATRIX_INIT);
+    // Which rows a rank searches is only known as it claims them, so
+    // summaries cover every row, left empty where another rank searched it
+    dist_t** dist = NULL;
+    long long* partialSums = NULL;
+    long long* partialMaxes = NULL;
+    if (sums != NULL) {
+        partialSums = malloc(nodeCount * sizeof(long long));
+        partialMaxes = malloc(nodeCount * sizeof(long long));
+        for (int i = 0; i < nodeCount; i++) {
+            partialSums[i] = 0;
+            partialMaxes[i] = LLONG_MIN;
+        }
+    } else if (rank == 0) {
+        dist = alloc_matrix(nodeCount, nodeCount);
+    } else {
+        dist = calloc(nodeCount, sizeof(dist_t*));
+    }
+    MPI_Win counter = create_work_counter(comm);
+    PHASE_STOP(PHASE_MATRIX_INIT);
+
+    PHASE_START(PHASE_COMPUTE);
+    int first = 0;
+    int last = -1;
+    int claimed = 0;
+    int searched = 0;
+    #pragma omp parallel
+    {
+        int* heap = malloc(nodeCount * sizeof(int));
+        int* heapPos = malloc(nodeCount * sizeof(int));
+        dist_t* row = sums != NULL ? malloc(nodeCount * sizeof(dist_t)) : NULL;
+        while (1) {
+            // Only the master thread may communicate
+            #pragma omp master
+            {
+                int chunk = (nodeCount - claimed)
+                        / (SOURCE_CHUNK_DIVISOR * size);
+                if (chunk < omp_get_num_threads()) {
+                    chunk = omp_get_num_threads();
+                }
+                first = claim_work(counter, chunk);
+                last = first + chunk < nodeCount ? first + chunk - 1
+                        : nodeCount - 1;
+                claimed = first + chunk;
+                for (int i = first; i <= last; i++) {
+                    if (dist != NULL && dist[i] == NULL) {
+                        dist[i] = malloc(nodeCount * sizeof(dist_t));
+                    }
+                }
+                if (first <= last) searched += last - first + 1;
+            }
+            #pragma omp barrier
+            if (first >= nodeCount) break;
+
+            #pragma omp for schedule(dynamic, 1)
+            for (int i = first; i <= last; i++) {
+                dist_t* target = sums != NULL ? row : dist[i];
+                dijkstra(csr, i, target, heap, heapPos);
+                if (potentials != NULL) {
+                    // d(i, j) = d'(i, j) - h(i) + h(j) under reweighting by h
+                    for (int j = 0; j < nodeCount; j++) {
+                        if (target[j] == DIST_INF) continue;
+                        if (!checkedDistances) {
+                            target[j] += potentials[j] - potentials[i];
+                        } else if (add_distances(target[j], potentials[j]
+                                - potentials[i], &target[j])) {
+                            mark_distance_overflow();
+                        }
+                    }
+                }
+                if (sums != NULL) {
+                    summarise_row(row, nodeCount, &partialSums[i],
+                            &partialMaxes[i]);
+                }
+            }
+        }
+        free(heap);
+        free(heapPos);
+        free(row);
+    }
+    free_work_counter(counter);
+    PHASE_STOP(PHASE_COMPUTE);
+
+    PHASE_START(PHASE_GATHER);
+    double startTime = MPI_Wtime();
+    if (sums != NULL) {
+        reduce_partial_summaries(partialSums, partialMaxes, sums, maxes,
+                nodeCount, comm);
+        timings.gather = MPI_Wtime() - startTime;
+        PHASE_STOP(PHASE_GATHER);
+        free(partialSums);
+        free(partialMaxes);
+        return NULL;
+    }
+
+    // Each row is tagged with its index, since rank 0 cannot know who
+    // searched it
+    if (rank == 0) {
+        for (int received = searched; received < nodeCount; received++) {
+            MPI_Status status;
+            MPI_Probe(MPI_ANY_SOURCE, MPI_ANY_TAG, comm, &status);
+            MPI_Recv(dist[status.MPI_TAG], nodeCount, MPI_DIST,
+                    status.MPI_SOURCE, status.MPI_TAG, comm,
+                    MPI_STATUS_IGNORE);
+        }
+    } else {
+        for (int i = 0; i < nodeCount; i++) {
+            if (dist[i] != NULL) {
+                MPI_Send(dist[i], nodeCount, MPI_DIST, 0, i, comm);
+                free(dist[i]);
+            }
+        }
+        free(dist);
+        dist = NULL;
+    }
+    timings.gather = MPI_Wtime() - startTime;
+    PHASE_STOP(PHASE_GATHER);
+
+    return dist;
+}
@@ -0,0 +1,169 @@
+/* =============================================================================
+ * sparse.h     Sparse-graph engine, running Dijkstra from every source over a
+ *              compressed sparse row adjacency
+ * =============================================================================
+ */
+
+// Graphs with fewer than |V|^2 / SPARSE_DENSITY_RATIO edges are solved with
+// per-source Dijkstra rather than Floyd-Warshall when the algorithm is
+// automatic
+#define SPARSE_DENSITY_RATIO 32
+
+/* An entry in the adjacency of a node, before duplicate edges are removed.
+ */
+typedef struct {
+    int to;
+    int weight;
+    int order;
+} AdjacencyEntry;
+
+/* Order adjacency entries by neighbour, then by position in the input.
+ * Parameters:
+ *          a - the first adjacency entry
+ *          b - the second adjacency entry
+ * Return:
+ *          Negative, zero or positive as a sorts before, with or after b.
+ */
+int compare_adjacency(const void* a, const void* b);
+
+/* Build the compressed sparse row adjacency of a graph.
+ *  Edges are stored in both directions unless the graph is directed,
+ *  self-loops are dropped, and where an edge is given more than once the last
+ *  weight wins, as in the dense matrix.
+ * Parameters:
+ *          graph - the graph in question
+ * Return:
+ *          The adjacency of the graph.
+ */
+CSRGraph* build_csr(Graph* graph);
+
+/* Free a compressed sparse row adjacency.
+ * Parameters:
+ *          csr - the adjacency to be freed
+ */
+void free_csr(CSRGraph* csr);
+
+/* Restore the heap property by moving an entry towards the root.
+ * Parameters:
+ *          heap - the heap of node ids
+ *          heapPos - the position of each node in the heap
+ *          dist - the key of each node
+ *          index - the position of the entry being moved
+ */
+void heap_sift_up(int* heap, int* heapPos, dist_t* dist, int index);
+
+/* Restore the heap property by moving an entry away from the root.
+ * Parameters:
+ *          heap - the heap of node ids
+ *          heapPos - the position of each node in the heap
+ *          dist - the key of each node
+ *          heapSize - the number of entries in the heap
+ *          index - the position of the entry being moved
+ */
+void heap_sift_down(int* heap, int* heapPos, dist_t* dist, int heapSize,
+        int index);
+
+/* Find the shortest paths from one node to every other node.
+ *  Use Dijkstra's algorithm with an indexed binary heap, which requires
+ *  non-negative edge weights. With checkedDistances, nodes only reached by
+ *  paths too long for dist_t are marked with mark_distance_overflow.
+ * Parameters:
+ *          csr - the adjacency of the graph
+ *          source - the node the paths start from
+ *          dist - out parameter holding the length of each shortest path,
+ *                 DIST_INF where there is none
+ *          heap - workspace for the heap, one entry per node
+ *          heapPos - workspace for heap positions, one entry per node
+ */
+void dijkstra(CSRGraph* csr, int source, dist_t* dist, int* heap,
+        int* heapPos);
+
+/* Count the nodes a search from one node reaches, ignoring weights.
+ * Parameters:
+ *          csr - the adjacency of the graph
+ *          source - the node the search starts from
+ * Return:
+ *          The number of nodes reached, the source included.
+ */
+int reachable_count(CSRGraph* csr, int source);
+
+/* Check whether a graph has few enough edges for per-source searches.
+ * Parameters:
+ *          graph - the graph in question
+ * Return:
+ *          1 if the graph has under |V|^2 / SPARSE_DENSITY_RATIO edges, 0
+ *          otherwise.
+ */
+int is_sparse(Graph* graph);
+
+/* Decide whether a graph should be solved with the sparse engine.
+ * Parameters:
+ *          graph - the graph in question
+ * Return:
+ *          1 if the graph is sparse with non-negative weights, 0 otherwise.
+ */
+int prefer_sparse(Graph* graph);
+
+/* Populate matrix of shortest paths between all pairs of nodes.
+ *  Use Dijkstra from every source, with sources partitioned over ranks and
+ *  shared dynamically between threads, for O(|V||E|log|V|) time.
+ * Parameters:
+ *          graph - the graph in question
+ *          dynamic - whether ranks claim sources as they go rather than
+ *                    taking an equal share each
+ *          comm - the communicator the ranks share
+ *          sums - if not NULL, out parameter on rank 0 holding the total of
+ *                 each row, gathered in place of the matrix
+ *          maxes - if not NULL, out parameter on rank 0 holding the maximum
+ *                  of each row, gathered in place of the matrix
+ * Return:
+ *          On rank 0, a matrix containing the length of the shortest paths
+ *          between all nodes, or NULL if row summaries were gathered instead.
+ *          NULL on every other rank.
+ */
+dist_t** sparse_all_pair_shortest_path(Graph* graph, int dynamic,
+        MPI_Comm comm, long long* sums, long long* maxes);
+
+/* Populate matrix of shortest paths between all pairs of nodes of an
+ *  adjacency.
+ *  Use Dijkstra from every source, with sources partitioned over ranks and
+ *  shared dynamically between threads, for O(|V||E|log|V|) time.
+ * Parameters:
+ *          csr - the adjacency of the graph, with non-negative weights
+ *          potentials - if not NULL, the potentials the weights were
+ *                       reweighted by, which are undone in each row
+ *          comm - the communicator the ranks share
+ *          sums - if not NULL, out parameter on rank 0 holding the total of
+ *                 each row, gathered in place of the matrix
+ *          maxes - if not NULL, out parameter on rank 0 holding the maximum
+ *                  of each row, gathered in place of the matrix
+ * Return:
+ *          On rank 0, a matrix containing the length of the shortest paths
+ *          between all nodes, or NULL if row summaries were gathered instead.
+ *          NULL on every other rank.
+ */
+dist_t** csr_all_pair_shortest_path(CSRGraph* csr, dist_t* potentials,
+        MPI_Comm comm, long long* sums, long long* maxes);
+
+/* Populate matrix of shortest paths between all pairs of nodes of an
+ *  adjacency, with sources handed out on demand.
+ *  As csr_all_pair_shortest_path, but rather than an equal share each, ranks
+ *  claim chunks of sources from a shared counter until none are left, so
+ *  faster ranks search more. Chunks shrink as sources run out, so the ranks
+ *  finish close together.
+ * Parameters:
+ *          csr - the adjacency of the graph, with non-negative weights
+ *          potentials - if not NULL, the potentials the weights were
+ *                       reweighted by, which are undone in each row
+ *          comm - the communicator the ranks share
+ *          sums - if not NULL, out parameter on rank 0 holding the total of
+ *                 each row, gathered in place of the matrix
+ *          maxes - if not NULL, out parameter on rank 0 holding the maximum
+ *                  of each row, gathered in place of the matrix
+ * Return:
+ *          On rank 0, a matrix containing the length of the shortest paths
+ *          between all nodes, or NULL if row summaries were gathered instead.
+ *          NULL on every other rank.
+ */
+dist_t** dynamic_csr_all_pair_shortest_path(CSRGraph* csr,
+        dist_t* potentials, MPI_Comm comm, long long* sums, long long* maxes);
@@ -0,0 +1,190 @@
+/* =============================================================================
+ * symmetric.c  Floyd-Warshall on the packed upper triangle of the distance
+ *              matrix, for undirected graphs
+ * =============================================================================
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <omp.h>
+#include <mpi.h>
+#include "helper.h"
+#include "io.h"
+#include "kernel.h"
+#include "instrument.h"
+#include "symmetric.h"
+
+/* Populate matrix of shortest paths between all pairs of nodes.
+ *  Connections are two-way, so the distance matrix is symmetric and only its
+ *  upper triangle is stored and relaxed, halving memory and work. Rows are
+ *  partitioned to balance triangle entries, and each k shares the full
+ *  distance line of node k, assembled from every rank's rows.
+ * Parameters:
+ *          graph - the graph in question
+ *          comm - the communicator the ranks share
+ *          sums - if not NULL, out parameter on rank 0 holding the total of
+ *                 each row, gathered in place of the matrix
+ *          maxes - if not NULL, out parameter on rank 0 holding the maximum
+ *                  of each row, gathered in place of the matrix
+ * Return:
+ *          On rank 0, a matrix containing the length of the shortest paths
+ *          between all nodes, or NULL if row summaries were gathered instead.
+ *          NULL on every other rank.
+ */
+dist_t** symmetric_all_pair_shortest_path(Graph* graph, MPI_Comm comm,
+        long long* sums, long long* maxes) {
+    int rank, size;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &size);
+    int nodeCount = graph->nodeCount;
+
+    int* bounds = malloc((size + 1) * sizeof(int));
+    set_triangle_bounds(size, nodeCount, bounds);
+    int start = bounds[rank];
+    int end = bounds[rank + 1] - 1;
+
+    // Row i holds d(i, j) for j >= i only
+    PHASE_START(PHASE_MATRIX_INIT);
+    size_t* offsets = malloc((end - start + 2) * sizeof(size_t));
+    dist_t* packed = build_packed_connections(graph, start, end, offsets);
+    PHASE_STOP(PHASE_MATRIX_INIT);
+
+    int* counts = malloc(size * sizeof(int));
+    int* displs = malloc(size * sizeof(int));
+    dist_t* line = alloc_aligned(nodeCount);
+
+    double com = 0;
+    #pragma omp parallel
+    {
+        // Loop over each intermediate node
+        for (int k = 0; k < nodeCount; k++) {
+            #pragma omp master
+            {
+                // Iteration k-1 ends at the barrier closing its loop
+                PHASE_STOP(PHASE_COMPUTE);
+                PHASE_START(PHASE_EXCHANGE);
+                // Line k is d(j, k) for every j: column k of the triangle for
+                // j < k and row k for j >= k. Ranks own contiguous rows in
+                // order, so each contributes one contiguous piece, with the
+                // owner of row k contributing up to the end.
+                double _startTime = MPI_Wtime();
+                for (int r = 0; r < size; r++) {
+                    displs[r] = bounds[r];
+                    if (bounds[r + 1] <= k) {
+                        counts[r] = bounds[r + 1] - bounds[r];
+                    } else if (bounds[r] <= k) {
+                        counts[r] = nodeCount - bounds[r];
+                    } else {
+                        counts[r] = 0;
+                    }
+                }
+                for (int j = start; j <= end && j < k; j++) {
+                    line[j] = packed[offsets[j - start] + (k - j)];
+                }
+                if (start <= k && k <= end) {
+                    memcpy(&line[k], &packed[offsets[k - start]],
+                            (nodeCount - k) * sizeof(dist_t));
+                }
+                MPI_Allgatherv(MPI_IN_PLACE, 0, MPI_DATATYPE_NULL, line,
+                        counts, displs, MPI_DIST, comm);
+                com += MPI_Wtime() - _startTime;
+                PHASE_STOP(PHASE_EXCHANGE);
+                PHASE_START(PHASE_COMPUTE);
+            }
+            #pragma omp barrier
+
+            // d(i, j) through k is d(i, k) + d(k, j), both read from the line
+            // Later rows are shorter, so share them out dynamically
+            #pragma omp for schedule(dynamic, 16)
+            for (int i = start; i <= end; i++) {
+                if (line[i] == DIST_INF) continue;
+                dist_t* row = &packed[offsets[i - start]];
+                min_plus(row, &line[i], line[i], nodeCount - i);
+                if (row[0] < 0) mark_negative_cycle();
+            }
+        }
+    }
+    PHASE_STOP(PHASE_COMPUTE);
+    free(line);
+    free(counts);
+    free(displs);
+    timings.com = com;
+
+    PHASE_START(PHASE_GATHER);
+    double startTime = MPI_Wtime();
+    if (sums != NULL) {
+        // Each stored entry belongs to both its row and its column
+        long long* partialSums = calloc(nodeCount, sizeof(long long));
+        long long* partialMaxes = calloc(nodeCount, sizeof(long long));
+        for (int i = start; i <= end; i++) {
+            dist_t* row = &packed[offsets[i - start]];
+            for (int j = i; j < nodeCount; j++) {
+                dist_t value = row[j - i];
+                if (value == DIST_INF) {
+                    partialMaxes[i] = LLONG_MAX;
+                    partialMaxes[j] = LLONG_MAX;
+                    continue;
+                }
+                partialSums[i] += value;
+                if (j != i) partialSums[j] += value;
+                if (value > partialMaxes[i]) partialMaxes[i] = value;
+                if (value > partialMaxes[j]) partialMaxes[j] = value;
+            }
+        }
+        reduce_partial_summaries(partialSums, partialMaxes, sums, maxes,
+                nodeCount, comm);
+        timings.gather = MPI_Wtime() - startTime;
+        PHASE_STOP(PHASE_GATHER);
+        free(partialSums);
+        free(partialMaxes);
+        free(packed);
+        free(offsets);
+        free(bounds);
+        return NULL;
+    }
+
+    // Collect on rank 0 only since we only need to process once, mirroring
+    // each row into its column
+    dist_t** dist = NULL;
+    if (rank == 0) {
+        dist = alloc_matrix(nodeCount, nodeCount);
+        for (int r = 0; r < size; r++) {
+            int rowCount = bounds[r + 1] - bounds[r];
+            if (rowCount == 0) continue;
+            dist_t* otherPacked = packed;
+            size_t* otherOffsets = offsets;
+            if (r != 0) {
+                otherOffsets = malloc((rowCount + 1) * sizeof(size_t));
+                otherOffsets[0] = 0;
+                for (int i = bounds[r]; i < bounds[r + 1]; i++) {
+                    otherOffsets[i - bounds[r] + 1] =
+                            otherOffsets[i - bounds[r]] + (nodeCount - i);
+                }
+                otherPacked = malloc(otherOffsets[rowCount] * sizeof(dist_t));
+                MPI_Recv(otherPacked, otherOffsets[rowCount], MPI_DIST, r, 0,
+                        comm, MPI_STATUS_IGNORE);
+            }
+            for (int i = bounds[r]; i < bounds[r + 1]; i++) {
+                dist_t* row = &otherPacked[otherOffsets[i - bounds[r]]];
+                for (int j = i; j < nodeCount; j++) {
+                    dist[i][j] = row[j - i];
+                    dist[j][i] = row[j - i];
+                }
+            }
+            if (r != 0) {
+                free(otherPacked);
+                free(otherOffsets);
+            }
+        }
+    } else if (end >= start) {
+        MPI_Send(packed, offsets[end - start + 1], MPI_DIST, 0, 0, comm);
+    }
+    timings.gather = MPI_Wtime() - startTime;
+    PHASE_STOP(PHASE_GATHER);
+
+    free(packed);
+    free(offsets);
+    free(bounds);
+    return dist;
+}
@@ -0,0 +1,25 @@
+/* =============================================================================
+ * symmetric.h  Floyd-Warshall on the packed upper triangle of the distance
+ *              matrix, for undirected graphs
+ * =============================================================================
+ */
+
+/* Populate matrix of shortest paths between all pairs of nodes.
+ *  Connections are two-way, so the distance matrix is symmetric and only its
+ *  upper triangle is stored and relaxed, halving memory and work. Rows are
+ *  partitioned to balance triangle entries, and each k shares the full
+ *  distance line of node k, assembled from every rank's rows.
+ * Parameters:
+ *          graph - the graph in question
+ *          comm - the communicator the ranks share
+ *          sums - if not NULL, out parameter on rank 0 holding the total of
+ *                 each row, gathered in place of the matrix
+ *          maxes - if not NULL, out parameter on rank 0 holding the maximum
+ *                  of each row, gathered in place of the matrix
+ * Return:
+ *          On rank 0, a matrix containing the length of the shortest paths
+ *          between all nodes, or NULL if row summaries were gathered instead.
+ *          NULL on every other rank.
+ */
+dist_t** symmetric_all_pair_shortest_path(Graph* graph, MPI_Comm comm,
+        long long* sums, long long* maxes);